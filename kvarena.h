@@ -0,0 +1,165 @@
+/*
+ * LightningObjects C++ Object Storage based on Key/Value API
+ *
+ * Copyright (C) 2016 GS Vitec GmbH <christian@gsvitec.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, and provided
+ * in the LICENSE file in the root directory of this software.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LO_KVARENA_H
+#define LO_KVARENA_H
+
+#include <atomic>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+
+namespace lo {
+namespace persistence {
+namespace kv {
+
+/**
+ * bump allocator for objects materialized by a transaction. Memory is allocated from fixed-size blocks and only
+ * released as a whole. The arena is reference counted: the owning transaction holds one reference, and every
+ * allocation holds one until it is given back through release(). The blocks are freed when the last reference
+ * is gone, so objects may safely outlive the transaction (at the cost of keeping the whole arena alive).
+ * allocate() must only be called from the owning transaction's thread, release() may be called from any thread
+ */
+class ObjectArena
+{
+  const size_t m_blockSize;
+  std::vector<char *> m_blocks;
+  char *m_ptr = nullptr, *m_end = nullptr;
+  size_t m_allocated = 0;
+  std::atomic<size_t> m_refs;
+
+  ObjectArena(const ObjectArena &other) = delete;
+
+  ~ObjectArena() {
+    for(char *block : m_blocks) free(block);
+  }
+
+public:
+  ObjectArena(size_t blockSize) : m_blockSize(blockSize), m_refs(1) {}
+
+  /**
+   * allocate memory from the arena. Each call must be matched by a call to release()
+   */
+  void *allocate(size_t size, size_t align)
+  {
+    char *ptr = (char *)(((uintptr_t)m_ptr + align - 1) & ~(uintptr_t)(align - 1));
+    if(!m_ptr || ptr + size > m_end) {
+      //oversized requests get a block of their own
+      size_t blockSize = size + align > m_blockSize ? size + align : m_blockSize;
+      char *block = (char *)malloc(blockSize);
+      if(!block) throw std::bad_alloc();
+      m_blocks.push_back(block);
+      m_ptr = block;
+      m_end = block + blockSize;
+      ptr = (char *)(((uintptr_t)m_ptr + align - 1) & ~(uintptr_t)(align - 1));
+    }
+    m_ptr = ptr + size;
+    m_allocated += size;
+    m_refs++;
+    return ptr;
+  }
+
+  /**
+   * default-construct an object of type T inside the arena
+   */
+  template <typename T> T *create()
+  {
+    void *mem = allocate(sizeof(T), alignof(T));
+    try {
+      return new(mem) T();
+    }
+    catch(...) {
+      release();
+      throw;
+    }
+  }
+
+  /**
+   * destroy an object created through create()
+   */
+  template <typename T> void destroy(T *obj)
+  {
+    obj->~T();
+    release();
+  }
+
+  /**
+   * give back one reference. The arena deletes itself when the last reference is gone
+   */
+  void release()
+  {
+    if(--m_refs == 0) delete this;
+  }
+
+  /**
+   * @return the number of bytes handed out so far
+   */
+  size_t allocated() const {return m_allocated;}
+
+  /**
+   * @return the number of blocks allocated so far
+   */
+  size_t blocks() const {return m_blocks.size();}
+};
+
+/**
+ * std allocator on top of an ObjectArena. Used for the shared_ptr control blocks of arena objects
+ */
+template <typename T>
+struct ArenaAllocator
+{
+  using value_type = T;
+
+  ObjectArena *arena;
+
+  ArenaAllocator(ObjectArena *arena) : arena(arena) {}
+  template <typename U> ArenaAllocator(const ArenaAllocator<U> &other) : arena(other.arena) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(arena->allocate(n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *p, size_t n) {
+    arena->release();
+  }
+
+  template <typename U> bool operator == (const ArenaAllocator<U> &other) const {return arena == other.arena;}
+  template <typename U> bool operator != (const ArenaAllocator<U> &other) const {return arena != other.arena;}
+};
+
+/**
+ * shared_ptr deleter for arena objects that are not associated with a key, like collection elements
+ */
+template <typename T> struct arena_deleter
+{
+  ObjectArena *arena;
+
+  arena_deleter(ObjectArena *arena) : arena(arena) {}
+
+  void operator () (T *t) {
+    if(t) arena->destroy(t);
+  }
+};
+
+} //kv
+} //persistence
+} //lo
+
+#endif //LO_KVARENA_H
@@ -21,7 +21,12 @@
 #define LO_KVWRITEBUF_H
 
 #include <string.h>
+#include <stdint.h>
 #include <memory>
+#include <vector>
+#ifdef _MSC_VER
+#include <stdlib.h>
+#endif
 
 #include "kvkey.h"
 
@@ -44,16 +49,155 @@ static const size_t ObjectHeader_sz = ClassId_sz + ObjectId_sz + 4 + 1;
 //header preceding each collection chunk
 static const size_t ChunkHeader_sz = 4 * 3;
 
+//set in the size field of the chunk header if the chunk data following the header is compressed
+static const size_t ChunkCompressed_flag = 0x80000000;
+
 using byte_t = unsigned char;
 
+/**
+ * on-disk format of a store. The format is chosen when the store is created and cannot be changed afterwards
+ */
+enum class StoreFormat : byte_t
+{
+  //fixed-width collection headers and counts
+  fixed = 0,
+  //LEB128 varints for collection object headers and collection counts
+  compact = 1
+};
+
+/*
+ * @return the number of bytes required to save val as LEB128 varint
+ */
+inline size_t varint_size(uint64_t val)
+{
+  size_t sz = 1;
+  while(val >= 0x80) {
+    val >>= 7;
+    sz++;
+  }
+  return sz;
+}
+
+/*
+ * save an unsigned integral value as LEB128 varint (max. 10 bytes)
+ * @return the number of bytes written
+ */
+inline size_t write_varint(byte_t *ptr, uint64_t val)
+{
+  size_t i = 0;
+  while(val >= 0x80) {
+    ptr[i++] = (byte_t)(val | 0x80);
+    val >>= 7;
+  }
+  ptr[i++] = (byte_t)val;
+  return i;
+}
+
+/*
+ * read a LEB128 varint
+ * @param bytes (out) the number of bytes read
+ */
+inline uint64_t read_varint(const byte_t *ptr, size_t *bytes)
+{
+  uint64_t val = 0;
+  size_t i = 0;
+  for(unsigned shift = 0; ; shift += 7) {
+    byte_t b = ptr[i++];
+    val |= (uint64_t)(b & 0x7F) << shift;
+    if(!(b & 0x80)) break;
+  }
+  *bytes = i;
+  return val;
+}
+
+/*
+ * map a signed value to an unsigned value such that small absolute values yield short varints
+ */
+inline uint64_t zigzag_encode(int64_t val)
+{
+  return ((uint64_t)val << 1) ^ (uint64_t)(val >> 63);
+}
+
+inline int64_t zigzag_decode(uint64_t val)
+{
+  return (int64_t)(val >> 1) ^ -(int64_t)(val & 1);
+}
+
+/*
+ * unsigned integer type and host/storage byte order conversion for the fixed integer widths. Integers are
+ * stored big-endian
+ */
+template <size_t N> struct IntegerWidth;
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define LO_BSWAP16(__v) (__v)
+#define LO_BSWAP32(__v) (__v)
+#define LO_BSWAP64(__v) (__v)
+#elif defined(_MSC_VER)
+#define LO_BSWAP16(__v) _byteswap_ushort(__v)
+#define LO_BSWAP32(__v) _byteswap_ulong(__v)
+#define LO_BSWAP64(__v) _byteswap_uint64(__v)
+#else
+#define LO_BSWAP16(__v) __builtin_bswap16(__v)
+#define LO_BSWAP32(__v) __builtin_bswap32(__v)
+#define LO_BSWAP64(__v) __builtin_bswap64(__v)
+#endif
+
+template <> struct IntegerWidth<1> {
+  using type = uint8_t;
+  static type swap(type val) {return val;}
+};
+template <> struct IntegerWidth<2> {
+  using type = uint16_t;
+  static type swap(type val) {return LO_BSWAP16(val);}
+};
+template <> struct IntegerWidth<4> {
+  using type = uint32_t;
+  static type swap(type val) {return LO_BSWAP32(val);}
+};
+template <> struct IntegerWidth<8> {
+  using type = uint64_t;
+  static type swap(type val) {return LO_BSWAP64(val);}
+};
+
+/*
+ * save an integral value to N bytes, N being one of 1, 2, 4, 8
+ */
+template<size_t N, typename T>
+inline void write_integer(byte_t *ptr, T val)
+{
+  using W = IntegerWidth<N>;
+  typename W::type v = W::swap((typename W::type)val);
+  memcpy(ptr, &v, N);
+}
+
+/*
+ * read an integral value from N bytes, N being one of 1, 2, 4, 8
+ */
+template<typename T, size_t N>
+inline T read_integer(const byte_t *ptr)
+{
+  using W = IntegerWidth<N>;
+  typename W::type v;
+  memcpy(&v, ptr, N);
+  return (T)W::swap(v);
+}
+
 /*
  * save an integral value to a fixed size of bytes (max. 8)
  */
 template<typename T>
 inline void write_integer(byte_t *ptr, T val, size_t bytes)
 {
-  for(size_t i=0, f=bytes-1; i<bytes; i++, f--)
-    ptr[i] = i<sizeof(T) ? (byte_t) (val >> (f * 8)) : (byte_t)0;
+  switch(bytes) {
+    case 1: write_integer<1>(ptr, val); return;
+    case 2: write_integer<2>(ptr, val); return;
+    case 4: write_integer<4>(ptr, val); return;
+    case 8: write_integer<8>(ptr, val); return;
+    default:
+      for(size_t i=0, f=bytes-1; i<bytes; i++, f--)
+        ptr[i] = i<sizeof(T) ? (byte_t) (val >> (f * 8)) : (byte_t)0;
+  }
 }
 
 /*
@@ -62,9 +206,17 @@ inline void write_integer(byte_t *ptr, T val, size_t bytes)
 template<typename T>
 inline T read_integer(const byte_t *ptr, size_t bytes)
 {
-  T val = (T)0;
-  for(size_t i=0, f=bytes-1; i<bytes; i++, f--) val += ((T)ptr[i] << (f * 8));
-  return val;
+  switch(bytes) {
+    case 1: return read_integer<T, 1>(ptr);
+    case 2: return read_integer<T, 2>(ptr);
+    case 4: return read_integer<T, 4>(ptr);
+    case 8: return read_integer<T, 8>(ptr);
+    default: {
+      T val = (T)0;
+      for(size_t i=0, f=bytes-1; i<bytes; i++, f--) val += ((T)ptr[i] << (f * 8));
+      return val;
+    }
+  }
 }
 
 /**
@@ -81,6 +233,7 @@ protected:
   byte_t *m_mark = nullptr;
   size_t m_size = 0;
   bool m_owned = false;
+  std::shared_ptr<std::vector<byte_t>> m_shared;
 
 public:
   ReadBuf() {}
@@ -108,7 +261,30 @@ public:
     return m_data;
   }
 
+  /**
+   * start reading from a private copy of the given data
+   */
+  void startCopy(const byte_t *data, size_t size) {
+    byte_t *copy = (byte_t *)malloc(size);
+    memcpy(copy, data, size);
+    start(copy, size);
+    m_owned = true;
+  }
+
+  /**
+   * start reading from a shared buffer. The buffer is referenced until the next start
+   */
+  void start(const std::shared_ptr<std::vector<byte_t>> &buffer) {
+    start(buffer->data(), buffer->size());
+    m_shared = buffer;
+  }
+
   void start(byte_t *data, size_t size) {
+    if(m_data && m_owned) {
+      free(m_data);
+      m_owned = false;
+    }
+    m_shared.reset();
     m_size = size;
     m_readptr = m_data = data;
   }
@@ -145,6 +321,13 @@ public:
     return ret;
   }
 
+  template <typename T, size_t N>
+  T readInteger() {
+    T ret = read_integer<T, N>(m_readptr);
+    m_readptr += N;
+    return ret;
+  }
+
   template<typename T>
   T readRaw() {
     T val = *(T *)m_readptr;
@@ -152,6 +335,13 @@ public:
     return val;
   }
 
+  uint64_t readVarint() {
+    size_t sz;
+    uint64_t ret = read_varint(m_readptr, &sz);
+    m_readptr += sz;
+    return ret;
+  }
+
   bool atEnd() {
     return m_readptr == m_data + m_size;
   }
@@ -300,6 +490,15 @@ public:
     write_integer(buf, num, bytes);
   }
 
+  template<size_t N, typename T>
+  void appendInteger(T num) {
+    write_integer<N>(allocate(N), num);
+  }
+
+  void appendVarint(uint64_t num) {
+    m_appendptr += write_varint(m_appendptr, num);
+  }
+
   void appendCString(const char *data) {
     size_t len = strlen(data) + 1;
     byte_t * buf = allocate(len);
@@ -0,0 +1,185 @@
+/*
+ * LightningObjects C++ Object Storage based on Key/Value API
+ *
+ * Copyright (C) 2016 GS Vitec GmbH <christian@gsvitec.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, and provided
+ * in the LICENSE file in the root directory of this software.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LO_KVCODEC_H
+#define LO_KVCODEC_H
+
+#include <cstdint>
+#include <cstring>
+#include "kvbuf.h"
+
+namespace lo {
+namespace persistence {
+namespace kv {
+
+/**
+ * compression codec for the chunks of a top-level collection. The codec is chosen per collection and only
+ * applies to chunks written afterwards, so a collection may contain compressed and uncompressed chunks
+ */
+enum class ChunkCodec : byte_t
+{
+  none = 0,
+  //built-in LZ77 byte codec, see codec::lz_compress
+  lz = 1
+};
+
+/**
+ * a fast LZ77 byte codec using the LZ4 block layout: a sequence of [token, literals, 2-byte offset] entries,
+ * where the token holds the literal length and the match length in its high and low nibble. Optimized for
+ * speed, not ratio, and without external dependencies
+ */
+namespace codec {
+
+static const size_t LZ_MINMATCH = 4;
+static const size_t LZ_MAXOFFSET = 65535;
+static const unsigned LZ_HASHBITS = 12;
+
+/**
+ * @return the maximum compressed size for an input of the given size
+ */
+inline size_t lz_bound(size_t size)
+{
+  return size + size / 255 + 16;
+}
+
+inline uint32_t lz_read32(const byte_t *ptr)
+{
+  uint32_t val;
+  memcpy(&val, ptr, 4);
+  return val;
+}
+
+inline uint32_t lz_hash(uint32_t val)
+{
+  return (val * 2654435761u) >> (32 - LZ_HASHBITS);
+}
+
+inline byte_t *lz_writeLength(byte_t *op, size_t len)
+{
+  for(; len >= 255; len -= 255) *op++ = 255;
+  *op++ = (byte_t)len;
+  return op;
+}
+
+inline bool lz_readLength(const byte_t *&ip, const byte_t *iend, size_t &len)
+{
+  byte_t b;
+  do {
+    if(ip >= iend) return false;
+    b = *ip++;
+    len += b;
+  } while(b == 255);
+  return true;
+}
+
+/**
+ * compress a byte range
+ *
+ * @param dst the output buffer, which must hold at least lz_bound(size) bytes
+ * @return the compressed size
+ */
+inline size_t lz_compress(const byte_t *src, size_t size, byte_t *dst)
+{
+  uint32_t table[1 << LZ_HASHBITS] = {0};
+
+  const byte_t *ip = src, *anchor = src, *end = src + size;
+  const byte_t *mflimit = size > LZ_MINMATCH ? end - LZ_MINMATCH : src;
+  byte_t *op = dst;
+
+  while(ip < mflimit) {
+    uint32_t seq = lz_read32(ip);
+    uint32_t h = lz_hash(seq);
+    const byte_t *ref = src + table[h];
+    table[h] = (uint32_t)(ip - src);
+
+    if(ref >= ip || (size_t)(ip - ref) > LZ_MAXOFFSET || lz_read32(ref) != seq) {
+      ip++;
+      continue;
+    }
+    const byte_t *mp = ip + LZ_MINMATCH, *rp = ref + LZ_MINMATCH;
+    while(mp < end && *mp == *rp) {mp++; rp++;}
+
+    size_t litlen = ip - anchor, matchlen = (mp - ip) - LZ_MINMATCH, offset = ip - ref;
+    *op++ = (byte_t)((litlen < 15 ? litlen : 15) << 4 | (matchlen < 15 ? matchlen : 15));
+    if(litlen >= 15) op = lz_writeLength(op, litlen - 15);
+    memcpy(op, anchor, litlen);
+    op += litlen;
+    *op++ = (byte_t)offset;
+    *op++ = (byte_t)(offset >> 8);
+    if(matchlen >= 15) op = lz_writeLength(op, matchlen - 15);
+
+    ip = anchor = mp;
+  }
+  //last sequence holds the remaining literals only
+  size_t litlen = end - anchor;
+  *op++ = (byte_t)((litlen < 15 ? litlen : 15) << 4);
+  if(litlen >= 15) op = lz_writeLength(op, litlen - 15);
+  memcpy(op, anchor, litlen);
+  op += litlen;
+
+  return op - dst;
+}
+
+/**
+ * decompress a byte range produced by lz_compress. All reads and writes are bounds-checked
+ *
+ * @param dstSize the exact uncompressed size
+ * @return false if the input is malformed or does not decompress to dstSize bytes
+ */
+inline bool lz_decompress(const byte_t *src, size_t size, byte_t *dst, size_t dstSize)
+{
+  const byte_t *ip = src, *iend = src + size;
+  byte_t *op = dst, *oend = dst + dstSize;
+
+  while(ip < iend) {
+    byte_t token = *ip++;
+
+    size_t len = token >> 4;
+    if(len == 15 && !lz_readLength(ip, iend, len)) return false;
+    if((size_t)(iend - ip) < len || (size_t)(oend - op) < len) return false;
+    memcpy(op, ip, len);
+    op += len;
+    ip += len;
+
+    if(ip == iend) break;
+
+    if(iend - ip < 2) return false;
+    size_t offset = ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+    if(!offset || offset > (size_t)(op - dst)) return false;
+
+    len = token & 15;
+    if(len == 15 && !lz_readLength(ip, iend, len)) return false;
+    len += LZ_MINMATCH;
+    if((size_t)(oend - op) < len) return false;
+
+    //byte-wise copy, source and destination may overlap
+    const byte_t *ref = op - offset;
+    for(size_t i=0; i<len; i++) op[i] = ref[i];
+    op += len;
+  }
+  return op == oend;
+}
+
+} //codec
+} //kv
+} //persistence
+} //lo
+
+#endif //LO_KVCODEC_H
@@ -0,0 +1,538 @@
+/*
+ * LightningObjects C++ Object Storage based on Key/Value API
+ *
+ * Copyright (C) 2016 GS Vitec GmbH <christian@gsvitec.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, and provided
+ * in the LICENSE file in the root directory of this software.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LO_KVKERNELS_H
+#define LO_KVKERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+//AVX2 functions are compiled through the target attribute and selected at runtime
+#include <immintrin.h>
+#define LO_KERNELS_SSE2
+#define LO_KERNELS_AVX2
+#define LO_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LO_KERNELS_AVX2
+#define LO_TARGET_AVX2
+#else
+#include <emmintrin.h>
+#endif
+#define LO_KERNELS_SSE2
+#endif
+
+namespace lo {
+namespace persistence {
+namespace kv {
+
+/**
+ * aggregate and filter kernels over raw data arrays, as obtained from data collections. The float, double and int32_t
+ * overloads are vectorized with SSE2, and with AVX2 if the CPU supports it (checked at runtime). All other types use
+ * the scalar templates. All kernels are cumulative, so they can be applied chunk by chunk
+ */
+namespace kernels {
+
+/**
+ * running summary of a data range
+ */
+template <typename T>
+struct Summary
+{
+  size_t count = 0;
+  T min = std::numeric_limits<T>::max();
+  T max = std::numeric_limits<T>::lowest();
+  double sum = 0;
+
+  double mean() const {return count ? sum / count : 0;}
+};
+
+/**
+ * scalar summary kernel
+ */
+template <typename T>
+void summarize(const T *data, size_t count, Summary<T> &summary)
+{
+  T mn = summary.min, mx = summary.max;
+  double sum = 0;
+  for(size_t i=0; i<count; i++) {
+    T val = data[i];
+    if(val < mn) mn = val;
+    if(val > mx) mx = val;
+    sum += val;
+  }
+  summary.min = mn;
+  summary.max = mx;
+  summary.sum += sum;
+  summary.count += count;
+}
+
+/**
+ * scalar threshold filter kernel. The indexes of all elements greater than threshold are appended to result
+ *
+ * @param baseIndex the index of the first element, added to all result indexes
+ */
+template <typename T>
+void filterGreater(const T *data, size_t count, T threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  for(size_t i=0; i<count; i++) {
+    *out = baseIndex + i;
+    out += data[i] > threshold;
+  }
+  result.resize(out - result.data());
+}
+
+/**
+ * scalar histogram kernel with equally sized bins over [lower, upper). Values outside the range are counted
+ * into the first or last bin
+ *
+ * @param bins the bin counters, which are incremented
+ * @param binCount the number of bins
+ */
+template <typename T>
+void histogram(const T *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  const double scale = binCount / (upper - lower);
+  const double last = (double)(binCount - 1);
+  for(size_t i=0; i<count; i++) {
+    double bin = ((double)data[i] - lower) * scale;
+    bin = bin < 0 ? 0 : (bin > last ? last : bin);
+    bins[(size_t)bin]++;
+  }
+}
+
+#if defined(LO_KERNELS_SSE2)
+
+/**
+ * SSE2 kernels. Used directly only for testing, callers should go through the dispatching overloads
+ */
+namespace sse2 {
+
+inline void summarize(const float *data, size_t count, Summary<float> &summary)
+{
+  size_t i = 0;
+  if(count >= 4) {
+    __m128 vmin = _mm_set1_ps(summary.min), vmax = _mm_set1_ps(summary.max);
+    __m128d vsum0 = _mm_setzero_pd(), vsum1 = _mm_setzero_pd();
+    for(; i + 4 <= count; i += 4) {
+      __m128 v = _mm_loadu_ps(data + i);
+      vmin = _mm_min_ps(vmin, v);
+      vmax = _mm_max_ps(vmax, v);
+      vsum0 = _mm_add_pd(vsum0, _mm_cvtps_pd(v));
+      vsum1 = _mm_add_pd(vsum1, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+    }
+    float mn[4], mx[4];
+    double sm[2];
+    _mm_storeu_ps(mn, vmin);
+    _mm_storeu_ps(mx, vmax);
+    _mm_storeu_pd(sm, _mm_add_pd(vsum0, vsum1));
+    for(int l=0; l<4; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1];
+    summary.count += i;
+  }
+  kernels::summarize<float>(data + i, count - i, summary);
+}
+
+inline void summarize(const double *data, size_t count, Summary<double> &summary)
+{
+  size_t i = 0;
+  if(count >= 2) {
+    __m128d vmin = _mm_set1_pd(summary.min), vmax = _mm_set1_pd(summary.max), vsum = _mm_setzero_pd();
+    for(; i + 2 <= count; i += 2) {
+      __m128d v = _mm_loadu_pd(data + i);
+      vmin = _mm_min_pd(vmin, v);
+      vmax = _mm_max_pd(vmax, v);
+      vsum = _mm_add_pd(vsum, v);
+    }
+    double mn[2], mx[2], sm[2];
+    _mm_storeu_pd(mn, vmin);
+    _mm_storeu_pd(mx, vmax);
+    _mm_storeu_pd(sm, vsum);
+    for(int l=0; l<2; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1];
+    summary.count += i;
+  }
+  kernels::summarize<double>(data + i, count - i, summary);
+}
+
+inline void summarize(const int32_t *data, size_t count, Summary<int32_t> &summary)
+{
+  size_t i = 0;
+  if(count >= 4) {
+    //SSE2 has no integer min/max, select through the compare mask
+    __m128i vmin = _mm_set1_epi32(summary.min), vmax = _mm_set1_epi32(summary.max);
+    __m128d vsum0 = _mm_setzero_pd(), vsum1 = _mm_setzero_pd();
+    for(; i + 4 <= count; i += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+      __m128i lt = _mm_cmplt_epi32(v, vmin), gt = _mm_cmpgt_epi32(v, vmax);
+      vmin = _mm_or_si128(_mm_and_si128(lt, v), _mm_andnot_si128(lt, vmin));
+      vmax = _mm_or_si128(_mm_and_si128(gt, v), _mm_andnot_si128(gt, vmax));
+      vsum0 = _mm_add_pd(vsum0, _mm_cvtepi32_pd(v));
+      vsum1 = _mm_add_pd(vsum1, _mm_cvtepi32_pd(_mm_shuffle_epi32(v, 0xEE)));
+    }
+    int32_t mn[4], mx[4];
+    double sm[2];
+    _mm_storeu_si128((__m128i *)mn, vmin);
+    _mm_storeu_si128((__m128i *)mx, vmax);
+    _mm_storeu_pd(sm, _mm_add_pd(vsum0, vsum1));
+    for(int l=0; l<4; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1];
+    summary.count += i;
+  }
+  kernels::summarize<int32_t>(data + i, count - i, summary);
+}
+
+inline void filterGreater(const float *data, size_t count, float threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m128 vt = _mm_set1_ps(threshold);
+  for(; i + 4 <= count; i += 4) {
+    unsigned mask = (unsigned)_mm_movemask_ps(_mm_cmpgt_ps(_mm_loadu_ps(data + i), vt));
+    for(size_t l=0; mask; mask >>= 1, l++) if(mask & 1) *out++ = baseIndex + i + l;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<float>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+inline void filterGreater(const double *data, size_t count, double threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m128d vt = _mm_set1_pd(threshold);
+  for(; i + 2 <= count; i += 2) {
+    unsigned mask = (unsigned)_mm_movemask_pd(_mm_cmpgt_pd(_mm_loadu_pd(data + i), vt));
+    if(mask & 1) *out++ = baseIndex + i;
+    if(mask & 2) *out++ = baseIndex + i + 1;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<double>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+inline void filterGreater(const int32_t *data, size_t count, int32_t threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m128i vt = _mm_set1_epi32(threshold);
+  for(; i + 4 <= count; i += 4) {
+    __m128i gt = _mm_cmpgt_epi32(_mm_loadu_si128((const __m128i *)(data + i)), vt);
+    unsigned mask = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(gt));
+    for(size_t l=0; mask; mask >>= 1, l++) if(mask & 1) *out++ = baseIndex + i + l;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<int32_t>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+//load 2 elements as doubles
+inline __m128d load2(const float *data) {return _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)data)));}
+inline __m128d load2(const double *data) {return _mm_loadu_pd(data);}
+inline __m128d load2(const int32_t *data) {return _mm_cvtepi32_pd(_mm_loadl_epi64((const __m128i *)data));}
+
+/**
+ * histogram with vectorized bin index computation. Only the counter increments are scalar
+ */
+template <typename T>
+void histogram(const T *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  size_t i = 0;
+  if(binCount <= (size_t)std::numeric_limits<int32_t>::max()) {
+    const __m128d vlower = _mm_set1_pd(lower), vscale = _mm_set1_pd(binCount / (upper - lower));
+    const __m128d vzero = _mm_setzero_pd(), vlast = _mm_set1_pd((double)(binCount - 1));
+    for(; i + 4 <= count; i += 4) {
+      __m128d b0 = _mm_mul_pd(_mm_sub_pd(load2(data + i), vlower), vscale);
+      __m128d b1 = _mm_mul_pd(_mm_sub_pd(load2(data + i + 2), vlower), vscale);
+      b0 = _mm_min_pd(_mm_max_pd(b0, vzero), vlast);
+      b1 = _mm_min_pd(_mm_max_pd(b1, vzero), vlast);
+
+      int32_t idx[4];
+      _mm_storeu_si128((__m128i *)idx, _mm_unpacklo_epi64(_mm_cvttpd_epi32(b0), _mm_cvttpd_epi32(b1)));
+      for(int l=0; l<4; l++) bins[idx[l]]++;
+    }
+  }
+  kernels::histogram<T>(data + i, count - i, lower, upper, bins, binCount);
+}
+
+} //sse2
+
+#endif //LO_KERNELS_SSE2
+
+#if defined(LO_KERNELS_AVX2)
+
+/**
+ * AVX2 kernels. These must only be called if hasAVX2() returns true
+ */
+namespace avx2 {
+
+LO_TARGET_AVX2 inline void summarize(const float *data, size_t count, Summary<float> &summary)
+{
+  size_t i = 0;
+  if(count >= 8) {
+    __m256 vmin = _mm256_set1_ps(summary.min), vmax = _mm256_set1_ps(summary.max);
+    __m256d vsum0 = _mm256_setzero_pd(), vsum1 = _mm256_setzero_pd();
+    for(; i + 8 <= count; i += 8) {
+      __m256 v = _mm256_loadu_ps(data + i);
+      vmin = _mm256_min_ps(vmin, v);
+      vmax = _mm256_max_ps(vmax, v);
+      vsum0 = _mm256_add_pd(vsum0, _mm256_cvtps_pd(_mm256_castps256_ps128(v)));
+      vsum1 = _mm256_add_pd(vsum1, _mm256_cvtps_pd(_mm256_extractf128_ps(v, 1)));
+    }
+    float mn[8], mx[8];
+    double sm[4];
+    _mm256_storeu_ps(mn, vmin);
+    _mm256_storeu_ps(mx, vmax);
+    _mm256_storeu_pd(sm, _mm256_add_pd(vsum0, vsum1));
+    for(int l=0; l<8; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1] + sm[2] + sm[3];
+    summary.count += i;
+  }
+  kernels::summarize<float>(data + i, count - i, summary);
+}
+
+LO_TARGET_AVX2 inline void summarize(const double *data, size_t count, Summary<double> &summary)
+{
+  size_t i = 0;
+  if(count >= 4) {
+    __m256d vmin = _mm256_set1_pd(summary.min), vmax = _mm256_set1_pd(summary.max), vsum = _mm256_setzero_pd();
+    for(; i + 4 <= count; i += 4) {
+      __m256d v = _mm256_loadu_pd(data + i);
+      vmin = _mm256_min_pd(vmin, v);
+      vmax = _mm256_max_pd(vmax, v);
+      vsum = _mm256_add_pd(vsum, v);
+    }
+    double mn[4], mx[4], sm[4];
+    _mm256_storeu_pd(mn, vmin);
+    _mm256_storeu_pd(mx, vmax);
+    _mm256_storeu_pd(sm, vsum);
+    for(int l=0; l<4; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1] + sm[2] + sm[3];
+    summary.count += i;
+  }
+  kernels::summarize<double>(data + i, count - i, summary);
+}
+
+LO_TARGET_AVX2 inline void summarize(const int32_t *data, size_t count, Summary<int32_t> &summary)
+{
+  size_t i = 0;
+  if(count >= 8) {
+    __m256i vmin = _mm256_set1_epi32(summary.min), vmax = _mm256_set1_epi32(summary.max);
+    __m256d vsum0 = _mm256_setzero_pd(), vsum1 = _mm256_setzero_pd();
+    for(; i + 8 <= count; i += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(data + i));
+      vmin = _mm256_min_epi32(vmin, v);
+      vmax = _mm256_max_epi32(vmax, v);
+      vsum0 = _mm256_add_pd(vsum0, _mm256_cvtepi32_pd(_mm256_castsi256_si128(v)));
+      vsum1 = _mm256_add_pd(vsum1, _mm256_cvtepi32_pd(_mm256_extracti128_si256(v, 1)));
+    }
+    int32_t mn[8], mx[8];
+    double sm[4];
+    _mm256_storeu_si256((__m256i *)mn, vmin);
+    _mm256_storeu_si256((__m256i *)mx, vmax);
+    _mm256_storeu_pd(sm, _mm256_add_pd(vsum0, vsum1));
+    for(int l=0; l<8; l++) {
+      if(mn[l] < summary.min) summary.min = mn[l];
+      if(mx[l] > summary.max) summary.max = mx[l];
+    }
+    summary.sum += sm[0] + sm[1] + sm[2] + sm[3];
+    summary.count += i;
+  }
+  kernels::summarize<int32_t>(data + i, count - i, summary);
+}
+
+LO_TARGET_AVX2 inline void filterGreater(const float *data, size_t count, float threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m256 vt = _mm256_set1_ps(threshold);
+  for(; i + 8 <= count; i += 8) {
+    unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(_mm256_loadu_ps(data + i), vt, _CMP_GT_OQ));
+    for(size_t l=0; mask; mask >>= 1, l++) if(mask & 1) *out++ = baseIndex + i + l;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<float>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+LO_TARGET_AVX2 inline void filterGreater(const double *data, size_t count, double threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m256d vt = _mm256_set1_pd(threshold);
+  for(; i + 4 <= count; i += 4) {
+    unsigned mask = (unsigned)_mm256_movemask_pd(_mm256_cmp_pd(_mm256_loadu_pd(data + i), vt, _CMP_GT_OQ));
+    for(size_t l=0; mask; mask >>= 1, l++) if(mask & 1) *out++ = baseIndex + i + l;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<double>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+LO_TARGET_AVX2 inline void filterGreater(const int32_t *data, size_t count, int32_t threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  size_t i = 0;
+  size_t n = result.size();
+  result.resize(n + count);
+  size_t *out = result.data() + n;
+  __m256i vt = _mm256_set1_epi32(threshold);
+  for(; i + 8 <= count; i += 8) {
+    __m256i gt = _mm256_cmpgt_epi32(_mm256_loadu_si256((const __m256i *)(data + i)), vt);
+    unsigned mask = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(gt));
+    for(size_t l=0; mask; mask >>= 1, l++) if(mask & 1) *out++ = baseIndex + i + l;
+  }
+  result.resize(out - result.data());
+  kernels::filterGreater<int32_t>(data + i, count - i, threshold, baseIndex + i, result);
+}
+
+//load 4 elements as doubles
+LO_TARGET_AVX2 inline __m256d load4(const float *data) {return _mm256_cvtps_pd(_mm_loadu_ps(data));}
+LO_TARGET_AVX2 inline __m256d load4(const double *data) {return _mm256_loadu_pd(data);}
+LO_TARGET_AVX2 inline __m256d load4(const int32_t *data) {return _mm256_cvtepi32_pd(_mm_loadu_si128((const __m128i *)data));}
+
+/**
+ * histogram with vectorized bin index computation. Only the counter increments are scalar
+ */
+template <typename T>
+LO_TARGET_AVX2 void histogram(const T *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  size_t i = 0;
+  if(binCount <= (size_t)std::numeric_limits<int32_t>::max()) {
+    const __m256d vlower = _mm256_set1_pd(lower), vscale = _mm256_set1_pd(binCount / (upper - lower));
+    const __m256d vzero = _mm256_setzero_pd(), vlast = _mm256_set1_pd((double)(binCount - 1));
+    for(; i + 8 <= count; i += 8) {
+      __m256d b0 = _mm256_mul_pd(_mm256_sub_pd(load4(data + i), vlower), vscale);
+      __m256d b1 = _mm256_mul_pd(_mm256_sub_pd(load4(data + i + 4), vlower), vscale);
+      b0 = _mm256_min_pd(_mm256_max_pd(b0, vzero), vlast);
+      b1 = _mm256_min_pd(_mm256_max_pd(b1, vzero), vlast);
+
+      int32_t idx[8];
+      _mm_storeu_si128((__m128i *)idx, _mm256_cvttpd_epi32(b0));
+      _mm_storeu_si128((__m128i *)(idx + 4), _mm256_cvttpd_epi32(b1));
+      for(int l=0; l<8; l++) bins[idx[l]]++;
+    }
+  }
+  kernels::histogram<T>(data + i, count - i, lower, upper, bins, binCount);
+}
+
+} //avx2
+
+/**
+ * @return true if the AVX2 kernels can be used on this CPU. Evaluated once
+ */
+inline bool hasAVX2()
+{
+#if defined(_MSC_VER)
+  return true; //only defined if compiled with /arch:AVX2
+#else
+  static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2") != 0);
+  return avx2;
+#endif
+}
+
+#endif //LO_KERNELS_AVX2
+
+#if defined(LO_KERNELS_SSE2)
+
+/*
+ * dispatching overloads for the vectorized types. They are preferred over the scalar templates by overload resolution
+ */
+
+#if defined(LO_KERNELS_AVX2)
+#define LO_KERNELS_DISPATCH(fn, ...) (hasAVX2() ? avx2::fn(__VA_ARGS__) : sse2::fn(__VA_ARGS__))
+#else
+#define LO_KERNELS_DISPATCH(fn, ...) sse2::fn(__VA_ARGS__)
+#endif
+
+inline void summarize(const float *data, size_t count, Summary<float> &summary)
+{
+  LO_KERNELS_DISPATCH(summarize, data, count, summary);
+}
+inline void summarize(const double *data, size_t count, Summary<double> &summary)
+{
+  LO_KERNELS_DISPATCH(summarize, data, count, summary);
+}
+inline void summarize(const int32_t *data, size_t count, Summary<int32_t> &summary)
+{
+  LO_KERNELS_DISPATCH(summarize, data, count, summary);
+}
+
+inline void filterGreater(const float *data, size_t count, float threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  LO_KERNELS_DISPATCH(filterGreater, data, count, threshold, baseIndex, result);
+}
+inline void filterGreater(const double *data, size_t count, double threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  LO_KERNELS_DISPATCH(filterGreater, data, count, threshold, baseIndex, result);
+}
+inline void filterGreater(const int32_t *data, size_t count, int32_t threshold, size_t baseIndex, std::vector<size_t> &result)
+{
+  LO_KERNELS_DISPATCH(filterGreater, data, count, threshold, baseIndex, result);
+}
+
+inline void histogram(const float *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  LO_KERNELS_DISPATCH(histogram<float>, data, count, lower, upper, bins, binCount);
+}
+inline void histogram(const double *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  LO_KERNELS_DISPATCH(histogram<double>, data, count, lower, upper, bins, binCount);
+}
+inline void histogram(const int32_t *data, size_t count, double lower, double upper, size_t *bins, size_t binCount)
+{
+  LO_KERNELS_DISPATCH(histogram<int32_t>, data, count, lower, upper, bins, binCount);
+}
+
+#undef LO_KERNELS_DISPATCH
+
+#endif //LO_KERNELS_SSE2
+
+} //kernels
+} //kv
+} //persistence
+} //lo
+
+#endif //LO_KVKERNELS_H
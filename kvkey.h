@@ -20,6 +20,8 @@
 #ifndef LO_KVPTR_H
 #define LO_KVPTR_H
 
+#include "kvarena.h"
+
 namespace lo {
 namespace persistence {
 namespace kv {
@@ -54,12 +56,19 @@ struct ObjectKey
  */
 template <typename T> struct object_handler : public ObjectKey
 {
+  //set if the object was allocated from a transaction arena
+  ObjectArena *arena = nullptr;
+
   object_handler(ObjectKey key) : ObjectKey(key.classId, key.objectId) {}
   object_handler(ClassId classId, ObjectId objectId) : ObjectKey(classId, objectId) {}
   object_handler() : ObjectKey(0, 0) {}
 
   void operator () (T *t) {
-    delete t;
+    if(arena) {
+      if(t) arena->destroy(t);
+    }
+    else
+      delete t;
   }
 };
 
@@ -83,6 +92,35 @@ static std::shared_ptr<T> make_ptr(T *t)
   return std::shared_ptr<T>(t, object_handler<T>());
 }
 
+/**
+ * wrap an object into a keyed shared_ptr. If arena is set, the object must have been created inside the arena,
+ * which then also hosts the shared_ptr control block
+ */
+template <typename T>
+static std::shared_ptr<T> make_ptr(T *t, object_handler<T> &handler, ObjectArena *arena)
+{
+  if(!arena) return std::shared_ptr<T>(t, handler);
+  handler.arena = arena;
+  return std::shared_ptr<T>(t, handler, ArenaAllocator<T>(arena));
+}
+
+/**
+ * assign an unkeyed object to a smart pointer. Only shared_ptr supports arena objects
+ */
+template <typename T>
+static void assign_ptr(std::shared_ptr<T> &ptr, T *t, ObjectArena *arena)
+{
+  if(arena)
+    ptr = std::shared_ptr<T>(t, arena_deleter<T>(arena), ArenaAllocator<T>(arena));
+  else
+    ptr = std::shared_ptr<T>(t);
+}
+template <typename T, typename D>
+static void assign_ptr(std::unique_ptr<T, D> &ptr, T *t, ObjectArena *arena)
+{
+  ptr = std::unique_ptr<T, D>(t);
+}
+
 } //kv
 } //persistence
 } //lo
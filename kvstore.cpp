@@ -302,6 +302,43 @@ bool KeyValueStoreBase::updateClassSchema(
   return true;
 }
 
+kv::ParallelCollectionLoad KeyValueStore::parallelLoad(unsigned threads)
+{
+  return kv::ParallelCollectionLoad(*this, threads);
+}
+
+kv::WriteTransactionPtr KeyValueStore::awaitWrite(unsigned needsKBs)
+{
+  unique_lock<mutex> lock(m_writeMutex);
+  while(true) {
+    try {
+      return beginWrite(needsKBs);
+    }
+    catch(invalid_argument &) {
+      //transactions dropped without commit or abort end without notice, so don't wait forever
+      m_writeEnded.wait_for(lock, chrono::milliseconds(50));
+    }
+  }
+}
+
+void KeyValueStore::write(const std::function<void(kv::WriteTransaction *)> &fn, unsigned needsKBs)
+{
+  while(true) {
+    kv::WriteTransactionPtr wtxn = beginWrite(needsKBs);
+    wtxn->setReplayable();
+    try {
+      fn(wtxn.get());
+      wtxn->commit();
+      return;
+    }
+    catch(kv::store_full_error &) {
+      //the store grows before the next transaction
+      wtxn->abort();
+      replayed();
+    }
+  }
+}
+
 namespace kv {
 
 static StoreId storeId = 0;
@@ -314,25 +351,309 @@ StoreId nextStoreId() {
   return ret;
 }
 
-void readObjectHeader(ReadBuf &buf, ClassId *classId, ObjectId *objectId, size_t *size, bool *deleted)
+ObjectCache::ObjectCache(const CacheOptions &options)
+    : m_options(options),
+      m_shardEntries(options.maxEntries ? (options.maxEntries + options.shards - 1) / options.shards : 0),
+      m_shardBytes(options.maxBytes ? (options.maxBytes + options.shards - 1) / options.shards : 0),
+      m_shards(new Shard[options.shards]),
+      m_hits(0), m_misses(0), m_evictions(0)
+{}
+
+void ObjectCache::unlink(Shard &shard, Entries::iterator it)
+{
+  if(shard.hand == it) ++shard.hand;
+  shard.bytes -= it->bytes;
+  shard.index.erase(it->id);
+  shard.entries.erase(it);
+}
+
+void ObjectCache::evict(Shard &shard)
+{
+  while(!shard.entries.empty()
+        && ((m_shardEntries && shard.entries.size() > m_shardEntries) || (m_shardBytes && shard.bytes > m_shardBytes)))
+  {
+    Entries::iterator victim;
+    if(m_options.eviction == CacheEviction::lru) {
+      victim = --shard.entries.end();
+    }
+    else {
+      //second chance: clear reference bits until an unreferenced entry comes along
+      while(true) {
+        if(shard.hand == shard.entries.end()) shard.hand = shard.entries.begin();
+        if(!shard.hand->referenced) break;
+        shard.hand->referenced = false;
+        ++shard.hand;
+      }
+      victim = shard.hand;
+    }
+    unlink(shard, victim);
+    m_evictions++;
+  }
+}
+
+shared_ptr<void> ObjectCache::get(ObjectId id, const type_info &type)
+{
+  Shard &sh = shard(id);
+  lock_guard<mutex> lock(sh.mutex);
+
+  auto found = sh.index.find(id);
+  if(found == sh.index.end() || *found->second->type != type) {
+    m_misses++;
+    return nullptr;
+  }
+  Entries::iterator it = found->second;
+  if(m_options.eviction == CacheEviction::lru)
+    sh.entries.splice(sh.entries.begin(), sh.entries, it);
+  else
+    it->referenced = true;
+
+  m_hits++;
+  return it->obj;
+}
+
+shared_ptr<void> ObjectCache::put(ObjectId id, shared_ptr<void> obj, const type_info &type, size_t bytes, bool replace)
+{
+  Shard &sh = shard(id);
+  lock_guard<mutex> lock(sh.mutex);
+
+  auto found = sh.index.find(id);
+  if(found != sh.index.end()) {
+    if(!replace && *found->second->type == type) return found->second->obj;
+    unlink(sh, found->second);
+  }
+  Entries::iterator it = m_options.eviction == CacheEviction::lru ?
+                         sh.entries.emplace(sh.entries.begin(), id, obj, &type, bytes) :
+                         sh.entries.emplace(sh.hand, id, obj, &type, bytes);
+  sh.index[id] = it;
+  sh.bytes += bytes;
+
+  evict(sh);
+  return obj;
+}
+
+void ObjectCache::erase(ObjectId id)
+{
+  Shard &sh = shard(id);
+  lock_guard<mutex> lock(sh.mutex);
+
+  auto found = sh.index.find(id);
+  if(found != sh.index.end()) unlink(sh, found->second);
+}
+
+void ObjectCache::clear()
+{
+  for(unsigned i=0; i<m_options.shards; i++) {
+    Shard &sh = m_shards[i];
+    lock_guard<mutex> lock(sh.mutex);
+
+    sh.index.clear();
+    sh.entries.clear();
+    sh.hand = sh.entries.end();
+    sh.bytes = 0;
+  }
+}
+
+CacheStats ObjectCache::stats()
+{
+  CacheStats stats;
+  stats.hits = m_hits;
+  stats.misses = m_misses;
+  stats.evictions = m_evictions;
+
+  for(unsigned i=0; i<m_options.shards; i++) {
+    Shard &sh = m_shards[i];
+    lock_guard<mutex> lock(sh.mutex);
+
+    stats.entries += sh.entries.size();
+    stats.bytes += sh.bytes;
+  }
+  return stats;
+}
+
+WriteQueue::WriteQueue(KeyValueStore &store, const WriteQueueOptions &options)
+    : m_store(store), m_options(options)
+{
+  m_writer = thread(&WriteQueue::writeLoop, this);
+}
+
+WriteQueue::~WriteQueue()
 {
-  ClassId cid = buf.readInteger<ClassId>(ClassId_sz);
-  if(classId) *classId = cid;
-  ObjectId oid = buf.readInteger<ObjectId>(ObjectId_sz);
-  if(objectId) *objectId = oid;
-  size_t sz = buf.readInteger<size_t>(4);
-  if(size) *size = sz;
-  byte_t del = buf.readInteger<byte_t>(1);
-  if(deleted) *deleted = del;
+  close();
+}
+
+void WriteQueue::enqueue(Operation &&op)
+{
+  lock_guard<mutex> lock(m_mutex);
+  if(m_closed) throw error("write queue closed");
+
+  m_queue.push_back(move(op));
+  m_pending++;
+
+  //wake the writer for the first operation of a batch, and when a batch is full
+  if(m_queue.size() == 1 || m_queue.size() >= m_options.maxBatch) m_queued.notify_one();
+}
+
+void WriteQueue::flush()
+{
+  unique_lock<mutex> lock(m_mutex);
+  m_done.wait(lock, [this] {return m_pending == 0;});
+}
+
+void WriteQueue::close()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    if(m_closed) return;
+    m_closed = true;
+  }
+  m_queued.notify_one();
+  if(m_writer.joinable()) m_writer.join();
+}
+
+void WriteQueue::writeLoop()
+{
+  vector<Operation> batch;
+  unique_lock<mutex> lock(m_mutex);
+
+  while(true) {
+    m_queued.wait(lock, [this] {return !m_queue.empty() || m_closed;});
+    if(m_queue.empty()) break;
+
+    //give concurrent producers the chance to join the batch
+    if(!m_closed && m_queue.size() < m_options.maxBatch) {
+      m_queued.wait_for(lock, m_options.maxDelay, [this] {
+        return m_queue.size() >= m_options.maxBatch || m_closed;
+      });
+    }
+
+    size_t count = m_queue.size() < m_options.maxBatch ? m_queue.size() : m_options.maxBatch;
+    batch.assign(make_move_iterator(m_queue.begin()), make_move_iterator(m_queue.begin() + count));
+    m_queue.erase(m_queue.begin(), m_queue.begin() + count);
+
+    lock.unlock();
+    writeBatch(batch);
+    batch.clear();
+    lock.lock();
+
+    m_pending -= count;
+    m_done.notify_all();
+  }
+}
+
+void WriteQueue::writeBatch(vector<Operation> &batch)
+{
+  vector<Operation *> ops;
+  for(auto &op : batch) ops.push_back(&op);
+
+  //number of operations in the current attempt. After a failure, the operations that succeeded before it are
+  //replayed alone, and the failed one gets one more try at the start of the next attempt
+  size_t count = ops.size();
+
+  while(!ops.empty()) {
+    WriteTransactionPtr wtxn;
+    try {
+      //another writer may be active outside the queue. Wait for it to finish
+      wtxn = m_store.awaitWrite();
+    }
+    catch(...) {
+      exception_ptr ex = current_exception();
+      for(Operation *op : ops) op->fail(ex);
+      return;
+    }
+    wtxn->setReplayable();
+
+    size_t failed = count;
+    bool full = false;
+    exception_ptr failure;
+    for(size_t i=0; i<count; i++) {
+      try {
+        ops[i]->apply(wtxn.get());
+      }
+      catch(store_full_error &) {
+        full = true;
+        break;
+      }
+      catch(...) {
+        failure = current_exception();
+        failed = i;
+        break;
+      }
+    }
+    if(full || failed < count) {
+      wtxn->abort();
+      if(full) {
+        //replay the same operations. The store grows before the next transaction
+        m_store.replayed();
+      }
+      else if(failed == 0) {
+        //failed again, or in a fresh transaction. Give up on it
+        ops.front()->fail(failure);
+        ops.erase(ops.begin());
+        count = ops.size();
+      }
+      else count = failed;
+      continue;
+    }
+
+    try {
+      wtxn->commit();
+    }
+    catch(store_full_error &) {
+      wtxn->abort();
+      m_store.replayed();
+      continue;
+    }
+    catch(...) {
+      exception_ptr ex = current_exception();
+      for(Operation *op : ops) op->fail(ex);
+      return;
+    }
+    for(size_t i=0; i<count; i++) ops[i]->complete();
+    ops.erase(ops.begin(), ops.begin() + count);
+    count = ops.size();
+  }
+}
+
+void readObjectHeader(ReadBuf &buf, StoreFormat format, ClassId *classId, ObjectId *objectId, size_t *size, bool *deleted)
+{
+  if(format == StoreFormat::compact) {
+    //[delete marker, varint classId, varint objectId, varint data size]
+    byte_t del = buf.readInteger<byte_t>(1);
+    if(deleted) *deleted = del;
+    ClassId cid = (ClassId)buf.readVarint();
+    if(classId) *classId = cid;
+    ObjectId oid = (ObjectId)buf.readVarint();
+    if(objectId) *objectId = oid;
+    size_t sz = (size_t)buf.readVarint();
+    if(size) *size = sz;
+  }
+  else {
+    //[classId, objectId, total size, delete marker]
+    ClassId cid = buf.readInteger<ClassId, ClassId_sz>();
+    if(classId) *classId = cid;
+    ObjectId oid = buf.readInteger<ObjectId, ObjectId_sz>();
+    if(objectId) *objectId = oid;
+    size_t sz = buf.readInteger<size_t, 4>();
+    if(size) *size = sz - ObjectHeader_sz;
+    byte_t del = buf.readInteger<byte_t, 1>();
+    if(deleted) *deleted = del;
+  }
+}
+
+size_t objectHeaderSize(StoreFormat format, ClassId classId, ObjectId objectId, size_t size)
+{
+  if(format == StoreFormat::compact)
+    return 1 + varint_size(classId) + varint_size(objectId) + varint_size(size);
+  return ObjectHeader_sz;
 }
 
 void readChunkHeader(ReadBuf &buf, size_t *dataSize, size_t *startIndex, size_t *elementCount)
 {
-  size_t val = buf.readInteger<size_t>(4);
+  size_t val = buf.readInteger<size_t, 4>();
   if(dataSize) *dataSize = val;
-  val = buf.readInteger<size_t>(4);
+  val = buf.readInteger<size_t, 4>();
   if(startIndex) *startIndex = val;
-  val = buf.readInteger<size_t>(4);
+  val = buf.readInteger<size_t, 4>();
   if(elementCount) *elementCount = val;
 }
 
@@ -340,18 +661,57 @@ void WriteTransaction::writeChunkHeader(size_t startIndex, size_t elementCount)
 {
   //write to start of buffer. Space is preallocated in startChunk
   byte_t *data = writeBuf().data();
-  write_integer(data, writeBuf().size(), 4);
-  write_integer(data+4, startIndex, 4);
-  write_integer(data+8, elementCount, 4);
+  write_integer<4>(data, writeBuf().size());
+  write_integer<4>(data+4, startIndex);
+  write_integer<4>(data+8, elementCount);
 }
 
 void WriteTransaction::writeObjectHeader(ClassId classId, ObjectId objectId, size_t size)
 {
+  if(store.format() == StoreFormat::compact) {
+    writeBuf().appendInteger<byte_t>(0, 1);
+    writeBuf().appendVarint(classId);
+    writeBuf().appendVarint(objectId);
+    writeBuf().appendVarint(size);
+    return;
+  }
   byte_t * hdr = writeBuf().allocate(ObjectHeader_sz);
-  write_integer<ClassId>(hdr, classId, ClassId_sz);
-  write_integer<ObjectId>(hdr+ClassId_sz, objectId, ObjectId_sz);
-  write_integer<size_t>(hdr+ClassId_sz+ObjectId_sz, size, 4);
-  write_integer<byte_t>(hdr+ClassId_sz+ObjectId_sz+4, 0, 1);
+  write_integer<ClassId_sz>(hdr, classId);
+  write_integer<ObjectId_sz>(hdr+ClassId_sz, objectId);
+  write_integer<4>(hdr+ClassId_sz+ObjectId_sz, size + ObjectHeader_sz);
+  write_integer<1>(hdr+ClassId_sz+ObjectId_sz+4, 0);
+}
+
+void WriteTransaction::updateIndexes(ClassId classId, ObjectId objectId, Properties *properties, byte_t *data, size_t size)
+{
+  byte_t value[IndexValue_maxsz];
+  ObjectKey key {classId, objectId};
+  ObjectBuf buf(data, size);
+
+  for(unsigned px=0, sz=properties->full_size(); px < sz; px++) {
+    const PropertyAccessBase *pa = properties->get(px);
+    if(!pa->enabled) continue;
+
+    buf.mark();
+    size_t psz = pa->storeinfo->size(store.id, buf);
+    if(pa->index && pa->storeinfo->layout == StoreLayout::all_embedded) {
+      buf.unmark(0);
+      size_t valueSize = pa->index->encode(buf.getReadBuf(), value);
+      putIndexEntry(pa->classId[store.id], pa->id, key, value, valueSize);
+    }
+    buf.unmark(psz);
+  }
+}
+
+void WriteTransaction::removeIndexes(ClassId classId, ObjectId objectId, Properties *properties)
+{
+  ObjectKey key {classId, objectId};
+
+  for(unsigned px=0, sz=properties->full_size(); px < sz; px++) {
+    const PropertyAccessBase *pa = properties->get(px);
+    if(pa->enabled && pa->index && pa->storeinfo->layout == StoreLayout::all_embedded)
+      removeIndexEntry(pa->classId[store.id], pa->id, key);
+  }
 }
 
 WriteTransaction::~WriteTransaction()
@@ -362,6 +722,13 @@ WriteTransaction::~WriteTransaction()
 
 void WriteTransaction::abort()
 {
+  m_savepoints.clear();
+  if(m_replayable) {
+    undoSideEffects(0, 0);
+    restoreIdCounters(m_replayIds);
+  }
+  m_cachePuts.clear();
+  m_keyResets.clear();
   _abort();
 }
 
@@ -372,7 +739,7 @@ void WriteTransaction::writeCollections()
     for(auto app : ci->appenders) app->close(false);
     ci->appenders.clear();
 
-    size_t sz = ObjectId_sz + sizeof(size_t) + ci->chunkInfos.size() * (PropertyId_sz + 3 * sizeof(size_t));
+    size_t sz = ObjectId_sz + sizeof(size_t) + ci->chunkInfos.size() * (PropertyId_sz + 3 * sizeof(size_t)) + 1;
     writeBuf().start(sz);
     writeBuf().appendRaw(ci->collectionId);
     writeBuf().appendRaw(ci->chunkInfos.size());
@@ -382,6 +749,7 @@ void WriteTransaction::writeCollections()
       writeBuf().appendRaw(ch.elementCount);
       writeBuf().appendRaw(ch.dataSize);
     }
+    writeBuf().appendRaw(ci->codec);
     putData(COLLINFO_CLSID, ci->collectionId, 0, writeBuf());
 
     delete ci;
@@ -389,23 +757,182 @@ void WriteTransaction::writeCollections()
   m_collectionInfos.clear();
 }
 
-void WriteTransaction::commit()
+void WriteTransaction::prepareCommit()
 {
+  while(!m_savepoints.empty()) {
+    doRelease();
+    m_savepoints.pop_back();
+  }
+  m_cachePuts.clear();
+  m_keyResets.clear();
   writeCollections();
+}
+
+void WriteTransaction::commit()
+{
+  prepareCommit();
+  doCommit();
+  releaseArena();
+  store.addStats(m_stats);
+}
+
+future<void> WriteTransaction::commitAsync()
+{
+  prepareCommit();
+  future<void> synced = doCommitAsync();
+  releaseArena();
+  store.addStats(m_stats);
+  return synced;
+}
+
+future<void> WriteTransaction::doCommitAsync()
+{
   doCommit();
+
+  promise<void> synced;
+  synced.set_value();
+  return synced.get_future();
+}
+
+void WriteTransaction::sealAppenders()
+{
+  for(auto &it : m_collectionInfos)
+    for(auto app : it.second->appenders) app->seal();
+
+  //appenders must not continue in chunk memory obtained before
+  writeBuf().start(nullptr, 0);
+}
+
+WriteTransaction::Savepoint WriteTransaction::savepoint()
+{
+  sealAppenders();
+
+  SavepointState state;
+  for(auto &it : m_collectionInfos) state.collectionInfos.emplace(it.first, *it.second);
+  state.idCounters = idCounters();
+  state.cachePuts = m_cachePuts.size();
+  state.keyResets = m_keyResets.size();
+
+  doSavepoint();
+  m_savepoints.push_back(move(state));
+
+  return m_savepoints.size();
+}
+
+void WriteTransaction::rollbackTo(Savepoint savepoint)
+{
+  if(!savepoint || savepoint > m_savepoints.size()) throw error("rollbackTo: invalid savepoint");
+
+  //later savepoints go away with this one
+  while(m_savepoints.size() > savepoint) {
+    doRollback();
+    m_savepoints.pop_back();
+  }
+  doRollback();
+  doSavepoint();
+
+  SavepointState &state = m_savepoints.back();
+
+  //cached objects and keys assigned after the savepoint carry ids that will be handed out again
+  undoSideEffects(state.cachePuts, state.keyResets);
+
+  //detach all appenders, those still open and known at the savepoint are reattached below
+  set<CollectionAppenderBase *> open;
+  for(auto &it : m_collectionInfos)
+    for(auto app : it.second->appenders) {
+      app->rollback(nullptr);
+      open.insert(app);
+    }
+
+  for(auto it = m_collectionInfos.begin(); it != m_collectionInfos.end(); ) {
+    if(!state.collectionInfos.count(it->first)) {
+      delete it->second;
+      it = m_collectionInfos.erase(it);
+    }
+    else it++;
+  }
+  for(auto &it : state.collectionInfos) {
+    CollectionInfo *&ci = m_collectionInfos[it.first];
+    if(ci) *ci = it.second;
+    else ci = new CollectionInfo(it.second);
+
+    for(auto app = ci->appenders.begin(); app != ci->appenders.end(); ) {
+      if(open.count(*app)) {
+        (*app)->rollback(ci);
+        app++;
+      }
+      else app = ci->appenders.erase(app);
+    }
+  }
+  restoreIdCounters(state.idCounters);
+  writeBuf().start(nullptr, 0);
+  m_chunkCache.clear();
+}
+
+void WriteTransaction::release(Savepoint savepoint)
+{
+  if(!savepoint || savepoint > m_savepoints.size()) throw error("release: invalid savepoint");
+
+  sealAppenders();
+  while(m_savepoints.size() >= savepoint) {
+    doRelease();
+    m_savepoints.pop_back();
+  }
+  if(!recording()) {
+    m_cachePuts.clear();
+    m_keyResets.clear();
+  }
+}
+
+void WriteTransaction::setReplayable()
+{
+  m_replayIds = idCounters();
+  m_replayable = true;
+}
+
+vector<pair<ClassId, ObjectId>> WriteTransaction::idCounters()
+{
+  vector<pair<ClassId, ObjectId>> counters;
+  for(ClassId classId : store.registeredClasses())
+    counters.push_back(make_pair(classId, *store.idCounter(classId)));
+  counters.push_back(make_pair(COLLECTION_CLSID, store.m_maxCollectionId));
+  return counters;
+}
+
+void WriteTransaction::restoreIdCounters(const vector<pair<ClassId, ObjectId>> &counters)
+{
+  for(auto &counter : counters) {
+    ObjectId *id = store.idCounter(counter.first);
+    if(id) *id = counter.second;
+  }
+}
+
+void WriteTransaction::undoSideEffects(size_t cachePuts, size_t keyResets)
+{
+  for(size_t i=cachePuts; i<m_cachePuts.size(); i++)
+    store.evictCached(m_cachePuts[i].first, m_cachePuts[i].second);
+  m_cachePuts.resize(cachePuts);
+
+  //latest first, an object may have been saved more than once
+  for(size_t i=m_keyResets.size(); i > keyResets; i--) m_keyResets[i-1]();
+  m_keyResets.resize(keyResets);
 }
 
 Transaction::~Transaction()
 {
   for(auto &it : m_collectionInfos) delete it.second;
   m_collectionInfos.clear();
+  releaseArena();
 }
 
 void Transaction::_abort()
 {
   for(auto &it : m_collectionInfos) delete it.second;
   m_collectionInfos.clear();
+  m_chunkCache.clear();
+  releaseArena();
   doAbort();
+  store.addStats(m_stats);
 }
 
 void ReadTransaction::end()
@@ -416,11 +943,13 @@ void ReadTransaction::end()
 void Transaction::reset()
 {
   //keep collection infos alive
+  releaseArena();
   doReset();
 }
 
 void Transaction::renew()
 {
+  m_chunkCache.clear();
   doRenew();
 }
 
@@ -442,6 +971,8 @@ CollectionInfo *Transaction::readCollectionInfo(ReadBuf &readBuf)
     size_t dataSize = readBuf.readRaw<size_t>();
     info->chunkInfos.push_back(ChunkInfo(chunkId, startIndex, elementCount, dataSize));
   }
+  //collections saved before codecs were introduced end here
+  if(!readBuf.atEnd()) info->codec = readBuf.readRaw<ChunkCodec>();
   //put into transaction cache
   m_collectionInfos[info->collectionId] = info;
 
@@ -481,6 +1012,7 @@ void WriteTransaction::deleteCollection(ObjectId collectionId)
   CollectionInfo *ci = getCollectionInfo(collectionId, false);
   if(ci) {
     m_collectionInfos.erase(collectionId);
+    m_chunkCache.erase(collectionId);
     if(!remove(COLLINFO_CLSID, collectionId, 0))
       throw error("error deleting collection info");
     for(auto chunk : ci->chunkInfos)
@@ -489,6 +1021,92 @@ void WriteTransaction::deleteCollection(ObjectId collectionId)
   }
 }
 
+void WriteTransaction::setCollectionCodec(ObjectId &collectionId, ChunkCodec codec)
+{
+  CollectionInfo *ci = getCollectionInfo(collectionId);
+  if(!ci) throw error("collection not found");
+  ci->codec = codec;
+}
+
+size_t WriteTransaction::packCollection(ObjectId collectionId)
+{
+  CollectionInfo *ci = getCollectionInfo(collectionId, false);
+  if(!ci || ci->chunkInfos.empty()) return 0;
+  if(!ci->appenders.empty()) throw error("packCollection: collection has open appenders");
+
+  const size_t maxPayload = store.getOptimalChunkSize();
+
+  //a run of adjacent uncompressed chunks that will be written as one
+  std::vector<ChunkInfo> packed;
+  std::vector<byte_t> payload;
+  std::vector<PropertyId> obsolete;
+  ChunkInfo run;
+  size_t runChunks = 0, rewritten = 0;
+  bool runSparse = false;
+
+  auto flush = [&]() {
+    if(!runChunks) return;
+    if(runChunks > 1 || runSparse) {
+      byte_t *data = nullptr;
+      size_t size = ChunkHeader_sz + payload.size();
+      if(!allocData(COLLECTION_CLSID, collectionId, run.chunkId, size, &data))
+        throw error("allocData failed");
+      write_integer<4>(data, size);
+      write_integer<4>(data+4, run.startIndex);
+      write_integer<4>(data+8, run.elementCount);
+      if(!payload.empty()) memcpy(data + ChunkHeader_sz, payload.data(), payload.size());
+
+      run.dataSize = size;
+      rewritten += runChunks;
+    }
+    packed.push_back(run);
+    payload.clear();
+    runChunks = 0;
+    runSparse = false;
+  };
+
+  for(ChunkInfo &chunk : ci->chunkInfos) {
+    ReadBuf readBuf;
+    getData(readBuf, COLLECTION_CLSID, collectionId, chunk.chunkId);
+    if(readBuf.null()) throw error("packCollection: missing collection chunk");
+
+    if(ChunkCache::compressed(readBuf.data(), readBuf.size())) {
+      //compressed chunks are already dense
+      flush();
+      packed.push_back(chunk);
+      continue;
+    }
+    //the size in the chunk header is not maintained for chunks written in one go
+    size_t dataSize = chunk.dataSize < readBuf.size() ? chunk.dataSize : readBuf.size();
+    size_t chunkPayload = dataSize - ChunkHeader_sz;
+
+    if(runChunks && payload.size() + chunkPayload > maxPayload) flush();
+    if(runChunks) {
+      run.elementCount += chunk.elementCount;
+      obsolete.push_back(chunk.chunkId);
+    }
+    else run = chunk;
+
+    //appenders leave unused space at the end of the chunk
+    if(readBuf.size() > dataSize) runSparse = true;
+
+    //copy out, the chunk memory may be invalidated by the writes below
+    payload.insert(payload.end(), readBuf.data() + ChunkHeader_sz, readBuf.data() + dataSize);
+    runChunks++;
+  }
+  flush();
+
+  if(rewritten) {
+    for(PropertyId chunkId : obsolete) {
+      if(!remove(COLLECTION_CLSID, collectionId, chunkId))
+        throw error("error deleting collection chunk");
+    }
+    ci->chunkInfos = packed;
+    m_chunkCache.erase(collectionId);
+  }
+  return rewritten;
+}
+
 void LazyBuf::checkData() {
   ObjectBuf::checkData(m_txn, key.classId, key.objectId);
 }
@@ -512,8 +1130,65 @@ void WriteTransaction::startChunk(CollectionInfo *collectionInfo, size_t chunkSi
   collectionInfo->nextChunkId++;
 }
 
+void WriteTransaction::compressChunk(CollectionInfo *collectionInfo)
+{
+  if(collectionInfo->codec == ChunkCodec::none || collectionInfo->chunkInfos.empty()) return;
+
+  const byte_t *chunk = writeBuf().data();
+  size_t chunkSize = writeBuf().size();
+  if(chunkSize <= ChunkHeader_sz) return;
+
+  //compress into a temporary buffer first, the chunk memory is released when the key is overwritten
+  std::vector<byte_t> buf(ChunkHeader_sz + 1 + codec::lz_bound(chunkSize - ChunkHeader_sz));
+  size_t size = codec::lz_compress(chunk + ChunkHeader_sz, chunkSize - ChunkHeader_sz, buf.data() + ChunkHeader_sz + 1);
+  size += ChunkHeader_sz + 1;
+  if(size >= chunkSize) return;
+
+  memcpy(buf.data(), chunk, ChunkHeader_sz);
+  write_integer(buf.data(), chunkSize | ChunkCompressed_flag, 4);
+  buf[ChunkHeader_sz] = (byte_t)collectionInfo->codec;
+
+  byte_t *data = nullptr;
+  if(!allocData(COLLECTION_CLSID, collectionInfo->collectionId, collectionInfo->chunkInfos.back().chunkId, size, &data))
+    throw error("allocData failed");
+  memcpy(data, buf.data(), size);
+
+  //chunk is complete, leave no room for appending
+  writeBuf().start(data, size, size);
+}
+
+ChunkCache::Buffer ChunkCache::get(ObjectId collectionId, PropertyId chunkId, const byte_t *data, size_t size)
+{
+  for(auto it = m_entries.begin(); it != m_entries.end(); it++) {
+    if(it->collectionId == collectionId && it->chunkId == chunkId) {
+      m_entries.splice(m_entries.begin(), m_entries, it);
+      return it->data;
+    }
+  }
+  if(m_entries.size() >= m_capacity) m_entries.pop_back();
+
+  size_t chunkSize = read_integer<size_t>(data, 4) & ~ChunkCompressed_flag;
+  Buffer chunk = std::make_shared<std::vector<byte_t>>(chunkSize);
+  memcpy(chunk->data(), data, ChunkHeader_sz);
+  write_integer(chunk->data(), chunkSize, 4);
+
+  const byte_t *src = data + ChunkHeader_sz + 1;
+  size_t srcSize = size - ChunkHeader_sz - 1;
+  switch((ChunkCodec)data[ChunkHeader_sz]) {
+    case ChunkCodec::lz:
+      if(!codec::lz_decompress(src, srcSize, chunk->data() + ChunkHeader_sz, chunkSize - ChunkHeader_sz))
+        throw error("corrupt compressed chunk");
+      break;
+    default:
+      throw error("unknown chunk codec");
+  }
+  m_entries.push_front(Entry {collectionId, chunkId, chunk});
+  return chunk;
+}
+
 CollectionCursorBase::CollectionCursorBase(ObjectId collectionId, Transaction *tr, ChunkCursor::Ptr chunkCursor)
-  : m_collectionInfo(tr->getCollectionInfo(collectionId)), m_tr(tr), m_chunkCursor(chunkCursor), m_storeId(tr->store.id)
+  : m_collectionInfo(tr->getCollectionInfo(collectionId)), m_tr(tr), m_chunkCursor(chunkCursor), m_storeId(tr->store.id),
+    m_format(tr->store.format())
 {
   if(!m_chunkCursor->atEnd()) {
     m_chunkCursor->get(m_readBuf);
@@ -572,8 +1247,8 @@ void CollectionCursorBase::objectBufSeek(size_t position)
     for(size_t pos=0, epos=position-m_curElement; pos < epos; ) {
       size_t sz;
       bool deleted;
-      readObjectHeader(m_readBuf, 0, 0, &sz, &deleted);
-      m_readBuf.read(sz-ObjectHeader_sz);
+      readObjectHeader(m_readBuf, m_format, 0, 0, &sz, &deleted);
+      m_readBuf.read(sz);
       if(!deleted) pos++;
     }
   }
@@ -583,8 +1258,8 @@ void CollectionCursorBase::objectBufSeek(size_t position)
     for(size_t pos=0; pos < position; ) {
       size_t sz;
       bool deleted;
-      readObjectHeader(m_readBuf, 0, 0, &sz, &deleted);
-      m_readBuf.read(sz-ObjectHeader_sz);
+      readObjectHeader(m_readBuf, m_format, 0, 0, &sz, &deleted);
+      m_readBuf.read(sz);
       if(!deleted) pos++;
     }
   }
@@ -617,6 +1292,7 @@ void CollectionAppenderBase::startChunk(size_t size)
     ci.elementCount = m_elementCount;
 
     m_tr->writeChunkHeader(ci.startIndex, ci.elementCount);
+    m_tr->compressChunk(m_collectionInfo);
     m_collectionInfo->nextStartIndex += m_elementCount;
   }
   //allocate a new chunk
@@ -629,23 +1305,36 @@ void CollectionAppenderBase::startChunk(size_t size)
     m_writeBuf.allocate(ChunkHeader_sz); //reserve for writing later
 
     m_collectionInfo->nextChunkId++;
+    m_sealed = false;
   }
   else throw error("allocData failed");
 
   m_elementCount = 0;
 }
 
+void CollectionAppenderBase::seal()
+{
+  if(m_collectionInfo && !m_sealed) {
+    close(false);
+    m_collectionInfo->nextStartIndex += m_elementCount;
+    m_elementCount = 0;
+    m_sealed = true;
+  }
+}
+
 void CollectionAppenderBase::close(bool erase)
 {
-  if(m_collectionInfo && !m_collectionInfo->chunkInfos.empty()) {
+  if(m_collectionInfo && erase) m_collectionInfo->appenders.erase(this);
+
+  //nothing to finish if the current chunk was sealed
+  if(m_collectionInfo && !m_collectionInfo->chunkInfos.empty() && !m_sealed) {
     ChunkInfo &ci = m_collectionInfo->chunkInfos.back();
     if(!ci.startIndex) ci.startIndex = m_collectionInfo->nextStartIndex;
     ci.elementCount += m_elementCount;
     ci.dataSize = m_writeBuf.size();
 
-    if(erase) m_collectionInfo->appenders.erase(this);
-
     m_tr->writeChunkHeader(ci.startIndex, ci.elementCount);
+    m_tr->compressChunk(m_collectionInfo);
   }
 }
 
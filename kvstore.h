@@ -25,12 +25,23 @@
 #include <typeindex>
 #include <memory>
 #include <functional>
+#include <algorithm>
 #include <set>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <future>
+#include <condition_variable>
+#include <deque>
+#include <chrono>
 #include <unordered_map>
 #include <type_traits>
 #include <cstdlib>
 
 #include "kvtraits.h"
+#include "kvkernels.h"
+#include "kvcodec.h"
 
 #define PROPERTY_ID(__cls, __name) lo::persistence::kv::ClassTraits<__cls>::__name->id
 #define PROPERTY(__cls, __name) lo::persistence::kv::ClassTraits<__cls>::__name
@@ -49,6 +60,10 @@ static const kv::ClassId COLLECTION_CLSID = 1;
  * predefined ClassId for collection metadata
  */
 static const kv::ClassId COLLINFO_CLSID = 2;
+/**
+ * predefined ClassId for store-wide settings
+ */
+static const kv::ClassId STOREINFO_CLSID = 3;
 
 /**
  * data structures and enums used during schema validation
@@ -128,6 +143,9 @@ class ReadTransaction;
 class ExclusiveReadTransaction;
 class WriteTransaction;
 template <typename T> class ClassCursor;
+template <typename T> class ParallelScan;
+class ParallelCollectionLoad;
+class WriteQueue;
 
 using TransactionPtr = std::shared_ptr<kv::Transaction>;
 using ReadTransactionPtr = std::shared_ptr<kv::ReadTransaction>;
@@ -138,34 +156,195 @@ using ObjectProperties = std::unordered_map<ClassId, Properties *>;
 using ObjectClassInfos = std::unordered_map<ClassId, AbstractClassInfo *>;
 
 /**
- * object cache interface
+ * eviction policy used by ObjectCache
  */
-struct ObjectCache {
-  virtual ~ObjectCache() {}
+enum class CacheEviction {
+  /** least recently used entries are evicted first. Each hit moves the entry to the front of its shard */
+  lru,
+  /** second-chance (CLOCK) eviction. Hits only set a reference bit, which makes them cheaper under contention */
+  clock
+};
 
-  template <typename T> std::shared_ptr<T> &get(ObjectId id);
-  template <typename T> void put(ObjectId id, std::shared_ptr<T> ptr);
-  template <typename T> void erase(ObjectId id);
+/**
+ * object cache configuration. A value of 0 for maxEntries and maxBytes means unbounded
+ */
+struct CacheOptions {
+  size_t maxEntries;
+  size_t maxBytes;
+  CacheEviction eviction;
+  unsigned shards;
+
+  CacheOptions(size_t maxEntries=0, size_t maxBytes=0, CacheEviction eviction=CacheEviction::lru, unsigned shards=16)
+      : maxEntries(maxEntries), maxBytes(maxBytes), eviction(eviction), shards(shards ? shards : 1) {}
 };
+
 /**
- * map-based object cache implementation
+ * object cache statistics
  */
-template <typename T>
-struct TypedObjectCache : public ObjectCache {
-  std::unordered_map<ObjectId, std::shared_ptr<T>> objects;
+struct CacheStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+  size_t entries = 0;
+  size_t bytes = 0;
 };
 
-template <typename T> std::shared_ptr<T> &ObjectCache::get(ObjectId id) {
-  return dynamic_cast<TypedObjectCache<T> *>(this)->objects[id];
-}
+/**
+ * operation counters of a transaction. Counters are plain integers that are only touched by the thread that owns
+ * the transaction, so counting is cheap enough to stay enabled
+ */
+struct TransactionStats {
+  //single-key reads and bytes returned, including reads through cursors
+  uint64_t reads = 0;
+  uint64_t bytesRead = 0;
+  //single-key writes (put and allocate) and bytes written
+  uint64_t writes = 0;
+  uint64_t bytesWritten = 0;
+  //deleted keys
+  uint64_t removes = 0;
+  //cursor positioning operations
+  uint64_t cursorSteps = 0;
+  //refcount writes, decrements and removals
+  uint64_t refcountUpdates = 0;
+  //bulk load writes that took the append path, and writes that had to fall back to a normal put because the key
+  //did not sort after the last key in the database
+  uint64_t appends = 0;
+  uint64_t appendFallbacks = 0;
+  //object cache lookups
+  uint64_t cacheHits = 0;
+  uint64_t cacheMisses = 0;
+
+  TransactionStats &operator += (const TransactionStats &other) {
+    reads += other.reads;
+    bytesRead += other.bytesRead;
+    writes += other.writes;
+    bytesWritten += other.bytesWritten;
+    removes += other.removes;
+    cursorSteps += other.cursorSteps;
+    refcountUpdates += other.refcountUpdates;
+    appends += other.appends;
+    appendFallbacks += other.appendFallbacks;
+    cacheHits += other.cacheHits;
+    cacheMisses += other.cacheMisses;
+    return *this;
+  }
+};
 
-template <typename T> void ObjectCache::put(ObjectId id, std::shared_ptr<T> ptr) {
-  dynamic_cast<TypedObjectCache<T> *>(this)->objects[id] = ptr;
-}
+/**
+ * cumulative operation counters of a store. Transaction counters are added when the transaction ends
+ */
+struct StoreStats : public TransactionStats {
+  //completed transactions
+  uint64_t transactions = 0;
+  //memory map size increases
+  uint64_t mapResizes = 0;
+  //write transactions that ran out of space
+  uint64_t mapFullErrors = 0;
+  //write transactions replayed by KeyValueStore::write after running out of space
+  uint64_t replays = 0;
+};
 
-template <typename T> void ObjectCache::erase(ObjectId id) {
-  dynamic_cast<TypedObjectCache<T> *>(this)->objects.erase(id);
-}
+/**
+ * result of KeyValueStore::compact
+ */
+struct CompactStats {
+  //database file size before and after compaction
+  size_t sizeBefore = 0;
+  size_t sizeAfter = 0;
+  //collection chunks that were merged or trimmed
+  size_t chunksRewritten = 0;
+  //elapsed time
+  std::chrono::milliseconds duration {0};
+
+  /**
+   * @return the number of bytes reclaimed
+   */
+  size_t reclaimed() const {return sizeBefore > sizeAfter ? sizeBefore - sizeAfter : 0;}
+};
+
+/**
+ * bounded, thread-safe object cache. The cache is divided into lock-striped shards (selected by ObjectId), each of
+ * which maintains its own eviction order and an equal share of the configured bounds. One cache is maintained per class.
+ * Objects are held type-erased, together with the type they were put as. A lookup with a different type is a miss
+ */
+class ObjectCache
+{
+  struct Entry {
+    ObjectId id;
+    std::shared_ptr<void> obj;
+    const std::type_info *type;
+    size_t bytes;
+    bool referenced;
+
+    Entry(ObjectId id, std::shared_ptr<void> obj, const std::type_info *type, size_t bytes)
+        : id(id), obj(obj), type(type), bytes(bytes), referenced(false) {}
+  };
+  using Entries = std::list<Entry>;
+
+  struct Shard {
+    std::mutex mutex;
+    Entries entries;
+    std::unordered_map<ObjectId, Entries::iterator> index;
+    Entries::iterator hand;
+    size_t bytes = 0;
+
+    Shard() : hand(entries.end()) {}
+  };
+
+  const CacheOptions m_options;
+  const size_t m_shardEntries, m_shardBytes;
+  std::unique_ptr<Shard[]> m_shards;
+
+  std::atomic<uint64_t> m_hits, m_misses, m_evictions;
+
+  Shard &shard(ObjectId id) {
+    return m_shards[id % m_options.shards];
+  }
+
+  void unlink(Shard &shard, Entries::iterator it);
+  void evict(Shard &shard);
+
+  std::shared_ptr<void> get(ObjectId id, const std::type_info &type);
+  std::shared_ptr<void> put(ObjectId id, std::shared_ptr<void> obj, const std::type_info &type, size_t bytes, bool replace);
+
+public:
+  ObjectCache(const CacheOptions &options=CacheOptions());
+
+  /**
+   * @return the cached object, or an empty pointer if the object is not cached
+   */
+  template <typename T> std::shared_ptr<T> get(ObjectId id) {
+    return std::static_pointer_cast<T>(get(id, typeid(T)));
+  }
+
+  /**
+   * put an object into the cache.
+   *
+   * @param bytes the estimated memory footprint of the object, used for byte-bounded caches
+   * @param replace if false and the object is already cached, the cached object is left in place and returned
+   * @return the object that is now in the cache
+   */
+  template <typename T> std::shared_ptr<T> put(ObjectId id, const std::shared_ptr<T> &ptr, size_t bytes, bool replace=true) {
+    return std::static_pointer_cast<T>(put(id, std::static_pointer_cast<void>(ptr), typeid(T), bytes, replace));
+  }
+
+  /**
+   * remove an object from the cache
+   */
+  void erase(ObjectId id);
+
+  /**
+   * remove all objects from the cache. Statistics are not reset
+   */
+  void clear();
+
+  /**
+   * @return the current statistics
+   */
+  CacheStats stats();
+
+  const CacheOptions &options() const {return m_options;}
+};
 
 /**
  * global function for assigning storage IDs
@@ -267,10 +446,12 @@ struct validate_info {
   const kv::PropertyAccessBase *** const decl_props;
   kv::Properties * const properties;
   const unsigned num_decl_props;
+  void (* const buildDispatch)(kv::StoreId storeId);
 
   validate_info(kv::AbstractClassInfo *classInfo, kv::ClassData *cdata, kv::Properties *properties, const kv::PropertyAccessBase ** decl_props[],
-                unsigned num_decl_props)
-      : classInfo(classInfo), cdata(cdata), properties(properties), decl_props(decl_props), num_decl_props(num_decl_props) {}
+                unsigned num_decl_props, void (*buildDispatch)(kv::StoreId))
+      : classInfo(classInfo), cdata(cdata), properties(properties), decl_props(decl_props), num_decl_props(num_decl_props),
+        buildDispatch(buildDispatch) {}
 };
 
 //primary template
@@ -287,7 +468,7 @@ struct collect_types<S>
 
     vinfos.push_back(
         validate_info(Traits::traits_info, &Traits::traits_data(storeId), Traits::traits_properties,
-                      Traits::decl_props, Traits::num_decl_props));
+                      Traits::decl_props, Traits::num_decl_props, &Traits::buildDispatch));
 
     Traits::init();
   }
@@ -336,6 +517,8 @@ class KeyValueStore : public KeyValueStoreBase
   friend class kv::ExclusiveReadTransaction;
   friend class kv::WriteTransaction;
   template <typename T> friend class kv::ClassCursor;
+  template <typename T> friend class kv::ParallelScan;
+  friend class kv::WriteQueue;
 
   //backward mapping from ClassId, used during polymorphic operations
   kv::ObjectProperties objectProperties;
@@ -359,37 +542,106 @@ class KeyValueStore : public KeyValueStoreBase
   std::unordered_map<TypeInfoRef, kv::ClassId, TypeinfoHasher, TypeinfoEqualTo> objectTypeInfos;
   std::unordered_map<kv::ClassId, std::shared_ptr<kv::ObjectCache>> objectCaches;
 
+  kv::ObjectCache *getCache(kv::ClassId classId)
+  {
+    auto it = objectCaches.find(classId);
+    return it != objectCaches.end() ? it->second.get() : nullptr;
+  }
+
   template <typename T> inline
-  std::shared_ptr<T> putCache(T *obj, kv::object_handler<T> handler)
+  std::shared_ptr<T> putCache(T *obj, kv::object_handler<T> handler, size_t bytes=0)
   {
     std::shared_ptr<T> result = std::shared_ptr<T>(obj, handler);
-    objectCaches[handler.classId]->put(handler.objectId, result);
-    return result;
+    kv::ObjectCache *cache = getCache(handler.classId);
+    return cache ? cache->put(handler.objectId, result, sizeof(T) + bytes, false) : result;
   }
 
   template <typename T> inline
-  std::shared_ptr<T> &getCached(kv::ClassId classId, kv::ObjectId objectId)
+  void putCache(kv::ClassId classId, kv::ObjectId objectId, const std::shared_ptr<T> &obj)
   {
-#ifdef _MSC_VER
-    return objectCaches[classId]->ObjectCache::get<T>(objectId);
-#else
-    return objectCaches[classId]->template ObjectCache::get<T>(objectId);
-#endif
+    kv::ObjectCache *cache = getCache(classId);
+    if(cache) cache->put(objectId, obj, sizeof(T));
+  }
+
+  template <typename T> inline
+  std::shared_ptr<T> getCached(kv::ClassId classId, kv::ObjectId objectId)
+  {
+    kv::ObjectCache *cache = getCache(classId);
+    return cache ? cache->get<T>(objectId) : std::shared_ptr<T>();
   }
 
   template <typename T> inline
   void removeCached(kv::ClassId classId, kv::ObjectId objectId)
   {
-#ifdef _MSC_VER
-    return objectCaches[classId]->ObjectCache::erase<T>(objectId);
-#else
-    objectCaches[classId]->template ObjectCache::erase<T>(objectId);
-#endif
+    kv::ObjectCache *cache = getCache(classId);
+    if(cache) cache->erase(objectId);
+  }
+
+  void evictCached(kv::ClassId classId, kv::ObjectId objectId)
+  {
+    kv::ObjectCache *cache = getCache(classId);
+    if(cache) cache->erase(objectId);
+  }
+
+  kv::StoreStats m_stats;
+  std::mutex m_statsMutex;
+
+  //signalled when a write transaction or a transaction that blocks writes has ended
+  std::mutex m_writeMutex;
+  std::condition_variable m_writeEnded;
+
+  void addStats(const kv::TransactionStats &stats) {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats += stats;
+    m_stats.transactions++;
   }
 
 protected:
   kv::ClassId m_maxClassId = kv::AbstractClassInfo::MIN_USER_CLSID;
   kv::ObjectId m_maxCollectionId = 0;
+  kv::StoreFormat m_format = kv::StoreFormat::fixed;
+
+  void mapResized() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.mapResizes++;
+  }
+
+  /**
+   * wake up threads waiting in awaitWrite(). Called by the backend when a transaction that prevented writing has ended
+   */
+  void writeEnded() {
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    m_writeEnded.notify_all();
+  }
+
+  void mapFull() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.mapFullErrors++;
+  }
+
+  void replayed() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.replays++;
+  }
+
+  /**
+   * @return the in-memory ObjectId counter of the given registered class, or nullptr if the class is unknown.
+   * COLLECTION_CLSID yields the collection id counter
+   */
+  kv::ObjectId *idCounter(kv::ClassId classId) {
+    if(classId == COLLECTION_CLSID) return &m_maxCollectionId;
+    auto it = objectClassInfos.find(classId);
+    return it != objectClassInfos.end() ? &it->second->data[id].maxObjectId : nullptr;
+  }
+
+  /**
+   * @return the ids of all registered classes
+   */
+  std::vector<kv::ClassId> registeredClasses() {
+    std::vector<kv::ClassId> classIds;
+    for(auto &it : objectClassInfos) classIds.push_back(it.first);
+    return classIds;
+  }
 
 public:
   /**
@@ -457,6 +709,8 @@ public:
       objectClassInfos[info.classInfo->data[id].classId] = info.classInfo;
       objectTypeInfos[info.classInfo->typeinfo] = info.classInfo->data[id].classId;
     }
+    //all classIds are known now, precompute the property dispatch tables
+    for(auto &info : vinfos) info.buildDispatch(id);
     if(!schemaError.empty()) {
       for(auto &info : vinfos)
         if(info.classInfo->compatibility < requiredCompatibility)
@@ -486,17 +740,18 @@ public:
    *
    * @param cache whether caching should be turned on or off
    * @param owner an owner id returned from a previous call to this function
+   * @param options cache bounds and eviction policy. The default is an unbounded cache
    * @return a non-0 owner id if the operation was performed successfully, or 0 if it was rejected but the
    * setting is already as requested
    * @throw error if the setting is already owned and not the same as requested
    */
   template <typename T>
-  unsigned setCache(bool cache=true, unsigned owner=0) {
+  unsigned setCache(bool cache=true, unsigned owner=0, const kv::CacheOptions &options=kv::CacheOptions()) {
     if(kv::ClassTraits<T>::traits_data(id).cacheOwner == owner) {
       if(owner == 0) kv::ClassTraits<T>::traits_data(id).cacheOwner = owner = rand()+1;
 
       if(cache)
-        objectCaches[kv::ClassTraits<T>::traits_data(id).classId] = std::make_shared<kv::TypedObjectCache<T>>();
+        objectCaches[kv::ClassTraits<T>::traits_data(id).classId] = std::make_shared<kv::ObjectCache>(options);
       else
         objectCaches.erase(kv::ClassTraits<T>::traits_data(id).classId);
 
@@ -517,6 +772,28 @@ public:
     return (bool)kv::ClassTraits<T>::traits_data(id).cacheOwner;
   }
 
+  /**
+   * @return the on-disk format of this store
+   */
+  kv::StoreFormat format() const {return m_format;}
+
+  /**
+   * @return a snapshot of the cumulative operation counters of all completed transactions
+   */
+  kv::StoreStats stats() {
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+  }
+
+  /**
+   * @return the statistics of the object cache configured for the given class. All values are 0 if caching is off
+   */
+  template <typename T>
+  kv::CacheStats cacheStats() {
+    kv::ObjectCache *cache = getCache(kv::ClassTraits<T>::traits_data(id).classId);
+    return cache ? cache->stats() : kv::CacheStats();
+  }
+
   /**
    * configure refcounting for the given template parameter class. When refcounting is on, a separate entry will
    * be written for each object which holds the reference count. The reference count will be incremented whenever
@@ -604,12 +881,91 @@ public:
    * blocked by an exclusive read transaction
    */
   virtual kv::WriteTransactionPtr beginWrite(unsigned needsKBs=0) = 0;
+
+  /**
+   * like beginWrite, but wait for a running write transaction or a transaction that blocks writes to end
+   * instead of throwing
+   *
+   * @param needsKBs database space required by this transaction, see #beginWrite
+   * @return a transaction object that allows reading + writing the database.
+   */
+  kv::WriteTransactionPtr awaitWrite(unsigned needsKBs=0);
+
+  /**
+   * begin a write transaction for loading large numbers of new objects, e.g. an initial import. Keys are appended
+   * to the end of the database where they sort after the last existing key, which is the case for new objects of
+   * the class with the highest ClassId. Other keys are written normally and counted in
+   * TransactionStats::appendFallbacks. Property values of an object are held back until the object itself is
+   * written, and cannot be read within the transaction before that.
+   *
+   * @param needsKBs database space required by this transaction, see #beginWrite
+   * @return a write transaction, see #beginWrite
+   */
+  virtual kv::WriteTransactionPtr beginBulkLoad(unsigned needsKBs=0) = 0;
+
+  /**
+   * run fn inside a write transaction and commit. If the store runs out of space, the transaction is aborted,
+   * the store grows, and fn is replayed in a fresh transaction. The in-memory effects of the aborted attempt on
+   * persistent objects, the object cache and the id counters are undone first (see
+   * WriteTransaction::setReplayable). fn must not have other side effects outside the transaction which would be
+   * harmful if repeated
+   *
+   * @param fn the write operation. Must not commit or abort
+   * @param needsKBs database space required by the transaction, see #beginWrite
+   * @throws store_full_error if the store cannot grow any further
+   */
+  void write(const std::function<void(kv::WriteTransaction *)> &fn, unsigned needsKBs=0);
+
+  /**
+   * @param count the number of transactions
+   * @return count read transactions which are guaranteed to see the same database snapshot. Used for parallel processing
+   */
+  virtual std::vector<kv::ReadTransactionPtr> beginSnapshotReads(unsigned count) = 0;
+
+  /**
+   * compact the store. Top-level collections are first rewritten densely (see WriteTransaction::packCollection),
+   * then a copy of the database is written that leaves out all free pages. Must not be called while
+   * transactions are active, including read transactions. Transactions started by other threads during
+   * compaction are refused with invalid_argument
+   *
+   * @param targetPath the file to write the compacted copy to. The store itself is left untouched, collections
+   * are packed in an intermediate copy. If empty, the store file itself is replaced by the compacted copy. In both
+   * cases, the target file is replaced atomically
+   * @return size and timing information
+   * @throw error if a transaction is active or the copy could not be written
+   */
+  virtual kv::CompactStats compact(const std::string &targetPath = std::string()) = 0;
+
+  /**
+   * @param threads the number of worker threads. If 0, the number of hardware threads is used
+   * @return a facility for scanning all instances of the given class using multiple threads
+   */
+  template <typename T>
+  kv::ParallelScan<T> parallelScan(unsigned threads=0) {
+    return kv::ParallelScan<T>(*this, threads);
+  }
+
+  /**
+   * @param threads the number of worker threads. If 0, the number of hardware threads is used
+   * @return a facility for loading top-level collections using multiple threads
+   */
+  kv::ParallelCollectionLoad parallelLoad(unsigned threads=0);
 };
 
 namespace kv {
 
 void readChunkHeader(ReadBuf &buf, size_t *dataSize, size_t *startIndex, size_t *elementCount);
-void readObjectHeader(ReadBuf &buf, ClassId *classId, ObjectId *objectId, size_t *size=nullptr, bool *deleted=nullptr);
+/**
+ * read the header of an object inside a collection chunk
+ * @param size (out) the size of the object data following the header
+ */
+void readObjectHeader(ReadBuf &buf, StoreFormat format, ClassId *classId, ObjectId *objectId,
+                      size_t *size=nullptr, bool *deleted=nullptr);
+
+/**
+ * @return the size of an object header inside a collection chunk
+ */
+size_t objectHeaderSize(StoreFormat format, ClassId classId, ObjectId objectId, size_t size);
 
 template <typename T>
 bool all_predicate(std::shared_ptr<T> t=nullptr) {return true;}
@@ -622,6 +978,10 @@ template<typename T> void readObject(StoreId storeId, Transaction *tr, ReadBuf &
   Properties *props = ClassTraits<T>::getProperties(storeId, classId);
   if(!props) throw error("unknown classId. Class not registered");
 
+  if(auto table = props->dispatchTable<T>(storeId)) {
+    for(auto &d : *table) d.load(tr, buf, classId, objectId, obj, d.pa, StoreMode::force_none);
+    return;
+  }
   for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
     const PropertyAccessBase *p = props->get(px);
     if(!p->enabled) continue;
@@ -638,6 +998,10 @@ template<typename T> void readObject(StoreId storeId, Transaction *tr, ReadBuf &
 {
   Properties *props = ClassTraits<T>::traits_properties;
 
+  if(auto table = props->dispatchTable<T>(storeId)) {
+    for(auto &d : *table) d.load(tr, buf, classId, objectId, &obj, d.pa, mode);
+    return;
+  }
   for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
     const PropertyAccessBase *p = props->get(px);
     if(!p->enabled) continue;
@@ -729,6 +1093,11 @@ public:
     checkData();
     return readBuf.readInteger<T>(sz);
   }
+  template <typename T, size_t N>
+  T readInteger() {
+    checkData();
+    return readBuf.readInteger<T, N>();
+  }
   void read(ClassId &cid, ObjectId &oid) {
     checkData();
     cid = readBuf.readRaw<ClassId>();
@@ -772,6 +1141,8 @@ public:
  */
 class CursorHelper {
   template <typename T> friend class ClassCursor;
+  template <typename T> friend class ObjectViewCursor;
+  friend class WriteTransaction;
 
 protected:
   ClassId m_currentClassId = 0;
@@ -857,6 +1228,9 @@ struct CollectionInfo
   PropertyId nextChunkId = 1;
   size_t nextStartIndex = 0;
 
+  //codec applied to chunks written from now on
+  ChunkCodec codec = ChunkCodec::none;
+
   CollectionInfo() {}
   CollectionInfo(ObjectId collectionId) : collectionId(collectionId) {}
 
@@ -882,6 +1256,57 @@ public:
   virtual void close() = 0;
 };
 
+/**
+ * small LRU cache of decompressed collection chunks, owned by a transaction. A compressed chunk is stored as
+ * [chunk header with ChunkCompressed_flag][codec][compressed data], the cached result is laid out like an
+ * uncompressed chunk
+ */
+class ChunkCache
+{
+public:
+  using Buffer = std::shared_ptr<std::vector<byte_t>>;
+
+private:
+  struct Entry {
+    ObjectId collectionId;
+    PropertyId chunkId;
+    Buffer data;
+  };
+  std::list<Entry> m_entries;
+  const size_t m_capacity;
+
+public:
+  ChunkCache(size_t capacity=4) : m_capacity(capacity) {}
+
+  /**
+   * @return true if the chunk data is compressed
+   */
+  static bool compressed(const byte_t *data, size_t size) {
+    return size > ChunkHeader_sz && (read_integer<size_t>(data, 4) & ChunkCompressed_flag);
+  }
+
+  /**
+   * decompress a chunk, or return the result of a previous decompression. The returned buffer is shared with
+   * the cache and stays valid after the entry is evicted
+   *
+   * @param data the compressed chunk data, including the header
+   * @param size the size of data
+   * @throw error if the chunk cannot be decompressed
+   */
+  Buffer get(ObjectId collectionId, PropertyId chunkId, const byte_t *data, size_t size);
+
+  /**
+   * drop all entries for the given collection
+   */
+  void erase(ObjectId collectionId) {
+    m_entries.remove_if([collectionId](const Entry &e) {return e.collectionId == collectionId;});
+  }
+
+  void clear() {
+    m_entries.clear();
+  }
+};
+
 /**
  * top-level chunked collection cursor base
  */
@@ -891,6 +1316,7 @@ protected:
   ChunkCursor::Ptr m_chunkCursor;
   Transaction * const m_tr;
   const StoreId m_storeId;
+  const StoreFormat m_format;
   CollectionInfo * const m_collectionInfo;
 
   ReadBuf m_readBuf;
@@ -945,8 +1371,14 @@ class ObjectCollectionCursor : public CollectionCursorBase
 protected:
   bool isValid() override
   {
-    if(!read_integer<byte_t>(m_readBuf.data() + ObjectHeader_sz - 1, 1)) { //check deleted flag
-      ClassId cid = read_integer<ClassId>(m_readBuf.cur(), ClassId_sz);
+    byte_t *pos = m_readBuf.cur();
+
+    ClassId cid;
+    bool deleted;
+    readObjectHeader(m_readBuf, m_format, &cid, nullptr, nullptr, &deleted);
+    m_readBuf.cur() = pos;
+
+    if(!deleted) {
       m_curClassInfo = FIND_CLS(T, m_storeId, cid);
 
       return m_curClassInfo != nullptr || ClassTraits<T>::traits_info->substitute != nullptr;
@@ -975,10 +1407,10 @@ public:
 
     ClassId classId;
     ObjectId objectId;
-    readObjectHeader(m_readBuf, &classId, &objectId);
+    readObjectHeader(m_readBuf, m_format, &classId, &objectId);
 
     if(m_curClassInfo) {
-      T *tp = m_curClassInfo->makeObject(m_storeId, classId);
+      T *tp = m_curClassInfo->makeObject(m_storeId, classId, nullptr);
       readObject<T>(m_storeId, m_tr, m_readBuf, classId, objectId, tp);
       return tp;
     }
@@ -1055,10 +1487,10 @@ class ClassCursor
     return m_classInfo != nullptr || ClassTraits<T>::traits_info->substitute != nullptr;
   }
 
-  T *makeObject(ObjectKey &key, ReadBuf &readBuf)
+  T *makeObject(ObjectKey &key, ReadBuf &readBuf, ObjectArena *arena=nullptr)
   {
     if(m_classInfo) {
-      T *obj = m_classInfo->makeObject(m_store.id, key.classId);
+      T *obj = m_classInfo->makeObject(m_store.id, key.classId, arena);
       readObject<T>(m_store.id, m_tr, readBuf, key.classId, key.objectId, obj);
       return obj;
     }
@@ -1069,6 +1501,16 @@ class ClassCursor
     }
   }
 
+  /**
+   * add a cache lookup to the transaction counters. Defined after Transaction
+   */
+  void countCacheLookup(bool hit);
+
+  /**
+   * @return the object arena of the transaction, or nullptr. Defined after Transaction
+   */
+  ObjectArena *transactionArena();
+
 public:
   using Ptr = std::shared_ptr<ClassCursor<T>>;
 
@@ -1095,51 +1537,7 @@ public:
    * 
    * @return true if the cursor has not reached the end
    */
-  bool erase(WriteTransactionPtr tr)
-  {
-    ObjectKey key;
-
-    ReadBuf readBuf;
-    m_helper->get(key, readBuf);
-    if(readBuf.null()) return m_hasData;
-    if(key.refcount > 1) throw error("removeObject: refcount > 1");
-
-    using Traits = ClassTraits<T>;
-
-    if(Traits::needsPrepare(m_store.id, key.classId)) {
-      Properties *props = Traits::getProperties(m_store.id, key.classId);
-      ObjectBuf obuf(readBuf.data(), readBuf.size());
-
-      for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
-        const PropertyAccessBase *pa = props->get(px);
-
-        if(!pa->enabled) continue;
-
-        obuf.mark();
-        size_t psz = pa->storeinfo->size(m_store.id, obuf);
-        ClassTraits<T>::prepareDelete(m_store.id, tr.get(), obuf, pa);
-        obuf.unmark(psz);
-      }
-    }
-
-    //now remove the object proper
-    if(m_useCache) m_store.removeCached<T>(key.classId, key.objectId);
-
-    if(m_helper->erase()) {
-      bool hasData=true, clsFound;
-      do {
-        clsFound = hasData && validateClass();
-        hasData = m_helper->next();
-      } while(hasData && !clsFound);
-
-      m_hasData = hasData && clsFound;
-      return true;
-    }
-    else m_hasData = false;
-
-    if(!m_hasData) close();
-    return m_hasData;
-  }
+  bool erase(WriteTransactionPtr tr);
 
   /**
    * retrieve the address of the value of the given object property at the current cursor position. Note that
@@ -1203,10 +1601,14 @@ public:
     if(readBuf.null()) return std::shared_ptr<T>();
 
     if(m_useCache) {
-      std::shared_ptr<T> &cached = m_store.getCached<T>(handler.classId, handler.objectId);
-      return cached ? cached : m_store.putCache(makeObject(handler, readBuf), handler);
+      std::shared_ptr<T> cached = m_store.getCached<T>(handler.classId, handler.objectId);
+      countCacheLookup(cached != nullptr);
+      if(cached) return cached;
+      return m_store.putCache(makeObject(handler, readBuf), handler, readBuf.size());
     }
-    return std::shared_ptr<T>(makeObject(handler, readBuf), handler);
+    //substitutes are always heap-allocated
+    ObjectArena *arena = m_classInfo ? transactionArena() : nullptr;
+    return make_ptr(makeObject(handler, readBuf, arena), handler, arena);
   }
 
   bool next() {
@@ -1232,59 +1634,269 @@ public:
 };
 
 /**
- * container for a raw data pointer obtained from a top-level value collection
+ * check that P is the mapped type of a single-valued property, so that it can be decoded through ColumnTraits<P>
+ * @param context prefix for the error message
+ * @throw error if the types do not match
  */
-template <typename V> class CollectionData
+template <typename P> void checkValueType(const PropertyAccessBase *pa, const char *context)
 {
-  V *m_data;
-  bool m_owned;
-
-public:
-  using Ptr = std::shared_ptr<CollectionData>;
-
-  CollectionData(void *data, bool owned) : m_data((V*)data), m_owned(owned) {}
-  ~CollectionData() {
-    if(m_owned) free(m_data);
-  }
-  bool isOwned() {return m_owned;}
-  V *data() {return m_data;}
-};
+  const PropertyType &type = pa->type;
+  if(type.id != TypeTraits<P>::id || type.isVector || type.className)
+    throw error(std::string(context) + ": value type does not match property type");
+}
 
 /**
- * Transaction that allows read operations only. Read transactions can be run concurrently
+ * read-only view of a fixed-size object (ClassTraits<T>::traits_properties->fixedSize != 0). A view does not
+ * instantiate T, but reads the mapped property values directly from the object buffer. The buffer may point into
+ * database-owned memory, so a view is only valid within the ExclusiveReadTransaction that produced it. Views can
+ * also be taken from subclass instances, since the properties of T precede those of the subclass
  */
-class Transaction
+template <typename T>
+class ObjectView
 {
-  template<typename T, typename V> friend struct ValueEmbeddedStorage;
-  template<typename T, typename V> friend struct ValueKeyedStorage;
-  template<typename T, typename V> friend struct ObjectPropertyStorage;
-  template<typename T, typename V> friend struct ObjectPropertyStorageEmbedded;
-  template<typename T, typename V> friend class ObjectPtrPropertyStorage;
-  template<typename T, typename V> friend struct ObjectPtrPropertyStorageEmbedded;
-  template<typename T, typename V> friend class ObjectVectorPropertyStorage;
-  template<typename T, typename V> friend class ObjectVectorPropertyStorageEmbedded;
-  template<typename T, typename V> friend class ObjectPtrVectorPropertyStorage;
-  template<typename T, typename V> friend class ObjectPtrVectorPropertyStorageEmbedded;
-  template<typename T, typename V, typename KVIter, typename Iter> friend struct CollectionIterPropertyStorage;
-  template<typename V> friend class AbstractObjectVectorStorage;
-  friend class CollectionCursorBase;
-  template<typename T> friend struct ObjectIdStorage;
-  template <typename T> friend class ObjectCollectionCursor;
-  template <typename T> friend class ClassCursor;
-  friend class CollectionAppenderBase;
-  friend class ObjectBuf;
+  static const size_t npos = (size_t)-1;
 
-  CollectionInfo *readCollectionInfo(ReadBuf &readBuf);
+  ObjectKey m_key;
+  const byte_t *m_data;
 
-protected:
-  std::unordered_map<ObjectId, CollectionInfo *> m_collectionInfos;
+  /**
+   * @return the buffer offsets of the properties of T, indexed by (PropertyId - 2). Properties that are not
+   * embedded are assigned npos
+   */
+  static const std::vector<size_t> &offsets()
+  {
+    static const std::vector<size_t> s_offsets = [] {
+      Properties *props = ClassTraits<T>::traits_properties;
+      std::vector<size_t> offs(props->full_size(), npos);
 
-  KeyValueStore &store;
-  bool m_blockWrites;
+      size_t offset = 0;
+      for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
+        const PropertyAccessBase *pa = props->get(px);
+        if(!pa->enabled) continue;
 
-  Transaction(KeyValueStore &store) : store(store) {}
+        switch(pa->storeinfo->layout) {
+          case StoreLayout::all_embedded:
+            offs[px] = offset;
+            offset += pa->storeinfo->fixedSize;
+            break;
+          case StoreLayout::embedded_key:
+            offset += ObjectKey_sz;
+            break;
+          default:
+            break;
+        }
+      }
+      return offs;
+    }();
+    return s_offsets;
+  }
 
-  void setBlockWrites(bool blockWrites) {
+public:
+  ObjectView() : m_data(nullptr) {}
+  ObjectView(const ObjectKey &key, const byte_t *data) : m_key(key), m_data(data) {}
+
+  /**
+   * @throw error if T is not fixed-size
+   */
+  static void check() {
+    if(!ClassTraits<T>::traits_properties->fixedSize)
+      throw error("ObjectView: class is not fixed-size");
+  }
+
+  /**
+   * @param pa a property mapping of T or one of its superclasses
+   * @return the offset of the property value inside the object buffer
+   * @throw error if the property does not belong to T or is not embedded
+   */
+  static size_t offset(const PropertyAccessBase *pa)
+  {
+    const std::vector<size_t> &offs = offsets();
+    size_t index = pa->id - 2;
+    if(index >= offs.size() || ClassTraits<T>::traits_properties->get(index) != pa)
+      throw error("ObjectView: property does not belong to class");
+    if(offs[index] == npos) throw error("ObjectView: property is not embedded");
+    return offs[index];
+  }
+
+  /**
+   * @return true if this view is backed by object data
+   */
+  bool valid() const {return m_data != nullptr;}
+  operator bool() const {return m_data != nullptr;}
+
+  const ObjectKey &key() const {return m_key;}
+  const byte_t *data() const {return m_data;}
+  ClassId classId() const {return m_key.classId;}
+  ObjectId objectId() const {return m_key.objectId;}
+
+  /**
+   * read a property value from the object buffer. The value is decoded like Transaction::loadColumns does
+   *
+   * @param pa the property mapping. Must be an embedded value property of T or one of its superclasses
+   * @return the property value
+   * @throw error if the property does not belong to T, is not embedded, or P is not the mapped property type
+   */
+  template <typename P> P get(const PropertyAccessBase *pa) const
+  {
+    size_t off = offset(pa);
+    checkValueType<P>(pa, "ObjectView");
+    return ColumnTraits<P>::decode(m_data + off);
+  }
+};
+template <typename T> const size_t ObjectView<T>::npos;
+
+/**
+ * a typed column of property values, filled by Transaction::loadColumns()
+ */
+template <typename P>
+struct Column
+{
+  const PropertyAccessBase * const property;
+  std::vector<P> values;
+
+  Column(const PropertyAccessBase *property) : property(property) {}
+};
+
+/**
+ * cursor for iterating over class objects as ObjectViews. Only available through ExclusiveReadTransaction
+ */
+template <typename T>
+class ObjectViewCursor
+{
+  ObjectViewCursor(ObjectViewCursor<T> &other) = delete;
+
+  CursorHelper * const m_helper;
+  bool m_hasData;
+
+public:
+  using Ptr = std::shared_ptr<ObjectViewCursor<T>>;
+
+  ObjectViewCursor(CursorHelper *helper) : m_helper(helper)
+  {
+    m_hasData = helper->start();
+    if(!m_hasData) close();
+  }
+
+  virtual ~ObjectViewCursor() {
+    delete m_helper;
+  }
+
+  /**
+   * @return a view of the object at the current cursor position
+   */
+  ObjectView<T> get()
+  {
+    ObjectKey key;
+    ReadBuf readBuf;
+    m_helper->get(key, readBuf);
+
+    if(readBuf.null()) return ObjectView<T>();
+    return ObjectView<T>(key, readBuf.data());
+  }
+
+  bool next() {
+    m_hasData = m_helper->next();
+    if(!m_hasData) close();
+    return m_hasData;
+  }
+
+  bool atEnd() {
+    return !m_hasData;
+  }
+
+  void close() {
+    m_helper->close();
+  }
+};
+
+/**
+ * container for a raw data pointer obtained from a top-level value collection
+ */
+template <typename V> class CollectionData
+{
+  V *m_data;
+  bool m_owned;
+
+public:
+  using Ptr = std::shared_ptr<CollectionData>;
+
+  CollectionData(void *data, bool owned) : m_data((V*)data), m_owned(owned) {}
+  ~CollectionData() {
+    if(m_owned) free(m_data);
+  }
+  bool isOwned() {return m_owned;}
+  V *data() {return m_data;}
+};
+
+/**
+ * Transaction that allows read operations only. Read transactions can be run concurrently
+ */
+class Transaction
+{
+  template<typename T, typename V> friend struct ValueEmbeddedStorage;
+  template<typename T, typename V> friend struct VarintEmbeddedStorage;
+  template<typename T, typename V> friend struct ValueKeyedStorage;
+  template<typename T, typename V> friend struct ObjectPropertyStorage;
+  template<typename T, typename V> friend struct ObjectPropertyStorageEmbedded;
+  template<typename T, typename V> friend class ObjectPtrPropertyStorage;
+  template<typename T, typename V> friend struct ObjectPtrPropertyStorageEmbedded;
+  template<typename T, typename V> friend class ObjectVectorPropertyStorage;
+  template<typename T, typename V> friend class ObjectVectorPropertyStorageEmbedded;
+  template<typename T, typename V> friend class ObjectPtrVectorPropertyStorage;
+  template<typename T, typename V> friend class ObjectPtrVectorPropertyStorageEmbedded;
+  template<typename T, typename V, typename KVIter, typename Iter> friend struct CollectionIterPropertyStorage;
+  template<typename V> friend class AbstractObjectVectorStorage;
+  friend class CollectionCursorBase;
+  template<typename T> friend struct ObjectIdStorage;
+  template <typename T> friend class ObjectCollectionCursor;
+  template <typename T> friend class ClassCursor;
+  friend class CollectionAppenderBase;
+  friend class ObjectBuf;
+  friend class ParallelCollectionLoad;
+
+  CollectionInfo *readCollectionInfo(ReadBuf &readBuf);
+
+  /**
+   * decode one property value per row into the column. Used by loadColumns()
+   */
+  template <typename P>
+  static void decodeColumn(const std::vector<const byte_t *> &rows, size_t offset, Column<P> &column)
+  {
+    checkValueType<P>(column.property, "loadColumns");
+
+    size_t start = column.values.size();
+    column.values.resize(start + rows.size());
+    for(size_t i=0, sz=rows.size(); i<sz; i++)
+      column.values[start + i] = ColumnTraits<P>::decode(rows[i] + offset);
+  }
+
+protected:
+  std::unordered_map<ObjectId, CollectionInfo *> m_collectionInfos;
+
+  KeyValueStore &store;
+  bool m_blockWrites;
+  TransactionStats m_stats;
+  ChunkCache m_chunkCache;
+  ObjectArena *m_arena = nullptr;
+
+  Transaction(KeyValueStore &store) : store(store) {}
+
+  /**
+   * give up the arena reference held by this transaction. Arena objects still alive keep it from being freed
+   */
+  void releaseArena() {
+    if(m_arena) m_arena->release();
+    m_arena = nullptr;
+  }
+
+  /**
+   * read a collection element count in the store format
+   */
+  size_t readCount(ReadBuf &buf) {
+    return store.format() == StoreFormat::compact ? (size_t)buf.readVarint() : buf.readInteger<size_t, 4>();
+  }
+
+  void setBlockWrites(bool blockWrites) {
     m_blockWrites = blockWrites;
   }
 
@@ -1319,8 +1931,12 @@ protected:
   {
     bool doCache = store.isCache<T>();
     if(doCache && !reload) {
-      std::shared_ptr<T> &cached = store.getCached<T>(handler.classId, handler.objectId);
-      if(cached) return cached;
+      std::shared_ptr<T> cached = store.getCached<T>(handler.classId, handler.objectId);
+      if(cached) {
+        m_stats.cacheHits++;
+        return cached;
+      }
+      m_stats.cacheMisses++;
     }
 
     ReadBuf readBuf;
@@ -1328,10 +1944,11 @@ protected:
 
     if(readBuf.null()) return nullptr;
 
-    T *obj = ClassTraits<T>::makeObject(store.id, handler.classId);
+    ObjectArena *arena = doCache ? nullptr : m_arena;
+    T *obj = ClassTraits<T>::makeObject(store.id, handler.classId, arena);
     readObject<T>(store.id, this, readBuf, handler.classId, handler.objectId, obj);
 
-    return doCache ? store.putCache(obj, handler) : std::shared_ptr<T>(obj, handler);
+    return doCache ? store.putCache(obj, handler, readBuf.size()) : make_ptr(obj, handler, arena);
   }
 
   /**
@@ -1361,38 +1978,78 @@ protected:
   template <typename T, template <typename> class Ptr=std::shared_ptr> std::vector<Ptr<T>> loadChunkedCollection(
       CollectionInfo *ci)
   {
-    std::vector<Ptr<T>> result;
+    std::vector<Ptr<T>> result(ci->count());
+    size_t count = 0;
     for(ChunkCursor::Ptr cc= _openChunkCursor(COLLECTION_CLSID, ci->collectionId); !cc->atEnd(); cc->next()) {
       ReadBuf buf;
       cc->get(buf);
 
       size_t elementCount;
       readChunkHeader(buf, 0, 0, &elementCount);
+      if(count + elementCount > result.size()) result.resize(count + elementCount);
 
-      for(size_t i=0; i < elementCount; i++) {
-        ClassId cid;
-        ObjectId oid;
-        bool deleted;
-        readObjectHeader(buf, &cid, &oid, nullptr, &deleted);
-
-        if(!deleted) {
-          ClassInfo<T> *ti = FIND_CLS(T, store.id, cid);
-          if(!ti) {
-            T *sp = ClassTraits<T>::getSubstitute();
-            if(sp) {
-              readObject<T>(store.id, this, buf, *sp, cid, oid);
-              result.push_back(std::shared_ptr<T>(sp));
-            }
-          }
-          else {
-            T *obj = ti->makeObject(store.id, cid);
-            readObject<T>(store.id, this, buf, cid, oid, obj);
-            result.push_back(std::shared_ptr<T>(obj));
+      count += readObjectChunk<T, Ptr>(buf, elementCount, result.begin() + count);
+    }
+    result.resize(count);
+    return result;
+  }
+
+  /**
+   * decode the objects of a collection chunk into consecutive slots. Deleted objects and objects without a known
+   * class or substitute are skipped
+   *
+   * @param buf the chunk data, positioned after the chunk header
+   * @param elementCount the element count from the chunk header
+   * @param out the first slot
+   * @return the number of objects stored
+   */
+  template <typename T, template <typename> class Ptr, typename It>
+  size_t readObjectChunk(ReadBuf &buf, size_t elementCount, It out)
+  {
+    size_t count = 0;
+    for(size_t i=0; i < elementCount; i++) {
+      ClassId cid;
+      ObjectId oid;
+      bool deleted;
+      readObjectHeader(buf, store.format(), &cid, &oid, nullptr, &deleted);
+
+      if(!deleted) {
+        ClassInfo<T> *ti = FIND_CLS(T, store.id, cid);
+        if(!ti) {
+          T *sp = ClassTraits<T>::getSubstitute();
+          if(sp) {
+            readObject<T>(store.id, this, buf, *sp, cid, oid);
+            *out++ = Ptr<T>(sp);
+            count++;
           }
         }
+        else {
+          ObjectArena *arena = std::is_same<Ptr<T>, std::shared_ptr<T>>::value ? m_arena : nullptr;
+          T *obj = ti->makeObject(store.id, cid, arena);
+          readObject<T>(store.id, this, buf, cid, oid, obj);
+          assign_ptr(*out++, obj, arena);
+          count++;
+        }
       }
     }
-    return result;
+    return count;
+  }
+
+  /**
+   * decode the values of a collection chunk into consecutive slots
+   *
+   * @param buf the chunk data, positioned after the chunk header
+   * @param elementCount the element count from the chunk header
+   * @param out the first slot
+   */
+  template <typename T, typename It>
+  static void readValueChunk(ReadBuf &buf, size_t elementCount, It out)
+  {
+    for(size_t i=0; i < elementCount; i++) {
+      T val;
+      ValueTraits<T>::getBytes(buf, val);
+      *out++ = val;
+    }
   }
 
   /**
@@ -1405,6 +2062,14 @@ protected:
    */
   virtual void getData(ReadBuf &buf, ObjectKey &key, bool getRefount) = 0;
 
+  /**
+   * read data for a batch of object keys, which must be sorted in ascending order. Used internally by getObjects
+   *
+   * @param bufs an array of count buffers which receive the data. Buffers for keys not found are left untouched
+   * @param keys an array of count keys, sorted ascending. Refcounts will be read into the keys if requested
+   */
+  virtual void getData(ReadBuf *bufs, ObjectKey *keys, size_t count, bool getRefcount) = 0;
+
   /**
    * read scalar collection data
    *
@@ -1413,18 +2078,37 @@ protected:
    * @param length number of elements to retrieve
    * @param elementSize size of one element
    * @param data (in, out) where to store the retrieved data. If *data != nullptr, data will be copied
-   * to target address. Otherwise, if requested data is within one chunk, *data will be set to the database-owned
-   * area where trhe chunk resides, if requested data straddles chunks, memory will be allocated and *owned will
-   * be true
+   * to target address. Otherwise, if requested data is within one uncompressed chunk, *data will be set to the
+   * database-owned area where trhe chunk resides, if requested data straddles chunks or lies in a compressed
+   * chunk, memory will be allocated and *owned will be true
    * @param owned (out) set to true if a buffer was allocated to store the data
    */
   virtual bool _getCollectionData(
       CollectionInfo *info, size_t startIndex, size_t length, size_t elementSize, void **data, bool *owned) = 0;
 
-  virtual CursorHelper * _openCursor(const std::vector<ClassId> &classIds) = 0;
+  virtual CursorHelper * _openCursor(const std::vector<ClassId> &classIds, ObjectId startId=0, ObjectId endId=0) = 0;
   virtual CursorHelper * _openCursor(ClassId classId, ObjectId objectId, PropertyId propertyId) = 0;
   virtual CursorHelper * _openCursor(ClassId classId, ObjectId collectionId) = 0;
 
+  /**
+   * @return a cursor over the objects referenced by a secondary index, in index order. The cursor covers all entries
+   * with encoded values in the range [lower, upper]
+   *
+   * @param classId the id of the class that declares the indexed property
+   * @param propertyId the id of the indexed property
+   */
+  virtual CursorHelper * _openIndexCursor(ClassId classId, PropertyId propertyId,
+                                          const byte_t *lower, size_t lowerSize, const byte_t *upper, size_t upperSize) = 0;
+
+  /**
+   * @throw error if pa does not declare a secondary index with value type P
+   */
+  template <typename P> static void checkIndex(const PropertyAccessBase *pa)
+  {
+    if(!dynamic_cast<const PropertyIndex<P> *>(pa->index))
+      throw error("property is not indexed, or index has a different type");
+  }
+
   virtual void doReset() = 0;
   virtual void doRenew() = 0;
   virtual void doAbort() = 0;
@@ -1446,6 +2130,32 @@ public:
    */
   StoreId storeId() {return store.id;}
 
+  /**
+   * @return a snapshot of the operation counters of this transaction. The counters are added to
+   * KeyValueStore::stats() when the transaction ends
+   */
+  TransactionStats stats() const {return m_stats;}
+
+  /**
+   * materialize objects from an arena instead of allocating each one on the heap. This applies to objects returned as
+   * shared_ptr by loadObject, getObject(ObjectId), getObjects, class cursors and getCollection, for classes that are
+   * not cached. Member data like strings and vectors is still heap-allocated.<br>
+   * The arena is released when the transaction ends, or when the last object allocated from it is destroyed,
+   * whichever comes later. Objects that must outlive the transaction thus stay valid, but keep the whole arena
+   * alive. They should be loaded after turning the arena off. Not available for parallel loads
+   *
+   * @param blockSize the arena block size. 0 turns the arena off for subsequent loads
+   */
+  void useArena(size_t blockSize=64 * 1024) {
+    releaseArena();
+    if(blockSize) m_arena = new ObjectArena(blockSize);
+  }
+
+  /**
+   * @return the arena currently in use, or nullptr
+   */
+  const ObjectArena *arena() const {return m_arena;}
+
   /**
    * @return true if the given object was not previously saved
    */
@@ -1496,6 +2206,73 @@ public:
     return loadObject<T>(handler);
   }
 
+  /**
+   * load a batch of objects polymorphically + refcounting (if configured). The keys are sorted internally, so that
+   * the data can be read during a single pass over the store. Configured object caching is honored
+   *
+   * @param keys the object keys. Keys may be repeated, in which case the same object is returned
+   * @return the objects in the order of the keys. Objects that were not found are returned as empty shared_ptrs
+   */
+  template<typename T> std::vector<std::shared_ptr<T>> getObjects(const std::vector<ObjectKey> &keys)
+  {
+    std::vector<std::shared_ptr<T>> result(keys.size());
+
+    //positions of keys that need to be loaded
+    bool doCache = store.isCache<T>();
+    std::vector<size_t> positions;
+    positions.reserve(keys.size());
+    for(size_t i=0; i<keys.size(); i++) {
+      if(!keys[i].classId) continue;
+      if(doCache) {
+        result[i] = store.getCached<T>(keys[i].classId, keys[i].objectId);
+        if(result[i]) {
+          m_stats.cacheHits++;
+          continue;
+        }
+        m_stats.cacheMisses++;
+      }
+      positions.push_back(i);
+    }
+    if(positions.empty()) return result;
+
+    std::sort(positions.begin(), positions.end(), [&keys](size_t p1, size_t p2) {return keys[p1] < keys[p2];});
+
+    std::vector<ObjectKey> loadKeys;
+    loadKeys.reserve(positions.size());
+    for(size_t p : positions) {
+      if(loadKeys.empty() || loadKeys.back() < keys[p]) loadKeys.push_back(keys[p]);
+    }
+
+    std::unique_ptr<ReadBuf[]> bufs(new ReadBuf[loadKeys.size()]);
+    getData(bufs.get(), loadKeys.data(), loadKeys.size(), ClassTraits<T>::traits_data(store.id).refcounting);
+
+    size_t lx = 0;
+    std::shared_ptr<T> loaded;
+    for(size_t px=0; px < positions.size(); px++) {
+      const ObjectKey &key = keys[positions[px]];
+      if(px == 0 || loadKeys[lx] < key) {
+        if(px > 0) lx++;
+
+        ReadBuf &readBuf = bufs[lx];
+        if(readBuf.null()) {
+          loaded = nullptr;
+        }
+        else {
+          object_handler<T> handler(loadKeys[lx]);
+          handler.refcount = loadKeys[lx].refcount;
+
+          ObjectArena *arena = doCache ? nullptr : m_arena;
+          T *obj = ClassTraits<T>::makeObject(store.id, handler.classId, arena);
+          readObject<T>(store.id, this, readBuf, handler.classId, handler.objectId, obj);
+
+          loaded = doCache ? store.putCache(obj, handler, readBuf.size()) : make_ptr(obj, handler, arena);
+        }
+      }
+      result[positions[px]] = loaded;
+    }
+    return result;
+  }
+
   /**
    * reload an object from the store, Non-polymorphical, T must be the exact type of the object.
    * The new object is allocated on the heap.
@@ -1520,6 +2297,104 @@ public:
     return typename ClassCursor<T>::Ptr(new ClassCursor<T>(_openCursor(classIds), store, this));
   }
 
+  /**
+   * load the values of selected embedded properties of all instances of fixed-size class T (including subclasses)
+   * into typed columns, without instantiating objects. Values are appended to the columns, so that after the call
+   * all columns have the same number of new rows, in cursor order. Example:
+   *
+   * Column<float> x(PROPERTY(Colored2DPoint, x)), y(PROPERTY(Colored2DPoint, y));
+   * tr->loadColumns<Colored2DPoint>(x, y);
+   *
+   * @param columns the columns to load. The column value type must match the mapped property type
+   * @return the number of rows loaded
+   * @throw error if T is not fixed-size, or a column property is not an embedded property of T
+   */
+  template <typename T, typename... P> size_t loadColumns(Column<P> &... columns)
+  {
+    ObjectView<T>::check();
+    size_t offsets[] = {ObjectView<T>::offset(columns.property)...};
+
+    //collect the object buffers, which stay valid until the end of the transaction
+    std::vector<const byte_t *> rows;
+    std::vector<ClassId> classIds = ClassTraits<T>::traits_info->allClassIds(store.id);
+    for(typename ObjectViewCursor<T>::Ptr curs(new ObjectViewCursor<T>(_openCursor(classIds))); !curs->atEnd(); curs->next()) {
+      ObjectView<T> view = curs->get();
+      if(view) rows.push_back(view.data());
+    }
+
+    //decode column by column
+    size_t cx = 0;
+    int expand[] = {0, (decodeColumn(rows, offsets[cx++], columns), 0)...};
+    (void)expand;
+
+    return rows.size();
+  }
+
+  /**
+   * @param classId the id of T or one of its subclasses. Instances of other classes are not returned
+   * @param startId the first objectId in the range
+   * @param endId the objectId after the range. If 0, the range is open-ended
+   * @return a cursor over the instances of the given class with objectIds in the range [startId, endId)
+   */
+  template <typename T> typename ClassCursor<T>::Ptr openCursor(ClassId classId, ObjectId startId, ObjectId endId) {
+    std::vector<ClassId> classIds {classId};
+
+    return typename ClassCursor<T>::Ptr(new ClassCursor<T>(_openCursor(classIds, startId, endId), store, this));
+  }
+
+  /**
+   * @param pa an indexed property (see MAPPED_PROP_INDEXED) of T or one of its superclasses
+   * @param lower the lowest property value
+   * @param upper the highest property value (inclusive)
+   * @return a cursor over the instances of T (including subclasses) with property values in the range [lower, upper],
+   * in ascending value order. Objects with string values that only differ after IndexValue_maxsz - 1 bytes are
+   * treated as equal
+   * @throw error if the property is not indexed, or P is not the mapped property type
+   */
+  template <typename T, typename P>
+  typename ClassCursor<T>::Ptr openIndexCursor(const PropertyAccessBase *pa, const P &lower, const P &upper)
+  {
+    checkIndex<P>(pa);
+
+    byte_t lowerBuf[IndexValue_maxsz], upperBuf[IndexValue_maxsz];
+    size_t lowerSize = IndexTraits<P>::encode(lower, lowerBuf);
+    size_t upperSize = IndexTraits<P>::encode(upper, upperBuf);
+
+    return typename ClassCursor<T>::Ptr(new ClassCursor<T>(
+        _openIndexCursor(pa->classId[store.id], pa->id, lowerBuf, lowerSize, upperBuf, upperSize), store, this));
+  }
+
+  /**
+   * retrieve all instances of T (including subclasses) with indexed property values in the range [lower, upper],
+   * using the secondary index
+   *
+   * @see openIndexCursor
+   */
+  template <typename T, typename P>
+  std::vector<std::shared_ptr<T>> find(const PropertyAccessBase *pa, const P &lower, const P &upper)
+  {
+    std::vector<std::shared_ptr<T>> result;
+    for(auto curs = openIndexCursor<T, P>(pa, lower, upper); !curs->atEnd(); curs->next()) {
+      auto instance = curs->get();
+      if(instance) result.push_back(instance);
+    }
+    return result;
+  }
+
+  /**
+   * retrieve all instances of T (including subclasses) whose indexed property has the given value, using
+   * the secondary index. Example:
+   *
+   * auto found = tr->find<Person, std::string>(PROPERTY(Person, name), "Paul");
+   *
+   * @see openIndexCursor
+   */
+  template <typename T, typename P>
+  std::vector<std::shared_ptr<T>> find(const PropertyAccessBase *pa, const P &value)
+  {
+    return find<T, P>(pa, value, value);
+  }
+
   /**
    * @param objectId a valid object ID
    * @param propertyId the propertyId (1-based index into declared properties, obtainable through PROPERTY_ID macro)
@@ -1604,7 +2479,7 @@ public:
     getData(buf, key->classId, key->objectId, propertyId);
     if(buf.null()) return ;
 
-    size_t elementCount = buf.readInteger<size_t>(4);
+    size_t elementCount = readCount(buf);
     vect.reserve(elementCount);
 
     for(size_t i=0; i < elementCount; i++) {
@@ -1654,11 +2529,9 @@ public:
       size_t elementCount;
       readChunkHeader(buf, 0, 0, &elementCount);
 
-      for(size_t i=0; i < elementCount; i++) {
-        T val;
-        ValueTraits<T>::getBytes(buf, val);
-        result.push_back(val);
-      }
+      size_t count = result.size();
+      result.resize(count + elementCount);
+      readValueChunk<T>(buf, elementCount, result.begin() + count);
     }
     return result;
   }
@@ -1671,8 +2544,8 @@ public:
    * @param startIndex the start index of the data
    * @param length number of elements to retrieve
    * @param data pointer to the memory location of the returned data. If *data is 0, the memory will be either
-   * allocated or point into the store-owned memory map, depending on whether the data straddles chunks. If data
-   * was allocated, *owned will be set to true. If *data is != 0, it is assumed to be pointing to a data area big enough
+   * allocated or point into the store-owned memory map, depending on whether the data straddles chunks or is
+   * compressed. If data was allocated, *owned will be set to true. If *data is != 0, it is assumed to be pointing to a data area big enough
    * to receive a copy of the data.
    * @param owned set to true if memory was allocated and should be released by the caller
    *
@@ -1706,6 +2579,100 @@ public:
     return getDataCollection(collectionId, startIndex, length, data, nullptr);
   }
 
+  /**
+   * iterate over a range of a raw data collection chunk by chunk. The data is handed out directly from the chunks,
+   * so ranges that straddle chunks are not copied. The raw data API restrictions apply (see getDataCollection)
+   *
+   * @param collectionId the ID of the collection
+   * @param startIndex the start index of the data
+   * @param length number of elements to visit. If 0, all elements from startIndex to the end are visited
+   * @param fn called with (const T *data, size_t count, size_t startIndex) for each chunk segment in the range.
+   * The data pointer may point to database-owned memory and is only valid during the call
+   *
+   * @return the number of elements visited
+   */
+  template <typename T, typename F>
+  size_t forEachDataChunk(ObjectId collectionId, size_t startIndex, size_t length, F fn)
+  {
+    RAWDATA_API_ASSERT(T)
+    CollectionInfo *ci = getCollectionInfo(collectionId, false);
+    if(!ci) return 0;
+
+    size_t endIndex = length ? startIndex + length : std::numeric_limits<size_t>::max();
+    size_t visited = 0;
+
+    ChunkCursor::Ptr cc = _openChunkCursor(COLLECTION_CLSID, collectionId);
+    for(const ChunkInfo &chunk : ci->chunkInfos) {
+      if(chunk.startIndex + chunk.elementCount <= startIndex || chunk.startIndex >= endIndex) continue;
+
+      cc->seek(chunk.chunkId);
+      if(cc->atEnd()) throw error("data collection chunk not found");
+
+      ReadBuf buf;
+      cc->get(buf);
+      size_t elementCount;
+      readChunkHeader(buf, 0, 0, &elementCount);
+
+      size_t first = startIndex > chunk.startIndex ? startIndex - chunk.startIndex : 0;
+      size_t last = std::min(elementCount, endIndex - chunk.startIndex);
+      if(last <= first) continue;
+
+      fn((const T *)buf.cur() + first, last - first, chunk.startIndex + first);
+      visited += last - first;
+    }
+    cc->close();
+    return visited;
+  }
+
+  /**
+   * compute count, min, max and sum over a range of a raw data collection, using the vectorized kernels
+   *
+   * @param length number of elements. If 0, all elements from startIndex to the end are used
+   */
+  template <typename T>
+  kernels::Summary<T> summarizeDataCollection(ObjectId collectionId, size_t startIndex=0, size_t length=0)
+  {
+    kernels::Summary<T> summary;
+    forEachDataChunk<T>(collectionId, startIndex, length, [&summary](const T *data, size_t count, size_t) {
+      kernels::summarize(data, count, summary);
+    });
+    return summary;
+  }
+
+  /**
+   * @param threshold the filter threshold
+   * @param length number of elements. If 0, all elements from startIndex to the end are filtered
+   * @return the collection indexes of all elements in the range that are greater than threshold, in ascending order
+   */
+  template <typename T>
+  std::vector<size_t> filterDataCollection(ObjectId collectionId, T threshold, size_t startIndex=0, size_t length=0)
+  {
+    std::vector<size_t> result;
+    forEachDataChunk<T>(collectionId, startIndex, length, [&result, threshold](const T *data, size_t count, size_t start) {
+      kernels::filterGreater(data, count, threshold, start, result);
+    });
+    return result;
+  }
+
+  /**
+   * compute a histogram with binCount equally sized bins over [lower, upper). Out-of-range values are counted into
+   * the first or last bin
+   *
+   * @param length number of elements. If 0, all elements from startIndex to the end are used
+   */
+  template <typename T>
+  std::vector<size_t> histogramDataCollection(ObjectId collectionId, double lower, double upper, size_t binCount,
+                                              size_t startIndex=0, size_t length=0)
+  {
+    if(!binCount || upper <= lower) throw error("histogram: invalid bin configuration");
+
+    std::vector<size_t> bins(binCount, 0);
+    forEachDataChunk<T>(collectionId, startIndex, length, [&bins, lower, upper](const T *data, size_t count, size_t) {
+      kernels::histogram(data, count, lower, upper, bins.data(), bins.size());
+    });
+    return bins;
+  }
+
   /**
    * load a member variable of the given, already persistent object. This is only useful for members which are configured
    * as lazy (only Object* properties)
@@ -1755,6 +2722,19 @@ public:
   void renew();
 };
 
+template <typename T>
+void ClassCursor<T>::countCacheLookup(bool hit)
+{
+  if(hit) m_tr->m_stats.cacheHits++;
+  else m_tr->m_stats.cacheMisses++;
+}
+
+template <typename T>
+ObjectArena *ClassCursor<T>::transactionArena()
+{
+  return m_tr->m_arena;
+}
+
 class ReadTransaction : public virtual Transaction {
 public:
   ReadTransaction(KeyValueStore &store) : Transaction(store) {}
@@ -1803,12 +2783,73 @@ public:
     }
     return nullptr;
   }
+
+  /**
+   * obtain a read-only view of a fixed-size object. No object is instantiated, property values are read directly
+   * from database-owned memory. The view becomes invalid at the end of this transaction
+   *
+   * @param key the object key
+   * @return the view, which is not valid() if the key does not exist
+   * @throw error if T is not fixed-size
+   */
+  template<typename T> ObjectView<T> getView(ObjectKey &key)
+  {
+    ObjectView<T>::check();
+
+    ReadBuf readBuf;
+    getData(readBuf, key, false);
+
+    if(readBuf.null()) return ObjectView<T>();
+    return ObjectView<T>(key, readBuf.data());
+  }
+
+  /**
+   * obtain a read-only view of a fixed-size object, non-polymorphically
+   *
+   * @param objectId the object ID
+   * @return the view, which is not valid() if the object does not exist
+   * @throw error if T is not fixed-size
+   */
+  template<typename T> ObjectView<T> getView(ObjectId objectId)
+  {
+    ObjectKey key(ClassTraits<T>::traits_data(store.id).classId, objectId);
+    return getView<T>(key);
+  }
+
+  /**
+   * @return a cursor over views of all instances of the given fixed-size class and its subclasses
+   * @throw error if T is not fixed-size
+   */
+  template <typename T> typename ObjectViewCursor<T>::Ptr openViewCursor()
+  {
+    ObjectView<T>::check();
+    std::vector<ClassId> classIds = ClassTraits<T>::traits_info->allClassIds(store.id);
+
+    return typename ObjectViewCursor<T>::Ptr(new ObjectViewCursor<T>(_openCursor(classIds)));
+  }
 };
 
 class CollectionAppenderBase
 {
+  friend class WriteTransaction;
+
   CollectionInfo *m_collectionInfo = nullptr;
 
+  /**
+   * finish the current chunk. Appending continues in a new chunk
+   */
+  void seal();
+
+  /**
+   * attach to the given collection info (or detach if nullptr) and forget about the current chunk. Used by
+   * WriteTransaction::rollbackTo
+   */
+  void rollback(CollectionInfo *collectionInfo) {
+    m_collectionInfo = collectionInfo;
+    m_elementCount = 0;
+    m_sealed = true;
+  }
+
 protected:
   ObjectId &m_collectionId;
   const size_t m_chunkSize;
@@ -1816,12 +2857,19 @@ protected:
 
   WriteBuf &m_writeBuf;
   size_t m_elementCount;
+  //true if the current chunk is finished
+  bool m_sealed = false;
 
   CollectionAppenderBase(WriteTransaction *wtxn, ObjectId &collectionId, size_t chunkSize);
 
   CollectionInfo *collectionInfo();
   void startChunk(size_t size);
 
+  /**
+   * @return the space left in the current chunk. A sealed chunk takes no more data
+   */
+  size_t avail() {return m_sealed ? 0 : m_writeBuf.avail();}
+
 public:
   void close(bool erase=true);
 };
@@ -1836,6 +2884,10 @@ static size_t calculateBuffer(StoreId storeId, T *obj, Properties *properties)
   if(properties->fixedSize) return properties->fixedSize;
 
   size_t size = 0;
+  if(auto table = properties->dispatchTable<T>(storeId)) {
+    for(auto &d : *table) size += d.size(storeId, obj, d.pa);
+    return size;
+  }
   for(unsigned i=0, sz=properties->full_size(); i<sz; i++) {
     auto pa = properties->get(i);
 
@@ -1854,6 +2906,7 @@ static size_t calculateBuffer(StoreId storeId, T *obj, Properties *properties)
 class WriteTransaction : public virtual Transaction
 {
   template<typename T, typename V> friend struct ValueEmbeddedStorage;
+  template<typename T, typename V> friend struct VarintEmbeddedStorage;
   template<typename T, typename V> friend struct ValueKeyedStorage;
   template<typename T, typename V> friend class SimplePropertyStorage;
   template<typename T, typename V> friend struct ObjectPropertyStorage;
@@ -1866,14 +2919,79 @@ class WriteTransaction : public virtual Transaction
   template<typename T, typename V> friend class ObjectPtrVectorPropertyStorageEmbedded;
   template<typename T, typename V, typename KVIter, typename Iter> friend struct CollectionIterPropertyStorage;
   template<typename V> friend class AbstractObjectVectorStorage;
+  template <typename T> friend class ClassCursor;
   friend class CollectionAppenderBase;
 
   WriteBuf writeBufStart;
   WriteBuf  *curBuf;
 
+  //in-memory state captured by savepoint()
+  struct SavepointState {
+    std::unordered_map<ObjectId, CollectionInfo> collectionInfos;
+    std::vector<std::pair<ClassId, ObjectId>> idCounters;
+    size_t cachePuts;
+    size_t keyResets;
+  };
+  std::vector<SavepointState> m_savepoints;
+
+  //in-memory side effects, recorded while savepoints are active or the transaction is replayable. Undone by
+  //rollbackTo(), and by abort() if the transaction is replayable
+  std::vector<std::pair<ClassId, ObjectId>> m_cachePuts;
+  std::vector<std::function<void()>> m_keyResets;
+
+  //id counters at the time the transaction was made replayable
+  std::vector<std::pair<ClassId, ObjectId>> m_replayIds;
+  bool m_replayable = false;
+
+  bool recording() const {return m_replayable || !m_savepoints.empty();}
+
+  /**
+   * @return the current id counters of all classes and of collections
+   */
+  std::vector<std::pair<ClassId, ObjectId>> idCounters();
+
+  /**
+   * reset the id counters to the given values
+   */
+  void restoreIdCounters(const std::vector<std::pair<ClassId, ObjectId>> &counters);
+
+  /**
+   * undo the side effects recorded after the given positions
+   */
+  void undoSideEffects(size_t cachePuts, size_t keyResets);
+
+  /**
+   * finish the current chunks of all open appenders
+   */
+  void sealAppenders();
+
+  /**
+   * release savepoints and write pending collection data before the backend commit
+   */
+  void prepareCommit();
+
   void writeChunkHeader(size_t startIndex, size_t elementCount);
+  /**
+   * write the header of an object inside a collection chunk
+   * @param size the size of the object data following the header
+   */
   void writeObjectHeader(ClassId classId, ObjectId objectId, size_t size);
 
+  /**
+   * @return the size of a collection element count in the store format
+   */
+  size_t countSize(size_t count) {
+    return store.format() == StoreFormat::compact ? varint_size(count) : 4;
+  }
+
+  /**
+   * write a collection element count in the store format
+   */
+  void appendCount(size_t count) {
+    if(store.format() == StoreFormat::compact) writeBuf().appendVarint(count);
+    else writeBuf().appendInteger<4>(count);
+  }
+
   /**
    * start a new chunk by allocating memory from the KV store for it. Also write the chunk header for the
    * current chunk, if any
@@ -1884,6 +3002,12 @@ class WriteTransaction : public virtual Transaction
    */
   void startChunk(CollectionInfo *collectionInfo, size_t chunkSize, size_t elementCount);
 
+  /**
+   * compress the current chunk (the last chunk of the collection) in place, using the collection codec. The chunk
+   * header must already be written. Nothing happens if the collection has no codec or the data doesn't compress
+   */
+  void compressChunk(CollectionInfo *collectionInfo);
+
 protected:
   const bool m_append;
 
@@ -1903,6 +3027,9 @@ protected:
     using Traits = ClassTraits<T>;
     Properties *props = Traits::getProperties(store.id, classId);
 
+    if(store.isCache<T>()) store.removeCached<T>(classId, objectId);
+    if(props->indexed) removeIndexes(classId, objectId, props);
+
     if(Traits::needsPrepare(store.id, classId)) {
       ObjectBuf prepBuf(this, classId, objectId, true);
       if(!prepBuf.null()) {
@@ -1932,6 +3059,18 @@ protected:
     }
   }
 
+  /**
+   * update the secondary index entries for an object
+   *
+   * @param data the serialized object buffer
+   */
+  void updateIndexes(ClassId classId, ObjectId objectId, Properties *properties, byte_t *data, size_t size);
+
+  /**
+   * remove the secondary index entries for an object
+   */
+  void removeIndexes(ClassId classId, ObjectId objectId, Properties *properties);
+
   /**
    * serialize the object to the write buffer
    */
@@ -1939,11 +3078,16 @@ protected:
   void writeObject(ClassId classId, ObjectId objectId, T &obj, PrepareData &pd, Properties *properties, bool shallow)
   {
     //put data into buffer
+    StoreMode mode = shallow ? StoreMode::force_buffer : StoreMode::force_none;
+    if(auto table = properties->dispatchTable<T>(store.id)) {
+      for(auto &d : *table) d.save(this, classId, objectId, &obj, pd, d.pa, mode);
+      return;
+    }
     for(unsigned px=0, sz=properties->full_size(); px < sz; px++) {
       const PropertyAccessBase *pa = properties->get(px);
       if(!pa->enabled) continue;
 
-      ClassTraits<T>::save(store.id, this, classId, objectId, &obj, pd, pa, shallow ? StoreMode::force_buffer : StoreMode::force_none);
+      ClassTraits<T>::save(store.id, this, classId, objectId, &obj, pd, pa, mode);
     }
   }
 
@@ -1952,6 +3096,15 @@ protected:
   {
     LazyBuf prepBuf(this, key, false);
 
+    if(auto table = properties->dispatchTable<T>(store.id)) {
+      for(auto &d : *table) {
+        prepBuf.mark();
+        size_t psz = d.pa->storeinfo->size(store.id, prepBuf);
+        d.prepareUpdate(store.id, prepBuf, pd, obj, d.pa);
+        prepBuf.unmark(psz);
+      }
+      return;
+    }
     for(unsigned i=0, sz=properties->full_size(); i<sz; i++) {
       auto pa = properties->get(i);
 
@@ -1984,6 +3137,9 @@ protected:
     writeBuf().start(size);
     writeObject(cdata.classId, objectId, obj, pd, properties, shallow);
 
+    if(properties->indexed)
+      updateIndexes(cdata.classId, objectId, properties, writeBuf().data(), writeBuf().size());
+
     if(!putData(cdata.classId, objectId, 0, writeBuf()))
       throw error("data was not saved");
 
@@ -2002,8 +3158,19 @@ protected:
   template <typename T>
   void save_object(ObjectKey &key, const std::shared_ptr<T> &obj, bool useCache, bool setRefcount=true)
   {
-    if(save_object(key, *obj, setRefcount) && useCache)
-      store.objectCaches[key.classId]->put(key.objectId, obj);
+    bool isNew = key.isNew();
+    if(save_object(key, *obj, setRefcount) && useCache) {
+      store.putCache(key.classId, key.objectId, obj);
+      if(recording()) m_cachePuts.push_back(std::make_pair(key.classId, key.objectId));
+    }
+    //the key lives in the object handler and would outlast an undone save
+    if(isNew && recording()) {
+      std::weak_ptr<T> ref = obj;
+      m_keyResets.push_back([ref]() {
+        std::shared_ptr<T> o = ref.lock();
+        if(o) *ClassTraits<T>::getObjectKey(o) = ObjectKey();
+      });
+    }
   }
 
   /**
@@ -2060,6 +3227,9 @@ protected:
     writeBuf().start(size);
     writeObject(key.classId, key.objectId, obj, pd, properties, shallow);
 
+    if(properties->indexed)
+      updateIndexes(key.classId, key.objectId, properties, writeBuf().data(), writeBuf().size());
+
     if(!putData(key, writeBuf()))
       throw error("data was not saved");
 
@@ -2091,7 +3261,7 @@ protected:
     }
   };
 
-  template <typename T, template <typename T> class Ptr>
+  template <typename T, template <typename> class Ptr>
   chunk_helper *prepare_collection(const std::vector<Ptr<T>> &vect, size_t &chunkSize)
   {
     chunk_helper *helpers = new chunk_helper[vect.size()];
@@ -2103,9 +3273,9 @@ protected:
       AbstractClassInfo *classInfo = store.objectClassInfos[classId];
       ObjectId objectId = ++classInfo->data[store.id].maxObjectId;
 
-      size_t sz = calculateBuffer(store.id, &(*vect[i]), properties) + ObjectHeader_sz;
+      size_t sz = calculateBuffer(store.id, &(*vect[i]), properties);
       helpers[i].set(classId, objectId, sz, properties);
-      chunkSize += sz;
+      chunkSize += sz + objectHeaderSize(store.format(), classId, objectId, sz);
     }
     return helpers;
   }
@@ -2117,7 +3287,7 @@ protected:
    * @param collectionInfo the collection info
    * @param poly lookup classes dynamically (slight runtime overhead)
    */
-  template <typename T, template <typename T> class Ptr>
+  template <typename T, template <typename> class Ptr>
   void saveChunk(const std::vector<Ptr<T>> &vect, CollectionInfo *collectionInfo, bool poly)
   {
     if(vect.empty()) return;
@@ -2136,21 +3306,22 @@ protected:
         writeObject(helper.classId, helper.objectId, *vect[i], pd, helper.properties, true);
       }
       delete [] helpers;
+      compressChunk(collectionInfo);
     }
     else {
+      using Traits = ClassTraits<T>;
+      ClassData &cdata = Traits::traits_data(store.id);
+
       size_t chunkSize = 0;
       size_t *sizes = new size_t[vect.size()];
 
       for(size_t i=0, vectSize = vect.size(); i<vectSize; i++) {
-        sizes[i] = calculateBuffer(store.id, &(*vect[i]), ClassTraits<T>::traits_properties) + ObjectHeader_sz;
-        chunkSize += sizes[i];
+        sizes[i] = calculateBuffer(store.id, &(*vect[i]), Traits::traits_properties);
+        chunkSize += sizes[i] + objectHeaderSize(store.format(), cdata.classId, cdata.maxObjectId + i + 1, sizes[i]);
       }
       startChunk(collectionInfo, chunkSize, vect.size());
 
       for(size_t i=0, vectSize = vect.size(); i<vectSize; i++) {
-        using Traits = ClassTraits<T>;
-
-        ClassData &cdata = Traits::traits_data(store.id);
         ClassId classId = cdata.classId;
         ObjectId objectId = ++cdata.maxObjectId;
 
@@ -2159,6 +3330,7 @@ protected:
         writeObject(classId, objectId, *vect[i], pd, Traits::traits_properties, true);
       }
       delete [] sizes;
+      compressChunk(collectionInfo);
     }
   }
 
@@ -2181,13 +3353,15 @@ protected:
 
     for(size_t i=0, vectSize = vect.size(); i<vectSize; i++)
       ValueTraits<T>::putBytes(writeBuf(), vect[i]);
+
+    compressChunk(ci);
   }
 
   /**
    * save raw data collection chunk
    *
-   * @param array (in, out) the raw data array. If != nullptr, data will be copied from here. Otherwise, the
-   * chunk data pointer will be stored here
+   * @param array (in, out) the raw data array. If != nullptr, data will be copied from here and the chunk is
+   * compressed if the collection has a codec. Otherwise, the (uncompressed) chunk data pointer will be stored here
    * @param arraySize the number of items in array
    * @param ci the collection metadata
    */
@@ -2199,8 +3373,11 @@ protected:
     size_t chunkSize = arraySize * sizeof(T);
 
     startChunk(ci, chunkSize, arraySize);
-    if(array) writeBuf().append((byte_t *)array, chunkSize);
-    array = (T *)writeBuf().cur();
+    if(array) {
+      writeBuf().append((byte_t *)array, chunkSize);
+      compressChunk(ci);
+    }
+    else array = (T *)writeBuf().cur();
   }
 
   /**
@@ -2233,9 +3410,57 @@ protected:
    */
   virtual void clearRefCounts(std::vector<ClassId> classes) = 0;
 
+  /**
+   * add a secondary index entry, replacing the previous entry for the same object
+   *
+   * @param classId the id of the class that declares the indexed property
+   * @param propertyId the id of the indexed property
+   * @param key the key of the indexed object
+   * @param value the index-encoded property value
+   */
+  virtual void putIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key, const byte_t *value, size_t size) = 0;
+
+  /**
+   * remove the secondary index entry for the given object, if present
+   */
+  virtual void removeIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key) = 0;
+
+  /**
+   * remove all entries from a secondary index
+   */
+  virtual void clearIndex(ClassId classId, PropertyId propertyId) = 0;
+
   virtual void doCommit() = 0;
 
+  /**
+   * commit without waiting for the data to reach persistent storage. The default implementation commits
+   * synchronously
+   *
+   * @return a future that becomes ready when the data is durable
+   */
+  virtual std::future<void> doCommitAsync();
+
+  /**
+   * begin a nested backend transaction
+   */
+  virtual void doSavepoint() = 0;
+
+  /**
+   * discard the innermost nested backend transaction
+   */
+  virtual void doRollback() = 0;
+
+  /**
+   * commit the innermost nested backend transaction into its parent
+   */
+  virtual void doRelease() = 0;
+
 public:
+  /**
+   * savepoint handle, see #savepoint
+   */
+  using Savepoint = size_t;
+
   virtual ~WriteTransaction();
 
   /**
@@ -2248,7 +3473,50 @@ public:
   /**
    * commit this transaction. Changes written since beginnning of the transaction are written to persistent storage
    */
-  void commit();
+  void commit();
+
+  /**
+   * commit this transaction, but return as soon as the changes are visible to other transactions, without waiting
+   * for them to reach persistent storage. Only backends with relaxed durability settings defer the write, others
+   * commit synchronously
+   *
+   * @return a future that becomes ready when the changes are durable, or receives the error if syncing failed
+   */
+  std::future<void> commitAsync();
+
+  /**
+   * mark the current state of this transaction, so that subsequent changes can be undone with #rollbackTo without
+   * aborting the transaction. Savepoints nest, and are released on commit. Open appenders finish their current
+   * chunk and continue in a new one. Cursors and chunk data pointers obtained before the call must not be used
+   * afterwards
+   *
+   * @return the new savepoint
+   * @throw error if the store does not support savepoints
+   */
+  Savepoint savepoint();
+
+  /**
+   * undo all changes made since the savepoint was set, including ObjectId and collection id assignments and
+   * collection and appender state. The savepoint itself stays valid, savepoints set after it are released.
+   * Appenders created after the savepoint must not be used afterwards
+   *
+   * @throw error if the savepoint is invalid
+   */
+  void rollbackTo(Savepoint savepoint);
+
+  /**
+   * keep the changes made since the savepoint was set and release it, together with all savepoints set after it
+   *
+   * @throw error if the savepoint is invalid
+   */
+  void release(Savepoint savepoint);
+
+  /**
+   * make abort() undo the in-memory side effects of this transaction, so that its operations can be replayed in a
+   * fresh transaction: keys assigned to new persistent objects, objects put into the cache, and advanced id counters.
+   * Must be called before the first write
+   */
+  void setReplayable();
 
   /**
    * put a new object into the KV store. Generate a new ObjectKey and store it inside the returned shared_ptr.
@@ -2277,6 +3545,28 @@ public:
     return key;
   }
 
+  /**
+   * put a range of new objects into the KV store. The objects receive ascending ObjectIds in the order of the range,
+   * consecutive unless saving an object also saves further objects of the same class. Intended for use with
+   * KeyValueStore::beginBulkLoad
+   *
+   * @param begin, end the object range. The iterators must dereference to a non-const object reference
+   * @return the ObjectId of the first object, or 0 if the range was empty
+   */
+  template <typename Iter>
+  ObjectId putObjects(Iter begin, Iter end)
+  {
+    using T = typename std::iterator_traits<Iter>::value_type;
+
+    ObjectId first = 0;
+    for(; begin != end; ++begin) {
+      ObjectKey key;
+      save_object<T>(key, *begin, true);
+      if(!first) first = key.objectId;
+    }
+    return first;
+  }
+
   /**
    * save object state into the KV store. Use the passed ObjectKey to determine whether a new key will be assigned or an
    * existing key will be overwritten (insert or update). Update the key accordingly
@@ -2379,10 +3669,10 @@ public:
                      bool saveMembers=true)
   {
     ObjectKey *key = ClassTraits<T>::getObjectKey(obj);
-    size_t bufSz = vect.size()*ObjectKey_sz+4;
+    size_t bufSz = vect.size()*ObjectKey_sz + countSize(vect.size());
 
     writeBuf().start(bufSz);
-    writeBuf().appendInteger<size_t>(vect.size(), 4);
+    appendCount(vect.size());
 
     for(auto &v : vect) {
       if(saveMembers || isNew(v)) {
@@ -2413,7 +3703,7 @@ public:
       ReadBuf buf;
       getData(buf, key->classId, key->objectId, propertyId);
       if(!buf.null()) {
-        size_t sz = buf.readInteger<size_t>(4);
+        size_t sz = readCount(buf);
         for(size_t i=0; i<sz; i++) {
           ObjectKey key;
           buf.read(key);
@@ -2435,15 +3725,39 @@ public:
    */
   void deleteCollection(ObjectId collectionId);
 
+  /**
+   * set the chunk codec for a top-level collection. The codec is saved with the collection and applies to all
+   * chunks written afterwards, including those written by appenders. Existing chunks are left as they are, and
+   * chunks handed out for direct writing (see putDataCollection(T **, size_t)) are never compressed
+   *
+   * @param collectionId (in, out) a collection id. If 0, a new collection is created and its id stored here
+   * @param codec the codec
+   */
+  void setCollectionCodec(ObjectId &collectionId, ChunkCodec codec);
+
+  /**
+   * rewrite the chunks of a top-level collection densely. Runs of adjacent uncompressed chunks are merged up to
+   * the optimal chunk size, and unused space left at the end of chunks by appenders is dropped. Compressed
+   * chunks are left as they are. The collection contents are not changed
+   *
+   * @param collectionId a collection id. Silently ignored if invalid
+   * @return the number of chunks that were rewritten
+   * @throw error if the collection has open appenders
+   */
+  size_t packCollection(ObjectId collectionId);
+
   /**
    * create a top-level (chunked) object collection.
    *
    * @param vect the initial collection contents
+   * @param codec the chunk codec for the collection
    * @return the collection ID
    */
-  template <typename T, template <typename> class Ptr> ObjectId putCollection(const std::vector<Ptr<T>> &vect)
+  template <typename T, template <typename> class Ptr> ObjectId putCollection(
+      const std::vector<Ptr<T>> &vect, ChunkCodec codec = ChunkCodec::none)
   {
     CollectionInfo *ci = new CollectionInfo(++store.m_maxCollectionId);
+    ci->codec = codec;
     m_collectionInfos[ci->collectionId] = ci;
 
     saveChunk(vect, ci, ClassTraits<T>::traits_info->isPoly());
@@ -2455,11 +3769,13 @@ public:
    * save a top-level (chunked) value collection.
    *
    * @param vect the initial collection contents
+   * @param codec the chunk codec for the collection
    */
   template <typename T>
-  ObjectId putValueCollection(const std::vector<T> &vect)
+  ObjectId putValueCollection(const std::vector<T> &vect, ChunkCodec codec = ChunkCodec::none)
   {
     CollectionInfo *ci = new CollectionInfo(++store.m_maxCollectionId);
+    ci->codec = codec;
     m_collectionInfos[ci->collectionId] = ci;
 
     saveChunk(vect, ci);
@@ -2474,12 +3790,14 @@ public:
    *
    * @param array the initial collection contents.
    * @param arraySize length of the contents
+   * @param codec the chunk codec for the collection
    */
   template <typename T>
-  ObjectId putDataCollection(const T* array, size_t arraySize)
+  ObjectId putDataCollection(const T* array, size_t arraySize, ChunkCodec codec = ChunkCodec::none)
   {
     RAWDATA_API_ASSERT(T)
     CollectionInfo *ci = new CollectionInfo(++store.m_maxCollectionId);
+    ci->codec = codec;
     m_collectionInfos[ci->collectionId] = ci;
 
     saveChunk(array, arraySize, ci);
@@ -2516,7 +3834,7 @@ public:
    * @param collectionId the id of the collection to apend to
    * @param vect the collection contents
    */
-  template <typename T, template <typename T> class Ptr>
+  template <typename T, template <typename> class Ptr>
   void appendCollection(ObjectId collectionId, const std::vector<Ptr<T>> &vect)
   {
     CollectionInfo *ci = getCollectionInfo(collectionId);
@@ -2604,6 +3922,38 @@ public:
     clearRefCounts(ClassTraits<T>::traits_info->allClassIds(store.id));
   }
 
+  /**
+   * rebuild the secondary indexes for all instances of T (including subclasses). Indexes declared by T and its
+   * subclasses are cleared first, entries in indexes declared by superclasses are updated. Needed after an index
+   * was declared on a property of a class with existing instances
+   */
+  template <typename T>
+  void rebuildIndexes()
+  {
+    std::vector<ClassId> classIds = ClassTraits<T>::traits_info->allClassIds(store.id);
+
+    for(ClassId cid : classIds) {
+      Properties *props = ClassTraits<T>::getProperties(store.id, cid);
+      for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
+        const PropertyAccessBase *pa = props->get(px);
+        if(pa->enabled && pa->index && pa->classId[store.id] == cid) clearIndex(cid, pa->id);
+      }
+    }
+
+    CursorHelper *helper = _openCursor(classIds);
+    for(bool hasData = helper->start(); hasData; hasData = helper->next()) {
+      ObjectKey key;
+      ReadBuf readBuf;
+      helper->get(key, readBuf);
+
+      Properties *props = ClassTraits<T>::getProperties(store.id, key.classId);
+      if(!readBuf.null() && props->indexed)
+        updateIndexes(key.classId, key.objectId, props, readBuf.data(), readBuf.size());
+    }
+    helper->close();
+    delete helper;
+  }
+
   /**
   * appender for sequentially extending a top-level, chunked object collection
   */
@@ -2635,9 +3985,10 @@ public:
         oid = ++ClassTraits<T>::traits_data(m_tr->store.id).maxObjectId;
         properties = ClassTraits<T>::traits_properties;
       }
-      size_t size = calculateBuffer(m_tr->store.id, &obj, properties) + ObjectHeader_sz;
+      size_t size = calculateBuffer(m_tr->store.id, &obj, properties);
+      size_t total = size + objectHeaderSize(m_tr->store.format(), cid, oid, size);
 
-      if(collectionInfo()->chunkInfos.empty() || m_writeBuf.avail() < size) startChunk(size);
+      if(collectionInfo()->chunkInfos.empty() || avail() < total) startChunk(total);
 
       m_tr->writeObjectHeader(cid, oid, size);
       m_tr->writeObject(cid, oid, obj, pd, properties, true);
@@ -2682,7 +4033,7 @@ public:
       size_t sz = TypeTraits<T>::byteSize;
       if(sz == 0) sz = ValueTraits<T>::size(val);
 
-      size_t avail = m_writeBuf.avail();
+      size_t avail = this->avail();
 
       if(collectionInfo()->chunkInfos.empty() || avail < sz) startChunk(sz);
 
@@ -2706,7 +4057,7 @@ public:
 
     void put(T *val, size_t size)
     {
-      size_t avail = m_writeBuf.avail() / sizeof(T);
+      size_t avail = this->avail() / sizeof(T);
 
       if(avail) {
         size_t putsz = avail > size ? size : avail;
@@ -2766,6 +4117,459 @@ public:
   }
 };
 
+template <typename T>
+bool ClassCursor<T>::erase(WriteTransactionPtr tr)
+{
+  ObjectKey key;
+
+  ReadBuf readBuf;
+  m_helper->get(key, readBuf);
+  if(readBuf.null()) return m_hasData;
+  if(key.refcount > 1) throw error("removeObject: refcount > 1");
+
+  using Traits = ClassTraits<T>;
+
+  Properties *props = Traits::getProperties(m_store.id, key.classId);
+  if(props->indexed) tr->removeIndexes(key.classId, key.objectId, props);
+
+  if(Traits::needsPrepare(m_store.id, key.classId)) {
+    ObjectBuf obuf(readBuf.data(), readBuf.size());
+
+    for(unsigned px=0, sz=props->full_size(); px < sz; px++) {
+      const PropertyAccessBase *pa = props->get(px);
+
+      if(!pa->enabled) continue;
+
+      obuf.mark();
+      size_t psz = pa->storeinfo->size(m_store.id, obuf);
+      ClassTraits<T>::prepareDelete(m_store.id, tr.get(), obuf, pa);
+      obuf.unmark(psz);
+    }
+  }
+
+  //now remove the object proper
+  if(m_useCache) m_store.removeCached<T>(key.classId, key.objectId);
+
+  if(m_helper->erase()) {
+    //the helper is positioned after the erased object
+    bool hasData=true, clsFound = validateClass();
+    while(!clsFound && (hasData = m_helper->next())) clsFound = validateClass();
+
+    m_hasData = hasData && clsFound;
+  }
+  else m_hasData = false;
+
+  if(!m_hasData) close();
+  return m_hasData;
+}
+
+/**
+ * parallel scan over all instances of a class hierarchy. The ObjectId range of each class is split into partitions,
+ * which are distributed over a number of worker threads. Each worker uses its own read transaction, and all
+ * transactions see the same database snapshot.
+ */
+template <typename T>
+class ParallelScan
+{
+  struct Partition {
+    ClassId classId;
+    ObjectId startId, endId;
+
+    Partition(ClassId classId, ObjectId startId, ObjectId endId) : classId(classId), startId(startId), endId(endId) {}
+  };
+
+  KeyValueStore &m_store;
+  const unsigned m_threads;
+  const unsigned m_partitionsPerThread;
+
+  std::vector<Partition> partitions()
+  {
+    std::vector<Partition> parts;
+    for(ClassId cid : ClassTraits<T>::traits_info->allClassIds(m_store.id)) {
+      ObjectId maxId = m_store.objectClassInfos.at(cid)->data[m_store.id].maxObjectId;
+
+      uint64_t step = maxId / (m_threads * m_partitionsPerThread) + 1;
+      uint64_t start = 0;
+      for(; start + step <= maxId; start += step)
+        parts.push_back(Partition(cid, (ObjectId)start, (ObjectId)(start + step)));
+
+      //last partition is open-ended
+      parts.push_back(Partition(cid, (ObjectId)start, 0));
+    }
+    return parts;
+  }
+
+  /**
+   * run fn for each partition on the worker threads. fn is called with the partition index and a cursor
+   */
+  void run(std::function<void(size_t, typename ClassCursor<T>::Ptr)> fn, std::vector<Partition> &parts)
+  {
+    unsigned workers = m_threads < parts.size() ? m_threads : (unsigned)parts.size();
+    std::vector<ReadTransactionPtr> txns = m_store.beginSnapshotReads(workers);
+
+    std::atomic<size_t> nextPart(0);
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+
+    auto work = [&](ReadTransactionPtr txn) {
+      try {
+        for(size_t px = nextPart++; px < parts.size(); px = nextPart++) {
+          Partition &part = parts[px];
+          fn(px, txn->openCursor<T>(part.classId, part.startId, part.endId));
+        }
+      }
+      catch(...) {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        if(!failure) failure = std::current_exception();
+        nextPart = parts.size();
+      }
+      txn->end();
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i=1; i<workers; i++) threads.push_back(std::thread(work, txns[i]));
+    work(txns[0]);
+    for(auto &thread : threads) thread.join();
+
+    if(failure) std::rethrow_exception(failure);
+  }
+
+public:
+  /**
+   * @param store the store
+   * @param threads the number of worker threads. If 0, the number of hardware threads is used
+   * @param partitionsPerThread the number of ObjectId partitions per thread and class. More partitions
+   * balance the load better if objectIds are unevenly distributed
+   */
+  ParallelScan(KeyValueStore &store, unsigned threads=0, unsigned partitionsPerThread=4)
+      : m_store(store),
+        m_threads(threads ? threads : (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)),
+        m_partitionsPerThread(partitionsPerThread ? partitionsPerThread : 1)
+  {}
+
+  /**
+   * call fn for every instance of T. Note that fn is called concurrently from multiple threads
+   */
+  void forEach(std::function<void(std::shared_ptr<T>)> fn)
+  {
+    std::vector<Partition> parts = partitions();
+    run([&fn](size_t px, typename ClassCursor<T>::Ptr cursor) {
+      for(; !cursor->atEnd(); cursor->next()) fn(cursor->get());
+    }, parts);
+  }
+
+  /**
+   * @param predicate selects the instances to return. Called concurrently from multiple threads
+   * @param ordered if true, the result is in the same order as delivered by a sequential ClassCursor. Otherwise,
+   * instances are returned in the order they were found
+   * @return all instances of T for which predicate returned true
+   */
+  std::vector<std::shared_ptr<T>> getInstances(
+      std::function<bool(std::shared_ptr<T>)> predicate=all_predicate<T>, bool ordered=true)
+  {
+    std::vector<Partition> parts = partitions();
+    std::vector<std::vector<std::shared_ptr<T>>> partResults(parts.size());
+
+    std::vector<std::shared_ptr<T>> result;
+    std::mutex resultMutex;
+
+    run([&](size_t px, typename ClassCursor<T>::Ptr cursor) {
+      std::vector<std::shared_ptr<T>> &found = partResults[px];
+      for(; !cursor->atEnd(); cursor->next()) {
+        std::shared_ptr<T> obj = cursor->get();
+        if(predicate(obj)) found.push_back(obj);
+      }
+      if(!ordered && !found.empty()) {
+        std::lock_guard<std::mutex> lock(resultMutex);
+        result.insert(result.end(), found.begin(), found.end());
+        found.clear();
+      }
+    }, parts);
+
+    if(ordered) {
+      size_t count = 0;
+      for(auto &found : partResults) count += found.size();
+      result.reserve(count);
+      for(auto &found : partResults) result.insert(result.end(), found.begin(), found.end());
+    }
+    return result;
+  }
+};
+
+/**
+ * parallel loading of top-level collections. The chunks of a collection are distributed over a number of worker
+ * threads, each of which uses its own read transaction. Since the collection info records the start index and element
+ * count of every chunk, each chunk is decoded directly into its slots of the presized result. All transactions see
+ * the same database snapshot
+ */
+class ParallelCollectionLoad
+{
+  KeyValueStore &m_store;
+  const unsigned m_threads;
+
+  /**
+   * run fn for each chunk of the collection on the worker threads. fn is called with the worker transaction, the
+   * chunk, the chunk data positioned after the header, and the result offset of the chunk's first element
+   *
+   * @return the collection size as recorded in the collection info
+   */
+  size_t run(ObjectId collectionId, std::function<void(Transaction *, const ChunkInfo &, ReadBuf &, size_t)> fn,
+             std::function<void(size_t)> presize)
+  {
+    std::vector<ReadTransactionPtr> txns = m_store.beginSnapshotReads(m_threads);
+
+    CollectionInfo *ci = txns[0]->getCollectionInfo(collectionId, false);
+    if(!ci) {
+      for(auto &txn : txns) txn->end();
+      throw error("collection not found");
+    }
+    std::vector<ChunkInfo> chunks = ci->chunkInfos;
+    std::vector<size_t> offsets(chunks.size());
+    size_t size = 0;
+    for(size_t i=0; i<chunks.size(); i++) {
+      offsets[i] = size;
+      size += chunks[i].elementCount;
+    }
+    presize(size);
+
+    unsigned workers = m_threads < chunks.size() ? m_threads : (unsigned)chunks.size();
+    if(!workers) workers = 1;
+    for(size_t i=workers; i<txns.size(); i++) txns[i]->end();
+
+    std::atomic<size_t> nextChunk(0);
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+
+    auto work = [&](ReadTransactionPtr txn) {
+      try {
+        ChunkCursor::Ptr cc = txn->_openChunkCursor(COLLECTION_CLSID, collectionId);
+        for(size_t cx = nextChunk++; cx < chunks.size(); cx = nextChunk++) {
+          cc->seek(chunks[cx].chunkId);
+          if(cc->atEnd()) throw error("collection chunk not found");
+
+          ReadBuf buf;
+          cc->get(buf);
+          size_t elementCount;
+          readChunkHeader(buf, 0, 0, &elementCount);
+          if(elementCount != chunks[cx].elementCount) throw error("collection chunk does not match collection info");
+
+          fn(txn.get(), chunks[cx], buf, offsets[cx]);
+        }
+        cc->close();
+      }
+      catch(...) {
+        std::lock_guard<std::mutex> lock(failureMutex);
+        if(!failure) failure = std::current_exception();
+        nextChunk = chunks.size();
+      }
+      txn->end();
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned i=1; i<workers; i++) threads.push_back(std::thread(work, txns[i]));
+    work(txns[0]);
+    for(auto &thread : threads) thread.join();
+
+    if(failure) std::rethrow_exception(failure);
+    return size;
+  }
+
+public:
+  /**
+   * @param store the store
+   * @param threads the number of worker threads. If 0, the number of hardware threads is used
+   */
+  ParallelCollectionLoad(KeyValueStore &store, unsigned threads=0)
+      : m_store(store),
+        m_threads(threads ? threads : (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1))
+  {}
+
+  /**
+   * load a top-level (chunked) object collection, like Transaction::getCollection
+   *
+   * @param collectionId an id returned from a previous #putCollection call
+   * @throw error if the collection does not exist
+   */
+  template <typename T, template <typename> class Ptr=std::shared_ptr> std::vector<Ptr<T>> getCollection(
+      ObjectId collectionId)
+  {
+    std::vector<Ptr<T>> result;
+    std::atomic<size_t> skipped(0);
+
+    run(collectionId, [&](Transaction *txn, const ChunkInfo &chunk, ReadBuf &buf, size_t offset) {
+      size_t count = txn->readObjectChunk<T, Ptr>(buf, chunk.elementCount, result.begin() + offset);
+      skipped += chunk.elementCount - count;
+    }, [&](size_t size) {result.resize(size);});
+
+    //deleted objects left empty slots at the end of their chunks
+    if(skipped) result.erase(std::remove(result.begin(), result.end(), nullptr), result.end());
+    return result;
+  }
+
+  /**
+   * load a top-level (chunked) value collection, like Transaction::getValueCollection
+   *
+   * @param collectionId an id returned from a previous #putCollection call
+   * @throw error if the collection does not exist
+   */
+  template <typename T>
+  std::vector<T> getValueCollection(ObjectId collectionId)
+  {
+    static_assert(!std::is_same<T, bool>::value, "parallel load not supported for std::vector<bool>");
+
+    std::vector<T> result;
+    run(collectionId, [&](Transaction *txn, const ChunkInfo &chunk, ReadBuf &buf, size_t offset) {
+      Transaction::readValueChunk<T>(buf, chunk.elementCount, result.begin() + offset);
+    }, [&](size_t size) {result.resize(size);});
+    return result;
+  }
+};
+
+/**
+ * WriteQueue configuration
+ */
+struct WriteQueueOptions
+{
+  //maximum number of operations committed in one transaction
+  const size_t maxBatch;
+  //maximum time the writer waits for more operations to join a batch
+  const std::chrono::milliseconds maxDelay;
+
+  WriteQueueOptions(size_t maxBatch=1000, std::chrono::milliseconds maxDelay=std::chrono::milliseconds(2))
+      : maxBatch(maxBatch ? maxBatch : 1), maxDelay(maxDelay) {}
+};
+
+/**
+ * holder for the result of a queued write operation. The promise is fulfilled after the batch was committed. The
+ * result is staged until then, so R need not be default constructible. A replayed operation replaces it
+ */
+template <typename R>
+struct WriteResult
+{
+  std::promise<R> promise;
+  std::unique_ptr<R> value;
+
+  template <typename F> void apply(F &fn, WriteTransaction *tr) {value.reset(new R(fn(tr)));}
+  void complete() {promise.set_value(std::move(*value));}
+};
+template <>
+struct WriteResult<void>
+{
+  std::promise<void> promise;
+
+  template <typename F> void apply(F &fn, WriteTransaction *tr) {fn(tr);}
+  void complete() {promise.set_value();}
+};
+
+/**
+ * asynchronous group-commit write queue. Operations can be submitted concurrently from any number of threads.
+ * A dedicated writer thread collects them into batches (bounded by WriteQueueOptions), runs each batch inside one
+ * write transaction and commits once. The futures returned from the submit functions become ready after the commit.
+ * If an operation throws, only its own future receives the exception. The operations before it are replayed and
+ * committed, and the remaining ones continue in a fresh transaction. A replayed transaction starts from the in-memory
+ * state of the first attempt (see WriteTransaction::setReplayable). Objects handed to the queue must not be modified
+ * until the future is ready.
+ */
+class WriteQueue
+{
+  WriteQueue(const WriteQueue &other) = delete;
+
+  struct Operation {
+    std::function<void(WriteTransaction *)> apply;
+    std::function<void()> complete;
+    std::function<void(std::exception_ptr)> fail;
+  };
+
+  KeyValueStore &m_store;
+  const WriteQueueOptions m_options;
+
+  std::deque<Operation> m_queue;
+  std::mutex m_mutex;
+  std::condition_variable m_queued, m_done;
+  size_t m_pending = 0;
+  bool m_closed = false;
+  std::thread m_writer;
+
+  void enqueue(Operation &&op);
+  void writeLoop();
+  void writeBatch(std::vector<Operation> &batch);
+
+public:
+  using Ptr = std::shared_ptr<WriteQueue>;
+
+  WriteQueue(KeyValueStore &store, const WriteQueueOptions &options=WriteQueueOptions());
+
+  /**
+   * close the queue. Pending operations are committed before the destructor returns
+   */
+  ~WriteQueue();
+
+  /**
+   * submit a generic write operation
+   *
+   * @param fn the operation, called with the batch transaction on the writer thread. Must not commit or abort
+   * @return a future for the result of fn
+   * @throw error if the queue is closed
+   */
+  template <typename F>
+  auto submit(F fn) -> std::future<decltype(fn((WriteTransaction *)nullptr))>
+  {
+    using R = decltype(fn((WriteTransaction *)nullptr));
+    std::shared_ptr<WriteResult<R>> result = std::make_shared<WriteResult<R>>();
+    std::future<R> future = result->promise.get_future();
+
+    Operation op;
+    op.apply = [result, fn](WriteTransaction *tr) mutable {result->apply(fn, tr);};
+    op.complete = [result]() {result->complete();};
+    op.fail = [result](std::exception_ptr ex) {result->promise.set_exception(ex);};
+    enqueue(std::move(op));
+
+    return future;
+  }
+
+  /**
+   * queue a copy of obj for insertion
+   *
+   * @return a future for the new ObjectKey
+   */
+  template <typename T>
+  std::future<ObjectKey> put(const T &obj)
+  {
+    T copy(obj);
+    return submit([copy](WriteTransaction *tr) mutable {return tr->putObject(copy);});
+  }
+
+  /**
+   * queue a persistent object for saving (insert or update)
+   *
+   * @return a future for the object ID
+   */
+  template <typename T>
+  std::future<ObjectId> save(std::shared_ptr<T> obj)
+  {
+    return submit([obj](WriteTransaction *tr) {return tr->saveObject(obj);});
+  }
+
+  /**
+   * queue a persistent object for deletion
+   */
+  template <typename T>
+  std::future<void> remove(std::shared_ptr<T> obj)
+  {
+    return submit([obj](WriteTransaction *tr) {tr->deleteObject(obj);});
+  }
+
+  /**
+   * wait until all operations submitted so far have been processed
+   */
+  void flush();
+
+  /**
+   * commit all pending operations and stop the writer thread. No operations are accepted afterwards
+   */
+  void close();
+};
+
 /**
  * storage class template for scalar types that are saved under an individual key (property id). The type
  * must be supported by a ValueTraits template
@@ -2980,6 +4784,50 @@ struct ValueEmbeddedStorage<T, std::string> : public StoreAccessBase<T>
   }
 };
 
+/**
+ * storage class template for integral types that go into the shallow buffer as LEB128 varint, with signed values
+ * zigzag-encoded. Small values take less space than with ValueEmbeddedStorage, at the price of making the
+ * enclosing class variable-sized
+ */
+template<typename T, typename V>
+struct VarintEmbeddedStorage : public StoreAccessBase<T>
+{
+  static_assert(std::is_integral<V>::value, "varint storage requires an integral type");
+
+  static uint64_t encode(V val) {
+    return std::is_signed<V>::value ? zigzag_encode((int64_t)val) : (uint64_t)val;
+  }
+  static V decode(uint64_t val) {
+    return std::is_signed<V>::value ? (V)zigzag_decode(val) : (V)val;
+  }
+
+  size_t size(StoreId storeId, ObjectBuf &buf) const override
+  {
+    size_t sz;
+    read_varint(buf.getReadBuf().cur(), &sz);
+    return sz;
+  }
+  size_t size(StoreId storeId, T *tp, const PropertyAccessBase *pa) const override
+  {
+    V val;
+    ClassTraits<T>::put(storeId, *tp, pa, val);
+    return varint_size(encode(val));
+  }
+  void save(WriteTransaction *tr,
+            ClassId classId, ObjectId objectId, T *tp, PrepareData &pd, const PropertyAccessBase *pa, StoreMode mode) const override
+  {
+    V val;
+    ClassTraits<T>::put(tr->store.id, *tp, pa, val);
+    tr->writeBuf().appendVarint(encode(val));
+  }
+  void load(Transaction *tr, ReadBuf &buf,
+            ClassId classId, ObjectId objectId, T *tp, const PropertyAccessBase *pa, StoreMode mode) const override
+  {
+    V val = decode(buf.readVarint());
+    ClassTraits<T>::get(tr->store.id, *tp, pa, val);
+  }
+};
+
 /**
  * storage template for ClassId-typed properties. The ClassId (which is already part of the key) is mapped to an
  * object property
@@ -3058,7 +4906,7 @@ template<typename T, typename V> struct ObjectPropertyStorageEmbedded : public S
 
   ObjectPropertyStorageEmbedded() : StoreAccessBase<T>(StoreLayout::all_embedded) {}
 
-  size_t size(StoreId storeId, ObjectBuf &buf) const override {return buf.readInteger<unsigned>(4);}
+  size_t size(StoreId storeId, ObjectBuf &buf) const override {return buf.readInteger<unsigned, 4>();}
   size_t size(StoreId storeId, T *tp, const PropertyAccessBase *pa) const override {
     size_t sz = ClassTraits<V>::traits_properties->fixedSize;
     if(sz)  return sz + 4;
@@ -3077,7 +4925,7 @@ template<typename T, typename V> struct ObjectPropertyStorageEmbedded : public S
     size_t sz = ClassTraits<V>::traits_properties->fixedSize;
     if(!sz) sz = calculateBuffer(tr->store.id, &val, ClassTraits<V>::traits_properties);
 
-    tr->writeBuf().appendInteger(sz, 4);
+    tr->writeBuf().appendInteger<4>(sz);
     tr->writeObject(childClassId, 1, val, pd, ClassTraits<V>::traits_properties, true);
   }
   void load(Transaction *tr, ReadBuf &buf,
@@ -3086,7 +4934,7 @@ template<typename T, typename V> struct ObjectPropertyStorageEmbedded : public S
     ClassId childClassId = ClassTraits<V>::traits_data(tr->store.id).classId;
 
     V v;
-    buf.readInteger<unsigned>(4);
+    buf.readInteger<unsigned, 4>();
     readObject(tr->store.id, tr, buf, v, childClassId, 1);
 
     ClassTraits<T>::get(tr->store.id, *tp, pa, v);
@@ -3198,7 +5046,7 @@ template<typename T, typename V> struct ObjectPtrPropertyStorageEmbedded : publi
 {
   size_t size(StoreId storeId, ObjectBuf &buf) const override {
     buf.read(ClassId_sz);
-    unsigned objSize = buf.readInteger<unsigned>(4);
+    unsigned objSize = buf.readInteger<unsigned, 4>();
     return ClassId_sz + 4 + objSize;
   }
   size_t size(StoreId storeId, T *tp, const PropertyAccessBase *pa) const override {
@@ -3216,8 +5064,8 @@ template<typename T, typename V> struct ObjectPtrPropertyStorageEmbedded : publi
     ClassId childClassId = 0;
     size_t sz = val ? ClassTraits<V>::bufferSize(tr->store.id, &(*val), &childClassId) : 0;
 
-    tr->writeBuf().appendInteger(childClassId, ClassId_sz);
-    tr->writeBuf().appendInteger(sz, 4);
+    tr->writeBuf().appendInteger<ClassId_sz>(childClassId);
+    tr->writeBuf().appendInteger<4>(sz);
 
     if(val) tr->writeObject(childClassId, 1, *val, pd, ClassTraits<V>::getProperties(tr->store.id, childClassId), true);
   }
@@ -3225,8 +5073,8 @@ template<typename T, typename V> struct ObjectPtrPropertyStorageEmbedded : publi
             ClassId classId, ObjectId objectId, T *tp, const PropertyAccessBase *pa, StoreMode mode) const override
   {
     std::shared_ptr<V> val;
-    ClassId childClassId = buf.readInteger<ClassId>(ClassId_sz);
-    unsigned sz = buf.readInteger<unsigned>(4);
+    ClassId childClassId = buf.readInteger<ClassId, ClassId_sz>();
+    unsigned sz = buf.readInteger<unsigned, 4>();
     if(sz) {
       ClassInfo<V> *vi = FIND_CLS(V, tr->store.id, childClassId);
       if(!vi) {
@@ -3239,7 +5087,7 @@ template<typename T, typename V> struct ObjectPtrPropertyStorageEmbedded : publi
         buf.unmark(sz);
       }
       else {
-        V *vp = vi->makeObject(tr->store.id, childClassId);
+        V *vp = vi->makeObject(tr->store.id, childClassId, nullptr);
         readObject<V>(tr->store.id, tr, buf, childClassId, 1, vp);
         val.reset(vp);
       }
@@ -3323,14 +5171,14 @@ template<typename T, typename V> class ObjectVectorPropertyStorageEmbedded : pub
 {
 public:
   size_t size(StoreId storeId, ObjectBuf &buf) const override {
-    unsigned vectSize = buf.readInteger<unsigned>(4);
+    unsigned vectSize = buf.readInteger<unsigned, 4>();
     size_t sz = ClassTraits<V>::traits_properties->fixedSize;
     if(sz) {
       return vectSize * (sz + 4) + 4;
     }
     else {
       for(unsigned i=0; i<vectSize; i++) {
-        unsigned objSize = buf.readInteger<unsigned>(4);
+        unsigned objSize = buf.readInteger<unsigned, 4>();
         buf.read(objSize);
         sz += 4 + objSize;
       }
@@ -3355,14 +5203,14 @@ public:
     std::vector<V> val;
     ClassTraits<T>::put(tr->store.id, *tp, pa, val);
 
-    tr->writeBuf().appendInteger((unsigned)val.size(), 4);
+    tr->writeBuf().appendInteger<4>((unsigned)val.size());
     ClassId childClassId = ClassTraits<V>::traits_data(tr->store.id).classId;
     PropertyId childObjectId = 0;
     size_t fsz = ClassTraits<V>::traits_properties->fixedSize;
     for(V &v : val) {
       size_t sz = fsz ? fsz : calculateBuffer(tr->store.id, &v, ClassTraits<V>::traits_properties);
 
-      tr->writeBuf().appendInteger(sz, 4);
+      tr->writeBuf().appendInteger<4>(sz);
       tr->writeObject(childClassId, ++childObjectId, v, pd, ClassTraits<V>::traits_properties, true);
     }
   }
@@ -3375,10 +5223,10 @@ public:
     ClassId childClassId = ClassTraits<V>::traits_data(tr->store.id).classId;
     PropertyId childObjectId = 0;
 
-    unsigned sz = buf.readInteger<unsigned>(4);
+    unsigned sz = buf.readInteger<unsigned, 4>();
     for(size_t i=0; i< sz; i++) {
       V v;
-      buf.readInteger<unsigned>(4);
+      buf.readInteger<unsigned, 4>();
       readObject(tr->store.id, tr, buf, v, childClassId, ++childObjectId);
       val.push_back(v);
     }
@@ -3501,22 +5349,29 @@ public:
     tr->getData(readBuf, classId, objectId, pa->id);
 
     if(!readBuf.null()) {
-      object_handler<V> handler;
-      while(readBuf.read(handler)) {
-        ClassInfo<V> *vi = FIND_CLS(V, tr->store.id, handler.classId);
-        if(!vi) {
+      //collect the child keys and load the known classes in one sorted pass. Keys of unknown classes are left
+      //empty (classId 0), getObjects skips them
+      size_t count = readBuf.size() / ObjectKey_sz;
+      std::vector<ObjectKey> keys(count), loadKeys(count);
+      for(size_t i=0; i<count; i++) {
+        readBuf.read(keys[i]);
+        if(FIND_CLS(V, tr->store.id, keys[i].classId)) loadKeys[i] = keys[i];
+      }
+      std::vector<std::shared_ptr<V>> loaded = tr->getObjects<V>(loadKeys);
+
+      val.reserve(count);
+      for(size_t i=0; i<count; i++) {
+        if(!loadKeys[i].classId) {
           V *vp = ClassTraits<V>::getSubstitute();
           if(vp) {
+            object_handler<V> handler(keys[i]);
             tr->loadSubstitute<V>(*vp, handler.classId, handler.objectId);
             val.push_back(std::shared_ptr<V>(vp, handler));
           }
         }
-        else {
-          std::shared_ptr<V> obj = tr->loadObject<V>(handler);
-          if(obj) {
-            if(inverse) ClassTraits<V>::get(tr->store.id, *obj, inverse, tp);
-            val.push_back(obj);
-          }
+        else if(loaded[i]) {
+          if(inverse) ClassTraits<V>::get(tr->store.id, *loaded[i], inverse, tp);
+          val.push_back(loaded[i]);
         }
       }
     }
@@ -3535,7 +5390,7 @@ template<typename T, typename V> class ObjectPtrVectorPropertyStorageEmbedded :
 {
 public:
   size_t size(StoreId storeId, ObjectBuf &buf) const override {
-    unsigned vectSize = buf.readInteger<unsigned>(4);
+    unsigned vectSize = buf.readInteger<unsigned, 4>();
     size_t sz = ClassTraits<V>::traits_properties->fixedSize;
     if(sz) {
       return vectSize * (sz + ClassId_sz + 4) + 4;
@@ -3543,7 +5398,7 @@ public:
     else {
       for(unsigned i=0; i<vectSize; i++) {
         buf.read(ClassId_sz);
-        unsigned objSize = buf.readInteger<unsigned>(4);
+        unsigned objSize = buf.readInteger<unsigned, 4>();
         buf.read(objSize);
         sz += ClassId_sz + 4 + objSize;
       }
@@ -3569,14 +5424,14 @@ public:
     std::vector<std::shared_ptr<V>> val;
     ClassTraits<T>::put(tr->store.id, *tp, pa, val);
 
-    tr->writeBuf().appendInteger((unsigned)val.size(), 4);
+    tr->writeBuf().appendInteger<4>((unsigned)val.size());
     PropertyId childObjectId = 0;
     for(std::shared_ptr<V> &v : val) {
       ClassId childClassId;
       size_t sz = ClassTraits<V>::bufferSize(tr->store.id, &(*v), &childClassId);
 
-      tr->writeBuf().appendInteger(childClassId, ClassId_sz);
-      tr->writeBuf().appendInteger(sz, 4);
+      tr->writeBuf().appendInteger<ClassId_sz>(childClassId);
+      tr->writeBuf().appendInteger<4>(sz);
       tr->writeObject(childClassId, ++childObjectId, *v, pd, ClassTraits<V>::getProperties(tr->store.id, childClassId), true);
     }
   }
@@ -3588,10 +5443,10 @@ public:
 
     PropertyId childObjectId = 0;
 
-    unsigned len = buf.readInteger<unsigned>(4);
+    unsigned len = buf.readInteger<unsigned, 4>();
     for(size_t i=0; i<len; i++) {
-      ClassId childClassId = buf.readInteger<ClassId>(ClassId_sz);
-      unsigned sz = buf.readInteger<unsigned>(4);
+      ClassId childClassId = buf.readInteger<ClassId, ClassId_sz>();
+      unsigned sz = buf.readInteger<unsigned, 4>();
 
       ClassInfo<V> *vi = FIND_CLS(V, tr->store.id, childClassId);
       if(!vi) {
@@ -3604,7 +5459,7 @@ public:
         buf.unmark(sz);
       }
       else {
-        V *vp = vi->makeObject(tr->store.id, childClassId);
+        V *vp = vi->makeObject(tr->store.id, childClassId, nullptr);
         readObject<V>(tr->store.id, tr, buf, childClassId, ++childObjectId, vp);
         val.push_back(std::shared_ptr<V>(vp));
       }
@@ -3693,6 +5548,15 @@ struct ValuePropertyEmbeddedAssign : public ValuePropertyAssign<O, P, ValueEmbed
       : ValuePropertyAssign<O, P, ValueEmbeddedStorage, p>(name) {}
 };
 
+/**
+ * mapping configuration for integral types that are stored into the shallow buffer as varints. Cannot be indexed
+ */
+template <typename O, typename P, P O::*p>
+struct ValuePropertyVarintAssign : public PropertyAssign<O, P, p> {
+  ValuePropertyVarintAssign(const char * name)
+      : PropertyAssign<O, P, p>(name, new VarintEmbeddedStorage<O, P>(), PropertyType(TypeTraits<P>::id, 0, false)) {}
+};
+
 /**
  * mapping configuration for an ObjectId property
  */
@@ -75,6 +75,12 @@ class invalid_classid_error : public error
 public:
   invalid_classid_error(ClassId cid) : error(mk("invalid classid: ", cid), "is class registered?") {}
 };
+class store_full_error : public error
+{
+public:
+  store_full_error(const std::string& detail="")
+      : error("store full: abort the transaction and retry, see KeyValueStore::write", detail) {}
+};
 
 struct PropertyType
 {
@@ -339,14 +345,10 @@ struct ValueTraits : public ValueTraitsBase<true>
     return TypeTraits<T>::byteSize;
   }
   static void getBytes(ReadBuf &buf, T &val) {
-    size_t byteSize = TypeTraits<T>::byteSize;
-    const byte_t *data = buf.read(byteSize);
-    val = read_integer<T>(data, byteSize);
+    val = buf.readInteger<T, TypeTraits<T>::byteSize>();
   }
   static void putBytes(WriteBuf &buf, T &val) {
-    size_t byteSize = TypeTraits<T>::byteSize;
-    byte_t *data = buf.allocate(byteSize);
-    write_integer(data, val, byteSize);
+    buf.appendInteger<TypeTraits<T>::byteSize>(val);
   }
 };
 
@@ -474,8 +476,195 @@ struct ValueTraits<float> : public ValueTraitsFloat<float> {};
 template <>
 struct ValueTraits<double> : public ValueTraitsFloat<double> {};
 
+/** maximum size of an encoded index value. Longer (string) values are truncated */
+static const size_t IndexValue_maxsz = 256;
+
+/**
+ * order-preserving encoding of property values for secondary indexes. Encoded values compare like the original
+ * values under memcmp. Only specializations are defined, so unsupported types fail to compile
+ */
+template <typename P, typename Enable=void> struct IndexTraits;
+
+/**
+ * index encoding for integral values: big-endian, with the sign bit flipped for signed types
+ */
+template <typename P>
+struct IndexTraits<P, typename std::enable_if<std::is_integral<P>::value && !std::is_same<P, bool>::value>::type>
+{
+  static size_t encode(const P &val, byte_t *out) {
+    using U = typename std::make_unsigned<P>::type;
+    U u = (U)val;
+    if(std::is_signed<P>::value) u ^= (U)1 << (sizeof(P) * 8 - 1);
+    write_integer<sizeof(P)>(out, u);
+    return sizeof(P);
+  }
+};
+
+/**
+ * index encoding for boolean values
+ */
+template <>
+struct IndexTraits<bool>
+{
+  static size_t encode(const bool &val, byte_t *out) {
+    *out = byte_t(val ? 1 : 0);
+    return 1;
+  }
+};
+
+/**
+ * index encoding for enum values, using the underlying type
+ */
+template <typename P>
+struct IndexTraits<P, typename std::enable_if<std::is_enum<P>::value>::type>
+{
+  static size_t encode(const P &val, byte_t *out) {
+    using underlying_t = typename std::underlying_type<P>::type;
+    return IndexTraits<underlying_t>::encode(static_cast<underlying_t>(val), out);
+  }
+};
+
+/**
+ * index encoding for floating point values: big-endian, with all bits flipped for negative values and the sign
+ * bit flipped otherwise
+ */
+template <typename P>
+struct IndexTraits<P, typename std::enable_if<std::is_floating_point<P>::value>::type>
+{
+  static size_t encode(const P &val, byte_t *out) {
+    using U = typename std::conditional<sizeof(P) == 4, uint32_t, uint64_t>::type;
+    static const U signBit = (U)1 << (sizeof(P) * 8 - 1);
+
+    U u;
+    memcpy(&u, &val, sizeof(P));
+    u = (u & signBit) ? ~u : u | signBit;
+    write_integer<sizeof(P)>(out, u);
+    return sizeof(P);
+  }
+};
+
+/**
+ * decoding of fixed-width embedded property values for Transaction::loadColumns. Only specializations are defined,
+ * so unsupported column types fail to compile
+ */
+template <typename P, typename Enable=void> struct ColumnTraits;
+
+/**
+ * column decoding for integral values, which are stored big-endian
+ */
+template <typename P>
+struct ColumnTraits<P, typename std::enable_if<std::is_integral<P>::value && !std::is_same<P, bool>::value>::type>
+{
+  static P decode(const byte_t *data) {
+    return read_integer<P, TypeTraits<P>::byteSize>(data);
+  }
+};
+
+/**
+ * column decoding for boolean values
+ */
+template <>
+struct ColumnTraits<bool>
+{
+  static bool decode(const byte_t *data) {
+    return *data != 0;
+  }
+};
+
+/**
+ * column decoding for floating point and enum values, which are stored natively
+ */
+template <typename P>
+struct ColumnTraits<P, typename std::enable_if<std::is_floating_point<P>::value || std::is_enum<P>::value>::type>
+{
+  static P decode(const byte_t *data) {
+    P val;
+    memcpy(&val, data, sizeof(P));
+    return val;
+  }
+};
+
+/**
+ * index encoding for C strings: the string bytes followed by a terminating 0
+ */
+template <>
+struct IndexTraits<const char *>
+{
+  static size_t encode(const char * const &val, byte_t *out) {
+    size_t len = strlen(val);
+    if(len > IndexValue_maxsz - 1) len = IndexValue_maxsz - 1;
+    memcpy(out, val, len);
+    out[len] = 0;
+    return len + 1;
+  }
+};
+
+/**
+ * index encoding for strings
+ */
+template <>
+struct IndexTraits<std::string>
+{
+  static size_t encode(const std::string &val, byte_t *out) {
+    return IndexTraits<const char *>::encode(val.c_str(), out);
+  }
+};
+
+/**
+ * non-templated base class for secondary index declarations
+ */
+struct PropertyIndexBase
+{
+  virtual ~PropertyIndexBase() {}
+
+  /**
+   * read the serialized property value at the current buffer position and write its index encoding
+   *
+   * @param out target buffer of at least IndexValue_maxsz bytes
+   * @return the encoded size
+   */
+  virtual size_t encode(ReadBuf &buf, byte_t *out) const = 0;
+};
+
+/**
+ * secondary index declaration for a property of type P. Created through the MAPPED_PROP_INDEXED macro
+ */
+template <typename P>
+struct PropertyIndex : public PropertyIndexBase
+{
+  size_t encode(ReadBuf &buf, byte_t *out) const override {
+    P val;
+    ValueTraits<P>::getBytes(buf, val);
+    return IndexTraits<P>::encode(val, out);
+  }
+};
+
 class Properties;
 
+/**
+ * precomputed dispatch entry for one enabled property of a class. The functions are bound to the class that declares
+ * the property, so that (de)serialization can run over a flat list without resolving the class hierarchy for each
+ * property. The object pointer must point to the subobject of the type the table was selected for, see
+ * Properties::dispatchTable
+ */
+struct PropertyDispatch
+{
+  const PropertyAccessBase *pa;
+  size_t (*size)(StoreId storeId, void *obj, const PropertyAccessBase *pa);
+  void (*prepareUpdate)(StoreId storeId, ObjectBuf &buf, PrepareData &pd, void *obj, const PropertyAccessBase *pa);
+  void (*save)(WriteTransaction *tr, ClassId classId, ObjectId objectId, void *obj, PrepareData &pd,
+               const PropertyAccessBase *pa, StoreMode mode);
+  void (*load)(Transaction *tr, ReadBuf &buf, ClassId classId, ObjectId objectId, void *obj,
+               const PropertyAccessBase *pa, StoreMode mode);
+
+  /**
+   * @return a dispatch entry for a property declared by D, for use with objects of type U (D or a subclass of D)
+   * that are passed as A (U or a superclass of U)
+   */
+  template <typename A, typename U, typename D>
+  static PropertyDispatch make(const PropertyAccessBase *pa);
+};
+
 /**
  * non-templated base class for property accessors
  */
@@ -488,6 +677,7 @@ struct PropertyAccessBase
   StoreInfo *storeinfo;
   const PropertyType type;
   const char *inverse_name;
+  const PropertyIndexBase *index = nullptr;
 
   PropertyAccessBase(const char * name, StoreInfo *storage, const PropertyType &type)
       : name(name), storeinfo(storage), type(type), inverse_name(nullptr) {}
@@ -495,7 +685,7 @@ struct PropertyAccessBase
   PropertyAccessBase(const char * name, const char * inverse, const PropertyType &type)
       : name(name), storeinfo(new NullStorage()), type(type), inverse_name(inverse) {}
 
-  virtual ~PropertyAccessBase() {delete storeinfo;}
+  virtual ~PropertyAccessBase() {delete storeinfo; delete index;}
 
   virtual void setup(Properties *props) const {}
 };
@@ -526,6 +716,47 @@ template <typename O, typename P, P O::*p> struct PropertyAssign : public Proper
   P get(O &o) const override { return o.*p;}
 };
 
+/**
+ * declare a secondary index on a property accessor. Used by the MAPPED_PROP_INDEXED macro
+ */
+template <typename P>
+PropertyAccessBase *indexed(PropertyAccessBase *pa)
+{
+  if(pa->type.byteSize != TypeTraits<P>::byteSize)
+    throw error("index requires the property's native encoding", pa->name);
+  pa->index = new PropertyIndex<P>();
+  return pa;
+}
+
+template <typename A, typename U, typename D>
+PropertyDispatch PropertyDispatch::make(const PropertyAccessBase *pa)
+{
+  struct fn {
+    static const StoreAccessBase<D> *sa(const PropertyAccessBase *pa) {
+      return static_cast<const StoreAccessBase<D> *>(pa->storeinfo);
+    }
+    //typed downcast, so that the pointer is adjusted if A is not at offset 0 within U
+    static U *downcast(void *o) {
+      return static_cast<U *>(static_cast<A *>(o));
+    }
+    static size_t size(StoreId storeId, void *o, const PropertyAccessBase *pa) {
+      return sa(pa)->size(storeId, downcast(o), pa);
+    }
+    static void prepareUpdate(StoreId storeId, ObjectBuf &buf, PrepareData &pd, void *o, const PropertyAccessBase *pa) {
+      sa(pa)->prepareUpdate(storeId, buf, pd, downcast(o), pa);
+    }
+    static void save(WriteTransaction *tr, ClassId classId, ObjectId objectId, void *o, PrepareData &pd,
+                     const PropertyAccessBase *pa, StoreMode mode) {
+      sa(pa)->save(tr, classId, objectId, downcast(o), pd, pa, mode);
+    }
+    static void load(Transaction *tr, ReadBuf &buf, ClassId classId, ObjectId objectId, void *o,
+                     const PropertyAccessBase *pa, StoreMode mode) {
+      sa(pa)->load(tr, buf, classId, objectId, downcast(o), pa, mode);
+    }
+  };
+  return PropertyDispatch {pa, &fn::size, &fn::prepareUpdate, &fn::save, &fn::load};
+}
+
 template <typename T> struct ClassTraits;
 
 /**
@@ -556,6 +787,30 @@ protected:
 public:
   size_t fixedSize;
 
+  //true if this class or a superclass declares secondary indexes
+  bool indexed = false;
+
+  //a dispatch table for objects of this class that are accessed through a pointer to the class owning the
+  //properties given by owner (this class or a mapped superclass)
+  struct DispatchTable {
+    const Properties *owner;
+    std::vector<PropertyDispatch> entries;
+  };
+
+  //per-store dispatch tables, built at schema registration. See ClassTraitsBase::buildDispatch
+  std::vector<DispatchTable> dispatch[MAX_DATABASES];
+
+  /**
+   * @tparam A the static type of the object pointer passed to the dispatch functions (this class or a superclass)
+   * @return the dispatch table for the given store, or nullptr if none was built (class not registered)
+   */
+  template <typename A>
+  const std::vector<PropertyDispatch> *dispatchTable(StoreId storeId) const {
+    for(auto &table : dispatch[storeId])
+      if(table.owner == ClassTraits<A>::traits_properties) return &table.entries;
+    return nullptr;
+  }
+
   virtual void init() = 0;
 
   template <typename O>
@@ -627,6 +882,14 @@ public:
       }
     }
 
+    //see if we have secondary indexes. Only embedded properties can be indexed
+    indexed = superIter && superIter->indexed;
+    for(unsigned i=0; i<numProps; i++) {
+      const PropertyAccessBase *pa = *decl_props[i];
+      if(pa->enabled && pa->index && pa->storeinfo && pa->storeinfo->layout == StoreLayout::all_embedded)
+        indexed = true;
+    }
+
     //see if we're fixed size
     fixedSize = 0;
     if(superIter) {
@@ -866,7 +1129,7 @@ struct ClassInfo : public AbstractClassInfo
   T *(* const getSubstitute)();
   size_t (* const size)(StoreId storeId, T *obj);
   bool (* const initMember)(StoreId storeId, WriteTransaction *tr, T &obj, const PropertyAccessBase *pa, unsigned flags);
-  T * (* const makeObject)(StoreId storeId, ClassId classId);
+  T * (* const makeObject)(StoreId storeId, ClassId classId, ObjectArena *arena);
   bool (* const needs_prepare)(StoreId storeId, ClassId classId, bool &result, unsigned flags);
   Properties * (* const getProperties)(StoreId storeId, ClassId classId);
   bool (* const addSize)(StoreId storeId, T *obj, const PropertyAccessBase *pa, size_t &size, unsigned flags);
@@ -877,6 +1140,7 @@ struct ClassInfo : public AbstractClassInfo
                       ClassId classId, ObjectId objectId, T *obj, PrepareData &pd, const PropertyAccessBase *pa, StoreMode mode, unsigned flags);
   bool (* const load)(StoreId storeId, Transaction *tr, ReadBuf &buf,
                       ClassId classId, ObjectId objectId, T *obj, const PropertyAccessBase *pa, StoreMode mode, unsigned flags);
+  void (* const buildDispatch)(StoreId storeId);
 
   sub::Substitute<T> *substitute = nullptr;
 
@@ -893,7 +1157,8 @@ struct ClassInfo : public AbstractClassInfo
         prep_delete(&ClassTraits<T>::prep_delete),
         prep_update(&ClassTraits<T>::prep_update),
         save(&ClassTraits<T>::save),
-        load(&ClassTraits<T>::load) {}
+        load(&ClassTraits<T>::load),
+        buildDispatch(&ClassTraits<T>::buildDispatch) {}
 
   ~ClassInfo() {if(substitute) delete substitute;}
 
@@ -958,6 +1223,10 @@ class ClassTraitsBase
     if(traits_properties->fixedSize) return traits_properties->fixedSize;
 
     size_t size = 0;
+    if(auto table = traits_properties->dispatchTable<T>(storeId)) {
+      for(auto &d : *table) size += d.size(storeId, obj, d.pa);
+      return size;
+    }
     for(unsigned i=0, sz=traits_properties->full_size(); i<sz; i++) {
       auto pa = traits_properties->get(i);
 
@@ -1022,6 +1291,60 @@ public:
     }
   }
 
+  /**
+   * (re)build the property dispatch tables for this class and all subclasses. Called at schema registration, after
+   * the classIds have been assigned. One table is built for each type (this class and its mapped superclasses)
+   * through which objects of this class may be passed. If a property cannot be resolved yet, no tables are built and
+   * the hierarchy search is used instead
+   */
+  static void buildDispatch(StoreId storeId)
+  {
+    std::vector<Properties::DispatchTable> &tables = traits_properties->dispatch[storeId];
+    tables.clear();
+    addDispatch<T>(storeId, tables);
+    for(auto &sub : traits_info->subs) {
+      static_cast<ClassInfo<T> *>(sub)->buildDispatch(storeId);
+    }
+  }
+
+  /**
+   * add a dispatch table for objects of type U passed as T, and continue with the superclass
+   * @tparam U the class the tables are built for
+   */
+  template <typename U>
+  static void addDispatch(StoreId storeId, std::vector<Properties::DispatchTable> &tables)
+  {
+    Properties *props = ClassTraits<U>::traits_properties;
+    tables.push_back(Properties::DispatchTable {traits_properties});
+    std::vector<PropertyDispatch> &table = tables.back().entries;
+    for(unsigned i=0, sz=props->full_size(); i<sz; i++) {
+      auto pa = props->get(i);
+      if(pa->enabled && !ClassTraits<U>::template bindDispatch<T, U>(storeId, pa, table)) {
+        tables.clear();
+        return;
+      }
+    }
+    ClassTraits<SUP>::template addDispatch<U>(storeId, tables);
+  }
+
+  /**
+   * add a dispatch entry for pa to table if pa is declared by this class, otherwise try the superclass
+   * @tparam A the type through which objects are passed
+   * @tparam U the class the table is built for
+   * @return false if no declaring class was found
+   */
+  template <typename A, typename U>
+  static bool bindDispatch(StoreId storeId, const PropertyAccessBase *pa, std::vector<PropertyDispatch> &table)
+  {
+    if(pa->classId[storeId] == traits_data(storeId).classId) {
+      table.push_back(PropertyDispatch::make<A, U, T>(pa));
+      return true;
+    }
+    else if(pa->classId[storeId])
+      return ClassTraits<SUP>::template bindDispatch<A, U>(storeId, pa, table);
+    return false;
+  }
+
   static bool needsPrepare(StoreId storeId, ClassId classId) {
     bool result;
     if(!needs_prepare(storeId, classId, result)) throw invalid_classid_error(classId);
@@ -1223,13 +1546,13 @@ template <typename T> struct ClassTraitsAbstract
 {
   static const bool isAbstract = true;
 
-  static T *makeObject(StoreId storeId, ClassId classId)
+  static T *makeObject(StoreId storeId, ClassId classId, ObjectArena *arena=nullptr)
   {
     if(classId == ClassTraits<T>::traits_data(storeId).classId) {
       throw error("abstract class cannot be instantiated");
     }
     else if(classId)
-      return RESOLVE_SUB(classId)->makeObject(storeId, classId);
+      return RESOLVE_SUB(classId)->makeObject(storeId, classId, arena);
     return nullptr;
   }
 };
@@ -1241,13 +1564,13 @@ template <typename T> struct ClassTraitsConcrete
 {
   static const bool isAbstract = false;
 
-  static T *makeObject(StoreId storeId, ClassId classId)
+  static T *makeObject(StoreId storeId, ClassId classId, ObjectArena *arena=nullptr)
   {
     if(classId == ClassTraits<T>::traits_data(storeId).classId) {
-      return new T();
+      return arena ? arena->create<T>() : new T();
     }
     else if(classId)
-      return RESOLVE_SUB(classId)->makeObject(storeId, classId);
+      return RESOLVE_SUB(classId)->makeObject(storeId, classId, arena);
     return nullptr;
   }
 };
@@ -1259,13 +1582,13 @@ template <typename T, typename R> struct ClassTraitsConcreteRepl
 {
   static const bool isAbstract = false;
 
-  static T *makeObject(StoreId storeId, ClassId classId)
+  static T *makeObject(StoreId storeId, ClassId classId, ObjectArena *arena=nullptr)
   {
     if(classId == ClassTraits<T>::traits_data(storeId).classId) {
-      return new R();
+      return arena ? arena->create<R>() : new R();
     }
     else if(classId)
-      return RESOLVE_SUB(classId)->makeObject(storeId, classId);
+      return RESOLVE_SUB(classId)->makeObject(storeId, classId, arena);
     return nullptr;
   }
 };
@@ -1282,7 +1605,7 @@ struct ClassTraits<EmptyClass>
   static const unsigned num_decl_props = 0;
   static const PropertyAccessBase ** decl_props[0];
 
-  static EmptyClass *makeObject(StoreId storeId, ClassId classId) {return nullptr;}
+  static EmptyClass *makeObject(StoreId storeId, ClassId classId, ObjectArena *arena=nullptr) {return nullptr;}
   static Properties * getProperties(StoreId storeId, ClassId classId) {return nullptr;}
 
   static inline ClassData &traits_data(StoreId storeId) {
@@ -1320,6 +1643,15 @@ struct ClassTraits<EmptyClass>
   static bool addSize(StoreId storeId, T *obj, const PropertyAccessBase *pa, size_t &size, unsigned flags=0) {
     return false;
   }
+  static void buildDispatch(StoreId storeId) {
+  }
+  template <typename U>
+  static void addDispatch(StoreId storeId, std::vector<Properties::DispatchTable> &tables) {
+  }
+  template <typename A, typename U>
+  static bool bindDispatch(StoreId storeId, const PropertyAccessBase *pa, std::vector<PropertyDispatch> &table) {
+    return false;
+  }
   template <typename T>
   static ObjectKey *getObjectKey(const std::shared_ptr<T> &obj, bool force=true) {
     return nullptr;
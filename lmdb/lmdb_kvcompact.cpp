@@ -0,0 +1,67 @@
+/*
+ * LightningObjects C++ Object Storage based on Key/Value API
+ *
+ * Copyright (C) 2016 GS Vitec GmbH <christian@gsvitec.com>
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, and provided
+ * in the LICENSE file in the root directory of this software.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <kvstore.h>
+#include "lmdb_kvstore.h"
+
+using namespace std;
+using namespace lo::persistence;
+
+int main(int argc, char* argv[])
+{
+  if(argc < 3) {
+    cout << "usage: lo_compact <path> <name> [<target>]" << endl;
+    cout << "compacts the database in place, or writes a compacted copy to <target> if given" << endl;
+    return -1;
+  }
+
+  string path(argv[1]);
+  string name(argv[2]);
+  string target(argc > 3 ? argv[3] : "");
+
+  string fullpath = path + "/" + name;
+  if(!ifstream(fullpath.c_str())) {
+    cout << "database not found: " << fullpath << endl;
+    return -1;
+  }
+
+  try {
+    KeyValueStore *kv = lmdb::KeyValueStore::Factory{0, path, name};
+    kv::CompactStats stats = kv->compact(target);
+    delete kv;
+
+    cout << "size before:      " << stats.sizeBefore << " bytes" << endl;
+    cout << "size after:       " << stats.sizeAfter << " bytes" << endl;
+    cout << "reclaimed:        " << stats.reclaimed() << " bytes" << endl;
+    cout << "chunks rewritten: " << stats.chunksRewritten << endl;
+    cout << "time:             " << stats.duration.count() << " ms" << endl;
+  }
+  catch(kv::error &e) {
+    cout << "database error " << e.what() << endl;
+    return -1;
+  }
+  catch(invalid_argument &e) {
+    cout << "error " << e.what() << endl;
+    return -1;
+  }
+  return 0;
+}
@@ -20,7 +20,16 @@
 #include "lmdb_kvstore.h"
 #include "liblmdb/lmdb++.h"
 #include <algorithm>
+#include <mutex>
+#include <new>
+#include <unordered_set>
 #include <sys/stat.h>
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
 
 namespace lo {
 namespace persistence {
@@ -32,6 +41,10 @@ using namespace persistence;
 
 static const char * CLASSDATA = "classdata";
 static const char * CLASSMETA = "classmeta";
+static const char * CLASSINDEX = "classindex";
+
+//STOREINFO_CLSID records [STOREINFO_CLSID, classId, IDCOUNTER_PROPID] hold the ObjectId counters of multi-process stores
+static const PropertyId IDCOUNTER_PROPID = 1;
 
 static const unsigned ObjectId_off = ClassId_sz;
 static const unsigned PropertyId_off = ClassId_sz + ObjectId_sz;
@@ -69,6 +82,47 @@ int key_compare(const MDB_val *a, const MDB_val *b)
   return c;
 }
 
+/**
+ * sequential readahead for cursors over the memory map. Once a cursor has moved out of the region advised last,
+ * the kernel is asked to page in the region following the current position, so that cold scans don't fault
+ * page by page
+ */
+class Readahead
+{
+  unsigned m_pageSize = 0;
+  unsigned m_count = 0;
+  uintptr_t m_advisedStart = 0, m_advisedEnd = 0;
+
+public:
+  Readahead() {}
+
+  /**
+   * @param pageSize the database page size
+   * @param count the number of strides to read ahead. 0 disables readahead
+   */
+  Readahead(unsigned pageSize, unsigned count) : m_pageSize(pageSize), m_count(count) {}
+
+  /**
+   * the cursor is positioned on the given data
+   *
+   * @param stride the expected distance to the next data, e.g. the chunk size. At least one page is assumed
+   */
+  void advance(const byte_t *data, size_t size, size_t stride=0)
+  {
+#ifndef _WIN32
+    uintptr_t end = (uintptr_t)data + size;
+    if(!m_count || ((uintptr_t)data >= m_advisedStart && end <= m_advisedEnd)) return;
+
+    uintptr_t start = (uintptr_t)data & ~(uintptr_t)(m_pageSize - 1);
+    m_advisedStart = start;
+    m_advisedEnd = end + (stride > m_pageSize ? stride : m_pageSize) * m_count;
+
+    //failures are harmless, e.g. if the region extends beyond the map
+    madvise((void *)start, m_advisedEnd - start, MADV_WILLNEED);
+#endif
+  }
+};
+
 /**
  * class cursor backend. Iterates over all instances of a given set of classes
  */
@@ -76,6 +130,8 @@ class ClassCursorHelper : public lo::persistence::kv::CursorHelper
 {
   ::lmdb::txn &m_txn;
   ::lmdb::dbi &m_dbi;
+  TransactionStats &m_stats;
+  Readahead m_readahead;
 
   ::lmdb::cursor m_cursor;
   ::lmdb::val m_keyval;
@@ -83,15 +139,23 @@ class ClassCursorHelper : public lo::persistence::kv::CursorHelper
   const vector<ClassId> m_classIds;
   unsigned m_index = 0;
 
+  //objectId range [m_startId, m_endId). m_endId == 0 means unbounded
+  const ObjectId m_startId, m_endId;
+
+  bool inRange(byte_t *key, ClassId cid) {
+    return SK_CLASSID(key) == cid && (!m_endId || SK_OBJID(key) < m_endId);
+  }
+
   bool dostart()
   {
     for(; m_index < m_classIds.size(); m_index++) {
       ClassId cid = m_classIds[m_index];
 
-      SK_CONSTR(sk, cid, 0, 0);
+      SK_CONSTR(sk, cid, m_startId, 0);
       m_keyval.assign(sk, sizeof(sk));
 
-      if(m_cursor.get(m_keyval, MDB_SET_RANGE) && SK_CLASSID(m_keyval.data<byte_t>()) == cid) {
+      m_stats.cursorSteps++;
+      if(m_cursor.get(m_keyval, MDB_SET_RANGE) && inRange(m_keyval.data<byte_t>(), cid)) {
         m_currentClassId = cid;
         m_currentObjectId = SK_OBJID(m_keyval.data<byte_t>());
         return true;
@@ -113,7 +177,8 @@ protected:
 
     while(true) {
       while(m_cursor.get(m_keyval, MDB_NEXT)) {
-        if(SK_CLASSID(m_keyval.data<byte_t>()) != cid) {
+        m_stats.cursorSteps++;
+        if(!inRange(m_keyval.data<byte_t>(), cid)) {
           //end of class range
           break;
         }
@@ -133,16 +198,22 @@ protected:
     bool gotten;
     do {
       m_cursor.del();
+      m_stats.removes++;
+      m_stats.cursorSteps++;
       gotten = m_cursor.get(m_keyval, MDB_NEXT);
     } while(gotten &&
         SK_CLASSID(m_keyval.data<byte_t>()) == m_currentClassId &&
             SK_OBJID(m_keyval.data<byte_t>()) == m_currentObjectId);
 
-    if(!gotten)
-      return false;
-    else {
-      return (++m_index < m_classIds.size()) ? dostart() : false;
+    //stay in the current class range as long as it has objects left
+    if(gotten && inRange(m_keyval.data<byte_t>(), m_currentClassId)) {
+      if(SK_PROPID(m_keyval.data<byte_t>()) == 0) {
+        m_currentObjectId = SK_OBJID(m_keyval.data<byte_t>());
+        return true;
+      }
+      return next();
     }
+    return (++m_index < m_classIds.size()) ? dostart() : false;
   }
 
   virtual void close() override {
@@ -155,6 +226,10 @@ protected:
     if(m_cursor.get(m_keyval, dataval, MDB_GET_CURRENT)) {
       SK_RET(key, m_keyval.data<byte_t>());
       rb.start(dataval.data<byte_t>(), dataval.size());
+      m_readahead.advance(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
     }
   }
 
@@ -164,12 +239,18 @@ protected:
       buf.key.classId = SK_CLASSID(m_keyval.data<byte_t>());
       buf.key.objectId = SK_OBJID(m_keyval.data<byte_t>());
       buf.start(dataval.data<byte_t>(), dataval.size());
+      m_readahead.advance(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
     }
   }
 
 public:
-  ClassCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, const vector<ClassId> &classIds)
-      : m_txn(txn), m_dbi(dbi), m_cursor(::lmdb::cursor::open(m_txn, m_dbi)), m_classIds(classIds)
+  ClassCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, TransactionStats &stats, const Readahead &readahead,
+                    const vector<ClassId> &classIds, ObjectId startId=0, ObjectId endId=0)
+      : m_txn(txn), m_dbi(dbi), m_stats(stats), m_readahead(readahead), m_cursor(::lmdb::cursor::open(m_txn, m_dbi)),
+        m_classIds(classIds), m_startId(startId), m_endId(endId)
   {}
   ~ClassCursorHelper() {m_cursor.close();}
 };
@@ -184,14 +265,21 @@ class ChunkCursorImpl : public lo::persistence::kv::ChunkCursor
 
   ::lmdb::txn &m_txn;
   ::lmdb::dbi &m_dbi;
+  TransactionStats &m_stats;
+  ChunkCache &m_chunkCache;
+  Readahead m_readahead;
   ::lmdb::val keyval;
   ::lmdb::val dataval;
   ::lmdb::cursor m_cursor;
+  PropertyId m_chunkId = 0;
 
 public:
-  ChunkCursorImpl(::lmdb::txn &txn, ::lmdb::dbi &dbi, ClassId classId, ObjectId objectId, bool toEnd=false)
-      : m_txn(txn), m_dbi(dbi), m_cursor(::lmdb::cursor::open(txn, dbi)), m_classId(classId), m_objectId(objectId)
+  ChunkCursorImpl(::lmdb::txn &txn, ::lmdb::dbi &dbi, TransactionStats &stats, ChunkCache &chunkCache,
+                  const Readahead &readahead, ClassId classId, ObjectId objectId, bool toEnd=false)
+      : m_classId(classId), m_objectId(objectId), m_txn(txn), m_dbi(dbi), m_stats(stats), m_chunkCache(chunkCache),
+        m_readahead(readahead), m_cursor(::lmdb::cursor::open(txn, dbi))
   {
+    m_stats.cursorSteps++;
     if(toEnd) {
       SK_CONSTR(k, classId, objectId, 0xFFFF);
       keyval.assign(k, sizeof(k));
@@ -205,37 +293,54 @@ public:
         ok = cursor.get(keyval, dataval, MDB_LAST);
 
       m_atEnd = !(ok && SK_CLASSID(keyval.data<byte_t>()) == classId && SK_OBJID(keyval.data<byte_t>()) == objectId);
+      if(!m_atEnd) m_chunkId = SK_PROPID(keyval.data<byte_t>());
     }
     else {
       SK_CONSTR(k, classId, objectId, 1);
       keyval.assign(k, sizeof(k));
 
       m_atEnd = !m_cursor.get(keyval, dataval, MDB_SET);
+      m_chunkId = 1;
     }
   }
 
   bool seek(PropertyId chunkId) override {
+    m_stats.cursorSteps++;
     SK_CONSTR(k, m_classId, m_objectId, chunkId);
     keyval.assign(k, sizeof(k));
 
     m_atEnd = !m_cursor.get(keyval, dataval, MDB_SET);
+    m_chunkId = chunkId;
     return m_atEnd;
   }
 
   bool next(PropertyId *chunkId = nullptr) override {
+    m_stats.cursorSteps++;
     m_atEnd = !m_cursor.get(keyval, dataval, MDB_NEXT);
 
     if(!m_atEnd)
       m_atEnd = SK_CLASSID(keyval.data<byte_t>()) != m_classId || SK_OBJID(keyval.data<byte_t>()) != m_objectId;
 
-    if(chunkId && !m_atEnd)
-      *chunkId = SK_PROPID(keyval.data<byte_t>());
-
+    if(!m_atEnd) {
+      m_chunkId = SK_PROPID(keyval.data<byte_t>());
+      if(chunkId) *chunkId = m_chunkId;
+    }
     return !m_atEnd;
   }
 
   void get(ReadBuf &rb) override {
-    rb.start(dataval.data<byte_t>(), dataval.size());
+    //chunks are usually stored in sequence, so the current chunk size is a good stride
+    m_readahead.advance(dataval.data<byte_t>(), dataval.size(), dataval.size());
+
+    if(ChunkCache::compressed(dataval.data<byte_t>(), dataval.size())) {
+      //the buffer shares the decompressed chunk with the cache
+      rb.start(m_chunkCache.get(m_objectId, m_chunkId, dataval.data<byte_t>(), dataval.size()));
+    }
+    else
+      rb.start(dataval.data<byte_t>(), dataval.size());
+
+    m_stats.reads++;
+    m_stats.bytesRead += dataval.size();
   }
 
   void close() override {
@@ -251,6 +356,9 @@ class CollectionCursorHelper : public lo::persistence::kv::CursorHelper
 {
   ::lmdb::txn &m_txn;
   ::lmdb::dbi &m_dbi;
+  TransactionStats &m_stats;
+  ChunkCache &m_chunkCache;
+  const Readahead m_readahead;
 
   const ClassId m_classId;
   const ObjectId m_collectionId;
@@ -264,8 +372,8 @@ class CollectionCursorHelper : public lo::persistence::kv::CursorHelper
     m_chunkSize = m_chunkIndex=0;
     if(!m_chunkCursor->atEnd()) {
       m_chunkCursor->get(m_readBuf);
-      m_chunkSize = m_readBuf.readInteger<size_t>(4);
-      m_readBuf.readInteger<ObjectId>(ObjectId_sz); //throw away
+      m_chunkSize = m_readBuf.readInteger<size_t, 4>();
+      m_readBuf.readInteger<ObjectId, ObjectId_sz>(); //throw away
       m_data = m_readBuf.cur();
 
       m_currentClassId = SK_CLASSID(m_data);
@@ -278,7 +386,7 @@ class CollectionCursorHelper : public lo::persistence::kv::CursorHelper
 
 protected:
   bool start() {
-    m_chunkCursor = new ChunkCursorImpl(m_txn, m_dbi, m_classId, m_collectionId);
+    m_chunkCursor = new ChunkCursorImpl(m_txn, m_dbi, m_stats, m_chunkCache, m_readahead, m_classId, m_collectionId);
     return prepare_chunk();
   }
 
@@ -289,6 +397,7 @@ protected:
       if(!prepare_chunk()) return false;
     }
     else {
+      m_stats.cursorSteps++;
       m_data = m_readBuf.cur() + m_chunkIndex * StorageKey::byteSize;
 
       m_currentClassId = SK_CLASSID(m_data);
@@ -312,8 +421,12 @@ protected:
     ::lmdb::val keyval {m_data, StorageKey::byteSize};
     ::lmdb::val dataval;
 
-    if(m_dbi.get(m_txn, keyval, dataval))
+    if(m_dbi.get(m_txn, keyval, dataval)) {
       rb.start(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
+    }
   }
 
   void getObjectData(ObjectBuf &buf) override
@@ -321,13 +434,19 @@ protected:
     ::lmdb::val keyval {m_data, StorageKey::byteSize};
     ::lmdb::val dataval;
 
-    if(m_dbi.get(m_txn, keyval, dataval))
+    if(m_dbi.get(m_txn, keyval, dataval)) {
       buf.start(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
+    }
   }
 
 public:
-  CollectionCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, ClassId classId, ObjectId collectionId)
-  : m_txn(txn), m_dbi(dbi), m_classId(classId), m_collectionId(collectionId)
+  CollectionCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, TransactionStats &stats, ChunkCache &chunkCache,
+                         const Readahead &readahead, ClassId classId, ObjectId collectionId)
+  : m_txn(txn), m_dbi(dbi), m_stats(stats), m_chunkCache(chunkCache), m_readahead(readahead), m_classId(classId),
+    m_collectionId(collectionId)
   {}
   ~CollectionCursorHelper() {
     if(m_chunkCursor) delete m_chunkCursor;
@@ -341,6 +460,7 @@ class VectorCursorHelper : public lo::persistence::kv::CursorHelper
 {
   ::lmdb::txn &m_txn;
   ::lmdb::dbi &m_dbi;
+  TransactionStats &m_stats;
 
   ::lmdb::val m_vectordata;
   size_t m_index, m_size;
@@ -361,6 +481,9 @@ protected:
     if(m_dbi.get(m_txn, keyval, m_vectordata)) {
       m_size = m_vectordata.size() / ObjectKey_sz;
 
+      m_stats.reads++;
+      m_stats.bytesRead += m_vectordata.size();
+
       m_currentClassId = SK_CLASSID(m_vectordata.data<byte_t>());
       m_currentObjectId = SK_OBJID(m_vectordata.data<byte_t>());
 
@@ -372,6 +495,7 @@ protected:
   bool next() override
   {
     if(++m_index < m_size) {
+      m_stats.cursorSteps++;
       byte_t *data = m_vectordata.data<byte_t>() + m_index * ObjectKey_sz;
       m_currentClassId = SK_CLASSID(data);
       m_currentObjectId = SK_OBJID(data);
@@ -387,6 +511,7 @@ protected:
     ::lmdb::val keyval;
     keyval.assign(keydata, StorageKey::byteSize);
     m_dbi.del(m_txn, keyval);
+    m_stats.removes++;
 
     return ++m_index < m_size;
   }
@@ -408,6 +533,9 @@ protected:
       if(m_dbi.get(m_txn, keyval, dataval)) {
         SK_RET(key, keydata);
         rb.start(dataval.data<byte_t>(), dataval.size());
+
+        m_stats.reads++;
+        m_stats.bytesRead += dataval.size();
       }
       else {
         throw new error("corrupted vector: item not found");
@@ -426,6 +554,9 @@ protected:
 
       if(m_dbi.get(m_txn, keyval, dataval)) {
         buf.start(dataval.data<byte_t>(), dataval.size());
+
+        m_stats.reads++;
+        m_stats.bytesRead += dataval.size();
       }
       else {
         throw new error("corrupted vector: item not found");
@@ -434,12 +565,167 @@ protected:
   }
 
 public:
-  VectorCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, ClassId classId, ObjectId objectId, PropertyId propertyId)
-      : m_txn(txn), m_dbi(dbi), m_classId(classId), m_objectId(objectId), m_propertyId(propertyId)
+  VectorCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, TransactionStats &stats,
+                     ClassId classId, ObjectId objectId, PropertyId propertyId)
+      : m_txn(txn), m_dbi(dbi), m_stats(stats), m_classId(classId), m_objectId(objectId), m_propertyId(propertyId)
   {}
   ~VectorCursorHelper() {}
 };
 
+/**
+ * secondary index keys. Forward entries map [classId, propertyId, 1, value, object classId, object objectId] to
+ * an empty value, reverse entries map [classId, propertyId, 0, object classId, object objectId] to the value. The
+ * object key is stored big-endian so that entries with the same value are ordered by object key
+ */
+static const unsigned IndexPrefix_sz = ClassId_sz + PropertyId_sz + 1;
+static const unsigned IndexTrailer_sz = ClassId_sz + ObjectId_sz;
+static const unsigned IndexKey_maxsz = IndexPrefix_sz + IndexValue_maxsz + IndexTrailer_sz;
+
+static const byte_t IndexTag_reverse = 0;
+static const byte_t IndexTag_forward = 1;
+
+static size_t index_prefix(byte_t *k, ClassId classId, PropertyId propertyId, byte_t tag)
+{
+  *(ClassId *)k = classId;
+  *(PropertyId *)(k+ClassId_sz) = propertyId;
+  k[ClassId_sz+PropertyId_sz] = tag;
+  return IndexPrefix_sz;
+}
+
+static size_t index_trailer(byte_t *k, const ObjectKey &key)
+{
+  write_integer<ClassId_sz>(k, key.classId);
+  write_integer<ObjectId_sz>(k+ClassId_sz, key.objectId);
+  return IndexTrailer_sz;
+}
+
+/**
+ * secondary index cursor backend. Iterates over the objects referenced by a range of forward index entries
+ */
+class IndexCursorHelper : public lo::persistence::kv::CursorHelper
+{
+  ::lmdb::txn &m_txn;
+  ::lmdb::dbi &m_dbi;
+  TransactionStats &m_stats;
+
+  ::lmdb::cursor m_cursor;
+  ::lmdb::val m_keyval;
+
+  byte_t m_lower[IndexKey_maxsz], m_upper[IndexValue_maxsz], m_current[IndexKey_maxsz];
+  size_t m_lowerSize, m_upperSize, m_currentSize = 0;
+
+  /**
+   * check whether the cursor is positioned on an entry inside the range, and make it current
+   */
+  bool current()
+  {
+    byte_t *k = m_keyval.data<byte_t>();
+    size_t ksz = m_keyval.size();
+
+    if(ksz < IndexPrefix_sz + IndexTrailer_sz || memcmp(k, m_lower, IndexPrefix_sz)) return false;
+
+    size_t vsz = ksz - IndexPrefix_sz - IndexTrailer_sz;
+    int c = memcmp(k + IndexPrefix_sz, m_upper, min(vsz, m_upperSize));
+    if(c > 0 || (c == 0 && vsz > m_upperSize)) return false;
+
+    memcpy(m_current, k, ksz);
+    m_currentSize = ksz;
+
+    byte_t *trailer = k + ksz - IndexTrailer_sz;
+    m_currentClassId = read_integer<ClassId, ClassId_sz>(trailer);
+    m_currentObjectId = read_integer<ObjectId, ObjectId_sz>(trailer+ClassId_sz);
+    return true;
+  }
+
+protected:
+  bool start() override
+  {
+    m_stats.cursorSteps++;
+    m_keyval.assign(m_lower, m_lowerSize);
+    return m_cursor.get(m_keyval, MDB_SET_RANGE) && current();
+  }
+
+  bool next() override
+  {
+    m_stats.cursorSteps++;
+    return m_cursor.get(m_keyval, MDB_NEXT) && current();
+  }
+
+  bool erase() override
+  {
+    //the index entries were removed by the caller. Remove the object data and move to the entry after the current one
+    auto data = ::lmdb::cursor::open(m_txn, m_dbi);
+    SK_CONSTR(sk, m_currentClassId, m_currentObjectId, 0);
+    ::lmdb::val dataKey {sk, sizeof(sk)};
+
+    bool gotten = data.get(dataKey, MDB_SET_RANGE);
+    while(gotten && SK_CLASSID(dataKey.data<byte_t>()) == m_currentClassId &&
+          SK_OBJID(dataKey.data<byte_t>()) == m_currentObjectId) {
+      data.del();
+      m_stats.removes++;
+      gotten = data.get(dataKey, MDB_NEXT);
+    }
+    data.close();
+
+    m_stats.cursorSteps++;
+    m_keyval.assign(m_current, m_currentSize);
+    if(!m_cursor.get(m_keyval, MDB_SET_RANGE)) return false;
+    if(m_keyval.size() == m_currentSize && !memcmp(m_keyval.data(), m_current, m_currentSize)) return next();
+    return current();
+  }
+
+  void close() override {
+    m_cursor.close();
+  }
+
+  void get(ObjectKey &key, ReadBuf &rb) override
+  {
+    SK_CONSTR(sk, m_currentClassId, m_currentObjectId, 0);
+    ::lmdb::val keyval {sk, sizeof(sk)};
+    ::lmdb::val dataval {};
+
+    if(m_dbi.get(m_txn, keyval, dataval)) {
+      key.classId = m_currentClassId;
+      key.objectId = m_currentObjectId;
+      rb.start(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
+    }
+  }
+
+  void getObjectData(ObjectBuf &buf) override
+  {
+    SK_CONSTR(sk, m_currentClassId, m_currentObjectId, 0);
+    ::lmdb::val keyval {sk, sizeof(sk)};
+    ::lmdb::val dataval {};
+
+    if(m_dbi.get(m_txn, keyval, dataval)) {
+      buf.key.classId = m_currentClassId;
+      buf.key.objectId = m_currentObjectId;
+      buf.start(dataval.data<byte_t>(), dataval.size());
+
+      m_stats.reads++;
+      m_stats.bytesRead += dataval.size();
+    }
+  }
+
+public:
+  IndexCursorHelper(::lmdb::txn &txn, ::lmdb::dbi &dbi, ::lmdb::dbi &indexDbi, TransactionStats &stats,
+                    ClassId classId, PropertyId propertyId,
+                    const byte_t *lower, size_t lowerSize, const byte_t *upper, size_t upperSize)
+      : m_txn(txn), m_dbi(dbi), m_stats(stats), m_cursor(::lmdb::cursor::open(txn, indexDbi)), m_upperSize(upperSize)
+  {
+    m_lowerSize = index_prefix(m_lower, classId, propertyId, IndexTag_forward);
+    memcpy(m_lower + m_lowerSize, lower, lowerSize);
+    m_lowerSize += lowerSize;
+    memcpy(m_upper, upper, upperSize);
+  }
+  ~IndexCursorHelper() {m_cursor.close();}
+};
+
+class KeyValueStoreImpl;
+
 /**
  * LMDB-based Transaction
  */
@@ -447,6 +733,8 @@ class Transaction
     : public lo::persistence::kv::WriteTransaction,
       public lo::persistence::kv::ExclusiveReadTransaction
 {
+  friend class KeyValueStoreImpl;
+
 public:
   enum class Mode {read, write};
 
@@ -454,54 +742,263 @@ private:
   const ::lmdb::env &m_env;
 
   ::lmdb::txn m_txn;
+  //enclosing transactions while savepoints are active. m_txn is always the innermost
+  std::vector<::lmdb::txn> m_parents;
   ::lmdb::dbi &m_dbi;
+  ::lmdb::dbi &m_dbi_index;
 
   Mode m_mode;
   bool m_closed = false;
 
+  //property and refcount values held back in bulk load mode, so that they can be appended after the object key
+  struct DeferredValue {
+    ClassId classId;
+    ObjectId objectId;
+    PropertyId propertyId;
+    vector<byte_t> data;
+
+    bool operator < (const DeferredValue &other) const {
+      if(classId != other.classId) return classId < other.classId;
+      if(objectId != other.objectId) return objectId < other.objectId;
+      return propertyId < other.propertyId;
+    }
+  };
+  vector<DeferredValue> m_deferred;
+  const bool m_pooled;
+  const Readahead m_readahead;
+
 protected:
   bool putData(ClassId classId, ObjectId objectId, PropertyId propertyId, WriteBuf &buf) override;
   bool putData(ObjectKey &key, WriteBuf &buf) override;
   bool allocData(ClassId classId, ObjectId objectId, PropertyId propertyId, size_t size, byte_t **data) override;
   void getData(ReadBuf &buf, ClassId classId, ObjectId objectId, PropertyId propertyId) override;
   void getData(ReadBuf &buf, ObjectKey &key, bool getRefount) override;
+  void getData(ReadBuf *bufs, ObjectKey *keys, size_t count, bool getRefcount) override;
   bool remove(ClassId classId, ObjectId objectId) override;
   bool remove(ClassId classId, ObjectId objectId, PropertyId propertyId) override;
   void clearRefCounts(vector<ClassId> classes) override;
 
-  ClassCursorHelper * _openCursor(const vector<ClassId> &classId) override;
+  void putIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key, const byte_t *value, size_t size) override;
+  void removeIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key) override;
+  void clearIndex(ClassId classId, PropertyId propertyId) override;
+
+  ClassCursorHelper * _openCursor(const vector<ClassId> &classId, ObjectId startId, ObjectId endId) override;
   CollectionCursorHelper * _openCursor(ClassId classId, ObjectId collectionId) override;
   VectorCursorHelper * _openCursor(ClassId classId, ObjectId objectId, PropertyId propertyId) override;
+  IndexCursorHelper * _openIndexCursor(ClassId classId, PropertyId propertyId,
+                                       const byte_t *lower, size_t lowerSize, const byte_t *upper, size_t upperSize) override;
 
   bool _getCollectionData(CollectionInfo *info, size_t startIndex, size_t length, size_t elementSize,
                           void **data, bool *owned) override;
 
   bool lastChunk(ObjectId collectionId, PropertyId &chunkId, ::lmdb::val &data);
+
+  /**
+   * @return the data of a collection chunk, including the header, or nullptr if not found
+   * @param decoded (out) if the chunk was compressed, the decompressed chunk from the chunk cache. The returned
+   * data stays valid as long as this reference is held
+   */
+  const byte_t *getChunk(ObjectId collectionId, PropertyId chunkId, ChunkCache::Buffer &decoded);
   ChunkCursor::Ptr _openChunkCursor(ClassId classId, ObjectId objectId, bool atEnd) override;
 
   uint16_t decrementRefCount(ClassId cid, ObjectId oid) override;
 
+  /**
+   * put a value into the given database. With MDB_APPEND, a key that does not sort after the last key in the
+   * database is written normally and counted in TransactionStats::appendFallbacks
+   * @return false if the key existed and MDB_NOOVERWRITE was given
+   * @throw store_full_error if the map is full
+   */
+  bool put(MDB_dbi dbi, MDB_val *key, MDB_val *val, unsigned flags);
+
+  /**
+   * report that the map is full. The store grows before the next write transaction
+   * @throw store_full_error
+   */
+  [[noreturn]] void mapFull();
+
+  /**
+   * write all deferred values in key order
+   */
+  void flushDeferred();
+
+  /**
+   * write the deferred values of the given object in key order. Called after the object key was written
+   */
+  void flushDeferred(ClassId classId, ObjectId objectId);
+
+  /**
+   * write the deferred values in [begin, end) in key order
+   */
+  void writeDeferred(vector<DeferredValue>::iterator begin, vector<DeferredValue>::iterator end);
+
+  void doSavepoint() override;
+  void doRollback() override;
+  void doRelease() override;
+
+  /**
+   * abort all nested transactions, leaving m_txn at the outermost one
+   */
+  void abortNested();
+
 public:
-  Transaction(KeyValueStore &store, Mode mode, ::lmdb::env &env, ::lmdb::dbi &dbi, bool blockWrites=false)
+  Transaction(KeyValueStore &store, Mode mode, ::lmdb::env &env, ::lmdb::dbi &dbi, ::lmdb::dbi &indexDbi,
+              const Readahead &readahead, bool blockWrites=false, bool pooled=false, bool append=false)
       : lo::persistence::kv::Transaction(store),
-        lo::persistence::kv::WriteTransaction(store, false),
+        lo::persistence::kv::WriteTransaction(store, append),
         lo::persistence::kv::ExclusiveReadTransaction(store),
-        m_mode(mode),
         m_env(env),
+        m_txn(::lmdb::txn::begin(env, nullptr, mode == Mode::read ? MDB_RDONLY : 0)),
         m_dbi(dbi),
-        m_txn(::lmdb::txn::begin(env, nullptr, mode == Mode::read ? MDB_RDONLY : 0))
+        m_dbi_index(indexDbi),
+        m_mode(mode),
+        m_pooled(pooled),
+        m_readahead(readahead)
   {
     setBlockWrites(blockWrites);
   }
 
+  ~Transaction() {
+    abortNested();
+  }
+
   bool isClosed() {return m_closed;}
 
+  /**
+   * @return the id of the snapshot seen by this (read) transaction
+   */
+  size_t snapshotId() {return mdb_txn_id(m_txn);}
+
+  /**
+   * move this read transaction to the latest snapshot
+   */
+  void refresh() {
+    m_chunkCache.clear();
+    m_txn.reset();
+    m_txn.renew();
+  }
+
+  /**
+   * reactivate a pooled read transaction that was closed (i.e., reset) previously
+   */
+  void reuse(bool blockWrites) {
+    m_txn.renew();
+    m_closed = false;
+    m_stats = TransactionStats();
+    setBlockWrites(blockWrites);
+  }
+
+  /**
+   * close the transaction if the application hasn't done so
+   * @return true if the transaction may be put back into the read pool
+   */
+  bool recycle() {
+    if(!m_closed) _abort();
+    return m_pooled;
+  }
+
+  /**
+   * release the LMDB handle because the store is going away. Only deleting the transaction is allowed afterwards
+   */
+  void detach() {
+    if(!m_closed) _abort();
+    m_txn.abort();
+  }
+
+  /**
+   * commit the LMDB transaction
+   * @param synced (optional) fulfilled when the commit is durable
+   */
+  void commitTxn(promise<void> *synced);
+
   void doCommit() override;
+  future<void> doCommitAsync() override;
   void doAbort() override;
   void doReset() override;
   void doRenew() override;
 };
 
+/**
+ * background thread that syncs the environment for the relaxed durability modes. A sync happens when the interval
+ * has elapsed or the byte budget is used up, and fulfills the promises of all commits made before it
+ */
+class SyncThread
+{
+  const ::lmdb::env &m_env;
+  const chrono::milliseconds m_interval;
+  const size_t m_budget;
+
+  mutex m_mutex;
+  condition_variable m_cond;
+  vector<promise<void>> m_waiting;
+  size_t m_unsynced = 0;
+  bool m_dirty = false;
+  bool m_stop = false;
+  thread m_thread;
+
+  void loop();
+  void sync(unique_lock<mutex> &lock);
+
+  /**
+   * @return true if a sync is due before the interval has elapsed: when the byte budget is used up, or after each
+   * commit if neither interval nor budget are set
+   */
+  bool due() const;
+
+public:
+  SyncThread(const ::lmdb::env &env, unsigned intervalMs, size_t budget);
+
+  /**
+   * sync outstanding commits and stop the thread
+   */
+  ~SyncThread();
+
+  /**
+   * account for a commit
+   * @param bytes the number of bytes written by the commit
+   * @param synced (optional) fulfilled after the next sync
+   */
+  void committed(size_t bytes, promise<void> *synced);
+};
+
+/**
+ * the read transactions handed out by a store. Shared with the transaction deleters, which may run after the
+ * store was deleted
+ */
+struct ReadState
+{
+  mutex lock;
+  const unsigned poolSize;
+
+  //reset read transactions waiting to be renewed
+  vector<Transaction *> pool;
+
+  //read transactions in use by the application
+  unordered_set<Transaction *> active;
+
+  //set when the store is deleted. Remaining transactions have been detached
+  bool closed = false;
+
+  //set while the store is compacted. No transactions can be started
+  bool compacting = false;
+
+  //read and write transactions being started. Compaction is refused while this is not 0
+  unsigned starting = 0;
+
+  ReadState(unsigned poolSize) : poolSize(poolSize) {}
+
+  /**
+   * account for a transaction being started
+   * @throw invalid_argument if the store is being compacted
+   */
+  void start();
+
+  /**
+   * return a transaction handed out by the store, or delete it if the store is gone
+   */
+  static void release(const weak_ptr<ReadState> &state, Transaction *txn);
+};
+
 /**
  * LMDB-based KeyValueStore implementation
  */
@@ -510,6 +1007,7 @@ class KeyValueStoreImpl : public KeyValueStore
   ::lmdb::env m_env;
   ::lmdb::dbi m_dbi_meta = 0;
   ::lmdb::dbi m_dbi_data = 0;
+  ::lmdb::dbi m_dbi_index = 0;
 
   unsigned m_flags;
   weak_ptr<Transaction> writeTxn;
@@ -521,9 +1019,51 @@ class KeyValueStoreImpl : public KeyValueStore
   unsigned m_maxKeySize;
   unsigned m_writeBlocks = 0;
 
+  shared_ptr<ReadState> m_reads;
+
+  //id counters as last read from the database (multi-process mode)
+  unordered_map<ClassId, ObjectId> m_savedIds;
+
+  //background sync for the relaxed durability modes
+  unique_ptr<SyncThread> m_syncer;
+
+  //space a write transaction was missing when the map became full. Added on the next growth
+  size_t m_missingSpace = 0;
+
+  //held during commits, so that beginSnapshotReads can open its transactions without a commit in between
+  mutex m_commitMutex;
+
+  /**
+   * @return the map size that provides at least the required bytes according to the growth policy
+   * @throw store_full_error if the required size exceeds the configured maximum
+   */
+  size_t grownMapSize(size_t required);
+
+  /**
+   * @return a read transaction from the pool or a new one, registered as active
+   * @throw invalid_argument if the store is being compacted
+   */
+  Transaction *acquireRead(bool blockWrites);
+
+  /**
+   * @return a read transaction from the pool or a new one
+   */
+  Transaction *openRead(bool blockWrites);
+
+  /**
+   * @return a deleter that hands the read transaction back to the store
+   */
+  function<void(kv::ReadTransaction *)> readDeleter(Transaction *txn);
+
+  /**
+   * delete the pooled read transactions
+   */
+  void clearReadPool();
+
   PropertyMetaInfoPtr make_propertyinfo(MDB_val *mdbVal);
   MDB_val make_propertyval(const PropertyAccessBase *prop);
   ObjectId findMaxObjectId(::lmdb::txn &txn, ClassId classId);
+  ClassId findMaxClassId(::lmdb::txn &txn);
 
 protected:
   void loadSaveClassMeta(
@@ -537,6 +1077,26 @@ protected:
 
   void checkAvailableSpace(unsigned needsKBs);
 
+  void openEnv();
+
+  /**
+   * adopt a map size that was increased by another process
+   */
+  void adoptMapSize();
+
+  Transaction *newTransaction(Transaction::Mode mode, bool blockWrites=false, bool pooled=false, bool append=false);
+
+  /**
+   * start the write transaction
+   * @param append use the append path (bulk load)
+   */
+  WriteTransactionPtr startWrite(unsigned needsKBs, bool append);
+
+  /**
+   * open a write transaction without checking for running transactions or compaction
+   */
+  shared_ptr<Transaction> openWrite(unsigned needsKBs, bool append);
+
 public:
   KeyValueStoreImpl(StoreId storeId, string location, string name, Options options);
   ~KeyValueStoreImpl();
@@ -544,8 +1104,43 @@ public:
   ReadTransactionPtr beginRead() override;
   ExclusiveReadTransactionPtr beginExclusiveRead() override;
   WriteTransactionPtr beginWrite(unsigned needsKBs) override;
+  WriteTransactionPtr beginBulkLoad(unsigned needsKBs) override;
+  vector<ReadTransactionPtr> beginSnapshotReads(unsigned count) override;
+  CompactStats compact(const string &targetPath) override;
+
+  /**
+   * rewrite the chunks of all top-level collections densely
+   * @return the number of chunks rewritten
+   */
+  size_t packCollections();
 
   void transactionCompleted(Transaction::Mode mode, bool blockWrites);
+
+  /**
+   * raise the in-memory id counters to the values saved by other processes
+   */
+  void loadIdCounters(::lmdb::txn &txn);
+
+  /**
+   * save the id counters that were advanced by the current write transaction
+   */
+  void saveIdCounters(::lmdb::txn &txn);
+
+  /**
+   * account for a commit. In the relaxed durability modes it is handed to the background sync
+   * @param synced (optional) fulfilled when the commit is durable
+   */
+  void committed(size_t bytes, promise<void> *synced);
+
+  /**
+   * account for a write transaction that ran out of space. The map grows before the next write transaction
+   * @param bytesWritten the bytes written by the transaction so far
+   */
+  void noteMapFull(size_t bytesWritten);
+
+  mutex &commitMutex() {return m_commitMutex;}
+
+  bool multiProcess() const {return m_options.multiProcess;}
   size_t getOptimalChunkSize(size_t reserved) override {return m_pageSize - reserved;};
 };
 
@@ -575,22 +1170,46 @@ int meta_dup_compare(const MDB_val *a, const MDB_val *b)
 
 KeyValueStoreImpl::KeyValueStoreImpl(StoreId storeId, string location, string name, Options options)
     : KeyValueStore(storeId),
-      m_env(::lmdb::env::create()), m_options(options), m_curMapSize(options.initialMapSizeMB * size_t(1024) * size_t(1024))
+      m_env(::lmdb::env::create()), m_options(options), m_curMapSize(options.initialMapSizeMB * size_t(1024) * size_t(1024)),
+      m_reads(make_shared<ReadState>(options.readPoolSize))
 {
   m_dbpath = location;
   if(m_dbpath.back() != separator_char) m_dbpath += separator_char;
   m_dbpath += (name.empty() ? "kvdata" : name);
 
+  openEnv();
+}
+
+void KeyValueStoreImpl::openEnv()
+{
   //don't need to worry for existing files. LMDB will increase to committed size if neeed
   m_env.set_mapsize(m_curMapSize);
 
-  //classmeta + classdata db
-  m_env.set_max_dbs(2);
+  //classmeta + classdata + classindex db
+  m_env.set_max_dbs(3);
   m_flags = MDB_NOSUBDIR;
 
-  if(!m_options.lockFile) m_flags |= MDB_NOLOCK;
+  if(!m_options.lockFile && !m_options.multiProcess) m_flags |= MDB_NOLOCK;
   if(m_options.writeMap) m_flags |= MDB_WRITEMAP;
 
+  switch(m_options.durability) {
+    case Durability::noMetaSync:
+      m_flags |= MDB_NOMETASYNC;
+      break;
+    case Durability::mapAsync:
+      m_flags |= MDB_MAPASYNC;
+      break;
+    case Durability::noSync:
+      m_flags |= MDB_NOSYNC;
+      break;
+    default:
+      break;
+  }
+
+  //pooled read transactions may be renewed on a different thread, and snapshot reads open several read
+  //transactions on the calling thread
+  m_flags |= MDB_NOTLS;
+
   try {
     m_env.open(m_dbpath.c_str(), m_flags, 0664);
   }
@@ -613,35 +1232,56 @@ KeyValueStoreImpl::KeyValueStoreImpl(StoreId storeId, string location, string na
   m_dbi_meta = ::lmdb::dbi::open(txn, CLASSMETA, MDB_DUPSORT | MDB_CREATE);
   m_dbi_meta.set_dupsort(txn, meta_dup_compare);
 
-  //find the maximum classId
-  ::lmdb::val key, val;
-
-  key.assign((byte_t *)0, 0);
-  val.assign((byte_t *)0, 0);
-  auto cursor = ::lmdb::cursor::open(txn, m_dbi_meta);
-  while (cursor.get(key, val, MDB_NEXT_NODUP)) {
-    ClassId cid = read_integer<ClassId>(val.data<byte_t>()+2, 2);
-    if(cid > m_maxClassId) m_maxClassId = cid;
-  }
-  cursor.close();
+  m_maxClassId = findMaxClassId(txn);
 
   //open/create the classdata database
   m_dbi_data = ::lmdb::dbi::open(txn, CLASSDATA, MDB_CREATE);
   m_dbi_data.set_compare(txn, key_compare);
 
+  //the store format is recorded when the store is created. Stores without a record predate the format choice
+  SK_CONSTR(fk, STOREINFO_CLSID, 0, 0);
+  ::lmdb::val formatKey {fk, sizeof(fk)};
+  ::lmdb::val formatVal {};
+  if(m_dbi_data.get(txn, formatKey, formatVal))
+    m_format = static_cast<StoreFormat>(*formatVal.data<byte_t>());
+  else if(!m_dbi_data.size(txn)) {
+    m_format = m_options.format;
+    formatVal.assign(&m_format, sizeof(m_format));
+    m_dbi_data.put(txn, formatKey, formatVal);
+  }
+
+  //open/create the secondary index database
+  m_dbi_index = ::lmdb::dbi::open(txn, CLASSINDEX, MDB_CREATE);
+
   m_maxCollectionId = findMaxObjectId(txn, COLLECTION_CLSID);
 
   txn.commit();
+
+  if(m_options.durability != Durability::full)
+    m_syncer.reset(new SyncThread(m_env, m_options.syncIntervalMs, m_options.syncBytes));
 }
 
 KeyValueStoreImpl::~KeyValueStoreImpl()
 {
-  MDB_envinfo envinfo;
-  mdb_env_info(m_env, &envinfo);
+  {
+    //transactions still held by the application lose their handles. Their deleters only delete them
+    lock_guard<mutex> lock(m_reads->lock);
+    for(auto txn : m_reads->active) txn->detach();
+    m_reads->active.clear();
+    m_reads->closed = true;
+  }
+  clearReadPool();
+  m_syncer.reset();
 
-  //truncate the file
-  size_t datasize = m_pageSize * (envinfo.me_last_pgno + 1);
-  m_env.set_mapsize(datasize);
+  //other processes may still be using the map
+  if(!m_options.multiProcess) {
+    MDB_envinfo envinfo;
+    mdb_env_info(m_env, &envinfo);
+
+    //truncate the file
+    size_t datasize = m_pageSize * (envinfo.me_last_pgno + 1);
+    m_env.set_mapsize(datasize);
+  }
 
   m_env.close();
 }
@@ -655,20 +1295,161 @@ void KeyValueStoreImpl::checkAvailableSpace(unsigned needsKBs)
   if(!needsKBs || needsKBs < m_options.minTransactionSpaceKB) needsKBs = m_options.minTransactionSpaceKB;
 
   size_t cursize = m_pageSize * (envinfo.me_last_pgno + 1);
-  if(cursize + needsKBs * 1024 > m_curMapSize) {
-    m_curMapSize += m_options.increaseMapSizeKB * 1024;
+  size_t required = cursize + needsKBs * size_t(1024);
+
+  //the last write transaction ran out of space
+  if(m_missingSpace) {
+    required = max(required, m_curMapSize + m_missingSpace);
+    m_missingSpace = 0;
+  }
+  if(required > m_curMapSize) {
+    m_curMapSize = grownMapSize(required);
     m_env.set_mapsize(m_curMapSize);
+    mapResized();
   }
 }
 
+size_t KeyValueStoreImpl::grownMapSize(size_t required)
+{
+  size_t maxSize = m_options.maxMapSizeMB * size_t(1024) * size_t(1024);
+  if(maxSize && required > maxSize) throw store_full_error("map size limit reached");
+
+  size_t size = m_curMapSize;
+  while(size < required) {
+    size_t step = size / 100 * m_options.mapGrowthPercent;
+    if(step < m_options.increaseMapSizeKB * size_t(1024)) step = m_options.increaseMapSizeKB * size_t(1024);
+    size += step;
+  }
+  //round to whole pages
+  size = (size + m_pageSize - 1) / m_pageSize * m_pageSize;
+
+  return maxSize && size > maxSize ? maxSize : size;
+}
+
+void KeyValueStoreImpl::noteMapFull(size_t bytesWritten)
+{
+  //the transaction will likely write as much again when replayed
+  size_t missing = max(bytesWritten * 2, m_options.minTransactionSpaceKB * size_t(1024));
+  if(missing > m_missingSpace) m_missingSpace = missing;
+  mapFull();
+}
+
 void KeyValueStoreImpl::transactionCompleted(Transaction::Mode mode, bool blockWrites)
 {
   if(blockWrites) m_writeBlocks--;
+  if(blockWrites || mode == Transaction::Mode::write) writeEnded();
+}
+
+void ReadState::start()
+{
+  lock_guard<mutex> guard(lock);
+  if(compacting) throw invalid_argument("the store is being compacted");
+  starting++;
+}
+
+Transaction *KeyValueStoreImpl::acquireRead(bool blockWrites)
+{
+  m_reads->start();
+
+  Transaction *txn = nullptr;
+  try {
+    txn = openRead(blockWrites);
+  }
+  catch(...) {
+    lock_guard<mutex> lock(m_reads->lock);
+    m_reads->starting--;
+    throw;
+  }
+  lock_guard<mutex> lock(m_reads->lock);
+  m_reads->starting--;
+  m_reads->active.insert(txn);
+  return txn;
+}
+
+Transaction *KeyValueStoreImpl::openRead(bool blockWrites)
+{
+  Transaction *txn = nullptr;
+  if(m_options.readPoolSize) {
+    {
+      lock_guard<mutex> lock(m_reads->lock);
+      if(!m_reads->pool.empty()) {
+        txn = m_reads->pool.back();
+        m_reads->pool.pop_back();
+      }
+    }
+    if(txn) {
+      try {
+        txn->reuse(blockWrites);
+      }
+      catch(::lmdb::error &err) {
+        delete txn;
+        txn = nullptr;
+      }
+    }
+  }
+  if(!txn) txn = newTransaction(Transaction::Mode::read, blockWrites, m_options.readPoolSize > 0);
+  return txn;
+}
+
+function<void(kv::ReadTransaction *)> KeyValueStoreImpl::readDeleter(Transaction *txn)
+{
+  weak_ptr<ReadState> state = m_reads;
+  return [state, txn](kv::ReadTransaction *) {ReadState::release(state, txn);};
+}
+
+void KeyValueStoreImpl::clearReadPool()
+{
+  lock_guard<mutex> lock(m_reads->lock);
+  for(auto txn : m_reads->pool) delete txn;
+  m_reads->pool.clear();
+}
+
+Transaction *KeyValueStoreImpl::newTransaction(Transaction::Mode mode, bool blockWrites, bool pooled, bool append)
+{
+  try {
+    return new Transaction(*this, mode, m_env, m_dbi_data, m_dbi_index,
+                           Readahead(m_pageSize, m_options.readahead), blockWrites, pooled, append);
+  }
+  catch(::lmdb::runtime_error &err) {
+    if(err.code() != MDB_MAP_RESIZED) throw;
+  }
+  //another process has grown the map
+  adoptMapSize();
+  return new Transaction(*this, mode, m_env, m_dbi_data, m_dbi_index,
+                         Readahead(m_pageSize, m_options.readahead), blockWrites, pooled, append);
+}
+
+void KeyValueStoreImpl::adoptMapSize()
+{
+  m_env.set_mapsize(0);
+
+  MDB_envinfo envinfo;
+  mdb_env_info(m_env, &envinfo);
+  m_curMapSize = envinfo.me_mapsize;
+  mapResized();
+}
+
+void ReadState::release(const weak_ptr<ReadState> &state, Transaction *txn)
+{
+  shared_ptr<ReadState> rs = state.lock();
+  if(rs) {
+    lock_guard<mutex> lock(rs->lock);
+    if(!rs->closed) {
+      rs->active.erase(txn);
+      if(txn->recycle() && rs->pool.size() < rs->poolSize) {
+        rs->pool.push_back(txn);
+        return;
+      }
+    }
+  }
+  //the store is gone and has detached the transaction
+  delete txn;
 }
 
 ReadTransactionPtr KeyValueStoreImpl::beginRead()
 {
-  return ReadTransactionPtr(new Transaction(*this, Transaction::Mode::read, m_env, m_dbi_data, false));
+  Transaction *txn = acquireRead(false);
+  return ReadTransactionPtr(txn, readDeleter(txn));
 }
 
 ExclusiveReadTransactionPtr KeyValueStoreImpl::beginExclusiveRead()
@@ -677,10 +1458,264 @@ ExclusiveReadTransactionPtr KeyValueStoreImpl::beginExclusiveRead()
   if(wtr && !wtr->isClosed()) throw invalid_argument("a write transaction is already running");
   m_writeBlocks++;
 
-  return ExclusiveReadTransactionPtr(new Transaction(*this, Transaction::Mode::read, m_env, m_dbi_data, true));
+  Transaction *txn;
+  try {
+    txn = acquireRead(true);
+  }
+  catch(...) {
+    m_writeBlocks--;
+    throw;
+  }
+  return ExclusiveReadTransactionPtr(txn, readDeleter(txn));
+}
+
+vector<ReadTransactionPtr> KeyValueStoreImpl::beginSnapshotReads(unsigned count)
+{
+  vector<Transaction *> txns;
+  vector<ReadTransactionPtr> result;
+  {
+    //no commit from this process can land while the transactions are opened
+    lock_guard<mutex> lock(m_commitMutex);
+    for(unsigned i=0; i<count; i++) {
+      Transaction *txn = acquireRead(false);
+      txns.push_back(txn);
+      result.push_back(ReadTransactionPtr(txn, readDeleter(txn)));
+    }
+  }
+
+  //in multi-process mode, another process may have committed in between. Catch up a limited number of times
+  for(unsigned attempt=0; attempt < 100; attempt++) {
+    size_t latest = 0;
+    for(auto txn : txns) if(txn->snapshotId() > latest) latest = txn->snapshotId();
+
+    bool same = true;
+    for(auto txn : txns) {
+      if(txn->snapshotId() != latest) {
+        txn->refresh();
+        same = false;
+      }
+    }
+    if(same) return result;
+  }
+  throw error("beginSnapshotReads: could not align snapshots with concurrent commits");
+}
+
+static size_t file_size(const string &path)
+{
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+//atomically replace target with source
+static bool replace_file(const string &source, const string &target)
+{
+#ifdef _WIN32
+  return MoveFileExA(source.c_str(), target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+  return rename(source.c_str(), target.c_str()) == 0;
+#endif
+}
+
+//drop a transaction handle that LMDB has already released, e.g. after a failed commit. lmdb++ would abort it again
+static void discard(::lmdb::txn &txn)
+{
+  new (&txn) ::lmdb::txn(nullptr);
+}
+
+size_t KeyValueStoreImpl::packCollections()
+{
+  size_t rewritten = 0;
+  //compact has made sure that no other transaction is running
+  WriteTransactionPtr wtxn = openWrite(0, false);
+  for(ObjectId collectionId=1; collectionId <= m_maxCollectionId; collectionId++)
+    rewritten += wtxn->packCollection(collectionId);
+  wtxn->commit();
+  return rewritten;
+}
+
+//write a compacted copy of the environment to path, replacing an existing file
+static void copy_compacted(::lmdb::env &env, const string &path)
+{
+  remove(path.c_str());
+  try {
+    ::lmdb::env_copy(env, path.c_str(), MDB_CP_COMPACT);
+  }
+  catch(::lmdb::error &err) {
+    remove(path.c_str());
+    throw error("compact: error writing copy", err.what());
+  }
+}
+
+CompactStats KeyValueStoreImpl::compact(const string &targetPath)
+{
+  //other processes would keep working on the replaced file
+  if(targetPath.empty() && m_options.multiProcess)
+    throw error("compact: a multi-process store can only be compacted into a target file");
+  {
+    //no transaction can be started until compaction is finished
+    lock_guard<mutex> lock(m_reads->lock);
+    if(m_reads->compacting) throw error("compact: the store is already being compacted");
+    if(m_writeBlocks) throw error("compact: a transaction is running");
+    shared_ptr<Transaction> wtr = writeTxn.lock();
+    if(wtr && !wtr->isClosed()) throw error("compact: a write transaction is running");
+    if(!m_reads->active.empty() || m_reads->starting) throw error("compact: a read transaction is running");
+    m_reads->compacting = true;
+  }
+  struct Compacting {
+    ReadState &reads;
+    ~Compacting() {
+      lock_guard<mutex> lock(reads.lock);
+      reads.compacting = false;
+    }
+  } compacting {*m_reads};
+
+  auto start = chrono::steady_clock::now();
+
+  CompactStats stats;
+  stats.sizeBefore = file_size(m_dbpath);
+
+  //LMDB does not write the copy in place, so we go through a temporary file which is then moved over the target
+  string target = targetPath.empty() ? m_dbpath : targetPath;
+  string tmpPath = target + ".compact";
+
+  if(targetPath.empty()) {
+    //rewrite sparse collection chunks, then copy
+    stats.chunksRewritten = packCollections();
+    copy_compacted(m_env, tmpPath);
+    stats.sizeAfter = file_size(tmpPath);
+
+    //the environment must be closed before its file is replaced
+    clearReadPool();
+    m_syncer.reset();
+    m_env.close();
+
+    bool replaced = replace_file(tmpPath, m_dbpath);
+    if(!replaced) remove(tmpPath.c_str());
+
+    m_env = ::lmdb::env::create();
+    openEnv();
+
+    if(!replaced) throw error("compact: could not replace database file", m_dbpath);
+  }
+  else {
+    //the source stays untouched. Chunks are packed in an intermediate copy
+    string packPath = target + ".pack";
+    copy_compacted(m_env, packPath);
+    try {
+      size_t sep = packPath.find_last_of(separator_char);
+      string location = sep == string::npos ? string(".") : packPath.substr(0, sep);
+      string name = sep == string::npos ? packPath : packPath.substr(sep + 1);
+
+      KeyValueStoreImpl packer(id, location, name, m_options);
+      stats.chunksRewritten = packer.packCollections();
+      copy_compacted(packer.m_env, tmpPath);
+    }
+    catch(...) {
+      remove(packPath.c_str());
+      remove((packPath + "-lock").c_str());
+      throw;
+    }
+    remove(packPath.c_str());
+    remove((packPath + "-lock").c_str());
+    stats.sizeAfter = file_size(tmpPath);
+
+    if(!replace_file(tmpPath, target)) {
+      remove(tmpPath.c_str());
+      throw error("compact: could not replace file", target);
+    }
+  }
+
+  stats.duration = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+  return stats;
+}
+
+void KeyValueStoreImpl::committed(size_t bytes, promise<void> *synced)
+{
+  if(m_syncer) m_syncer->committed(bytes, synced);
+  else if(synced) synced->set_value();
+}
+
+SyncThread::SyncThread(const ::lmdb::env &env, unsigned intervalMs, size_t budget)
+    : m_env(env), m_interval(intervalMs), m_budget(budget)
+{
+  m_thread = thread(&SyncThread::loop, this);
+}
+
+SyncThread::~SyncThread()
+{
+  {
+    lock_guard<mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cond.notify_one();
+  if(m_thread.joinable()) m_thread.join();
+}
+
+void SyncThread::committed(size_t bytes, promise<void> *synced)
+{
+  lock_guard<mutex> lock(m_mutex);
+  m_dirty = true;
+  m_unsynced += bytes;
+  if(synced) m_waiting.push_back(move(*synced));
+
+  if(due()) m_cond.notify_one();
+}
+
+bool SyncThread::due() const
+{
+  if(m_budget) return m_unsynced >= m_budget;
+  return !m_interval.count() && m_dirty;
+}
+
+void SyncThread::loop()
+{
+  unique_lock<mutex> lock(m_mutex);
+  auto ready = [this] {return m_stop || due();};
+
+  while(!m_stop) {
+    if(m_interval.count()) m_cond.wait_for(lock, m_interval, ready);
+    else m_cond.wait(lock, ready);
+
+    if(m_dirty) sync(lock);
+  }
+  //outstanding commits are synced before the environment is closed
+  if(m_dirty) sync(lock);
+}
+
+void SyncThread::sync(unique_lock<mutex> &lock)
+{
+  vector<promise<void>> waiting;
+  waiting.swap(m_waiting);
+  m_unsynced = 0;
+  m_dirty = false;
+
+  //commits may continue while we sync
+  lock.unlock();
+  exception_ptr ex;
+  try {
+    ::lmdb::env_sync(m_env, true);
+  }
+  catch(::lmdb::error &err) {
+    ex = make_exception_ptr(error("sync failed", err.what()));
+  }
+  for(auto &synced : waiting) {
+    if(ex) synced.set_exception(ex);
+    else synced.set_value();
+  }
+  lock.lock();
 }
 
 WriteTransactionPtr KeyValueStoreImpl::beginWrite(unsigned needsKBs)
+{
+  return startWrite(needsKBs, false);
+}
+
+WriteTransactionPtr KeyValueStoreImpl::beginBulkLoad(unsigned needsKBs)
+{
+  return startWrite(needsKBs, true);
+}
+
+WriteTransactionPtr KeyValueStoreImpl::startWrite(unsigned needsKBs, bool append)
 {
   if(m_writeBlocks)
     throw invalid_argument("write operations are blocked by a running transaction");
@@ -688,23 +1723,168 @@ WriteTransactionPtr KeyValueStoreImpl::beginWrite(unsigned needsKBs)
   shared_ptr<Transaction> wtr = writeTxn.lock();
   if(wtr && !wtr->isClosed()) throw invalid_argument("a write transaction is already running");
 
-  checkAvailableSpace(needsKBs);
-  auto tptr = shared_ptr<Transaction>(new Transaction(*this, Transaction::Mode::write, m_env, m_dbi_data));
+  m_reads->start();
+  shared_ptr<Transaction> tptr;
+  try {
+    tptr = openWrite(needsKBs, append);
+  }
+  catch(...) {
+    lock_guard<mutex> lock(m_reads->lock);
+    m_reads->starting--;
+    throw;
+  }
+  lock_guard<mutex> lock(m_reads->lock);
+  m_reads->starting--;
   writeTxn = tptr;
 
   return tptr;
 }
 
-void Transaction::doCommit()
+shared_ptr<Transaction> KeyValueStoreImpl::openWrite(unsigned needsKBs, bool append)
+{
+  checkAvailableSpace(needsKBs);
+  auto tptr = shared_ptr<Transaction>(newTransaction(Transaction::Mode::write, false, false, append));
+  if(m_options.multiProcess) loadIdCounters(tptr->m_txn);
+  return tptr;
+}
+
+void Transaction::commitTxn(promise<void> *synced)
 {
-  m_txn.commit();
+  KeyValueStoreImpl *impl = (KeyValueStoreImpl *)&store;
+  flushDeferred();
+  if(impl->multiProcess()) impl->saveIdCounters(m_txn);
+
+  try {
+    lock_guard<mutex> lock(impl->commitMutex());
+    m_txn.commit();
+  }
+  catch(::lmdb::error &err) {
+    //LMDB has released the transaction
+    discard(m_txn);
+    if(err.code() == MDB_MAP_FULL) mapFull();
+    throw;
+  }
   m_closed = true;
-  ((KeyValueStoreImpl *)&store)->transactionCompleted(m_mode, m_blockWrites);
+  impl->committed(m_stats.bytesWritten, synced);
+  impl->transactionCompleted(m_mode, m_blockWrites);
 }
 
-void Transaction::doAbort()
+void Transaction::doCommit()
+{
+  commitTxn(nullptr);
+}
+
+future<void> Transaction::doCommitAsync()
+{
+  promise<void> synced;
+  future<void> result = synced.get_future();
+  commitTxn(&synced);
+  return result;
+}
+
+void Transaction::doSavepoint()
+{
+  unsigned flags;
+  mdb_env_get_flags(m_env, &flags);
+  if(flags & MDB_WRITEMAP) throw error("savepoints are not supported with writeMap");
+  flushDeferred();
+
+  auto child = ::lmdb::txn::begin(m_env, m_txn);
+  m_parents.push_back(std::move(m_txn));
+  m_txn = std::move(child);
+}
+
+void Transaction::doRollback()
 {
+  m_deferred.clear();
   m_txn.abort();
+  m_txn = std::move(m_parents.back());
+  m_parents.pop_back();
+}
+
+void Transaction::doRelease()
+{
+  try {
+    m_txn.commit();
+  }
+  catch(::lmdb::error &err) {
+    //LMDB has released the nested transaction
+    discard(m_txn);
+    m_txn = std::move(m_parents.back());
+    m_parents.pop_back();
+
+    if(err.code() == MDB_MAP_FULL) mapFull();
+    throw;
+  }
+  m_txn = std::move(m_parents.back());
+  m_parents.pop_back();
+}
+
+bool Transaction::put(MDB_dbi dbi, MDB_val *key, MDB_val *val, unsigned flags)
+{
+  int rc = mdb_put(m_txn, dbi, key, val, flags);
+
+  if(flags & MDB_APPEND) {
+    if(rc == MDB_KEYEXIST) {
+      //keys that don't sort after the last key in the database are written normally
+      m_stats.appendFallbacks++;
+      rc = mdb_put(m_txn, dbi, key, val, flags & ~MDB_APPEND);
+    }
+    else if(rc == MDB_SUCCESS)
+      m_stats.appends++;
+  }
+  if(rc == MDB_MAP_FULL) mapFull();
+  if(rc != MDB_SUCCESS && rc != MDB_KEYEXIST) ::lmdb::error::raise("mdb_put", rc);
+
+  return rc == MDB_SUCCESS;
+}
+
+void Transaction::flushDeferred()
+{
+  writeDeferred(m_deferred.begin(), m_deferred.end());
+  m_deferred.clear();
+}
+
+void Transaction::flushDeferred(ClassId classId, ObjectId objectId)
+{
+  //values of other objects (e.g., the parent of a nested object) stay deferred until their own key is written
+  auto first = stable_partition(m_deferred.begin(), m_deferred.end(), [classId, objectId](const DeferredValue &value) {
+    return value.classId != classId || value.objectId != objectId;
+  });
+  writeDeferred(first, m_deferred.end());
+  m_deferred.erase(first, m_deferred.end());
+}
+
+void Transaction::writeDeferred(vector<DeferredValue>::iterator begin, vector<DeferredValue>::iterator end)
+{
+  sort(begin, end);
+  for(auto it = begin; it != end; ++it) {
+    SK_CONSTR(kv, it->classId, it->objectId, it->propertyId);
+    ::lmdb::val k{kv, sizeof(kv)};
+    ::lmdb::val v{it->data.data(), it->data.size()};
+    put(m_dbi, k, v, MDB_APPEND);
+  }
+}
+
+void Transaction::mapFull()
+{
+  ((KeyValueStoreImpl *)&store)->noteMapFull(m_stats.bytesWritten);
+  throw store_full_error();
+}
+
+void Transaction::abortNested()
+{
+  while(!m_parents.empty()) doRollback();
+}
+
+void Transaction::doAbort()
+{
+  abortNested();
+  m_deferred.clear();
+
+  //pooled read transactions keep their handle for a subsequent renew
+  if(m_pooled) m_txn.reset();
+  else m_txn.abort();
   m_closed = true;
   ((KeyValueStoreImpl *)&store)->transactionCompleted(m_mode, m_blockWrites);
 }
@@ -725,7 +1905,18 @@ bool Transaction::putData(ClassId classId, ObjectId objectId, PropertyId propert
   ::lmdb::val k{kv, sizeof(kv)};
   ::lmdb::val v{buf.data(), buf.size()};
 
-  return ::lmdb::dbi_put(m_txn, m_dbi.handle(), k, v, m_append ? MDB_APPEND : 0);
+  m_stats.writes++;
+  m_stats.bytesWritten += buf.size();
+
+  //property values are written before the object key. Hold them back until the object key is out
+  if(m_append && propertyId) {
+    m_deferred.push_back(DeferredValue {classId, objectId, propertyId,
+                                        vector<byte_t>(buf.data(), buf.data() + buf.size())});
+    return true;
+  }
+  if(!put(m_dbi, k, v, m_append ? MDB_APPEND : 0)) return false;
+  if(m_append) flushDeferred(classId, objectId);
+  return true;
 }
 
 bool Transaction::putData(ObjectKey &key, WriteBuf &buf)
@@ -734,15 +1925,19 @@ bool Transaction::putData(ObjectKey &key, WriteBuf &buf)
   SK_CONSTR(kv, key.classId, key.objectId, 0);
   ::lmdb::val k{kv, sizeof(kv)};
   ::lmdb::val v{buf.data(), buf.size()};
-  if(!::lmdb::dbi_put(m_txn, m_dbi.handle(), k, v, m_append ? MDB_APPEND : 0)) return false;
+  m_stats.writes++;
+  m_stats.bytesWritten += buf.size();
+  if(!put(m_dbi, k, v, m_append ? MDB_APPEND : 0)) return false;
 
   if(key.refcount) {
+    m_stats.refcountUpdates++;
     //object refcount under propertyId == 1
     SK_PROPID(kv) = 1;
     k.assign(kv, sizeof(kv));
     v.assign(&key.refcount, sizeof(key.refcount));
-    return ::lmdb::dbi_put(m_txn, m_dbi.handle(), k, v, m_append ? MDB_APPEND : 0);
+    if(!put(m_dbi, k, v, m_append ? MDB_APPEND : 0)) return false;
   }
+  if(m_append) flushDeferred(key.classId, key.objectId);
   return true;
 }
 
@@ -752,7 +1947,9 @@ bool Transaction::allocData(ClassId classId, ObjectId objectId, PropertyId prope
   ::lmdb::val k{kv, sizeof(kv)};
   ::lmdb::val v{nullptr, size};
 
-  if(::lmdb::dbi_put(m_txn, m_dbi.handle(), k, v, MDB_RESERVE)) {
+  m_stats.writes++;
+  m_stats.bytesWritten += size;
+  if(put(m_dbi, k, v, MDB_RESERVE)) {
     *data = v.data<byte_t>();
     return true;
   }
@@ -764,8 +1961,12 @@ void Transaction::getData(ReadBuf &buf, ClassId classId, ObjectId objectId, Prop
   SK_CONSTR(kv, classId, objectId, propertyId);
   ::lmdb::val k{kv, sizeof(kv)};
   ::lmdb::val v{};
-  if(::lmdb::dbi_get(m_txn, m_dbi.handle(), k, v))
+  if(::lmdb::dbi_get(m_txn, m_dbi.handle(), k, v)) {
     buf.start(v.data<byte_t>(), v.size());
+
+    m_stats.reads++;
+    m_stats.bytesRead += v.size();
+  }
 }
 
 void Transaction::getData(ReadBuf &buf, ObjectKey &key, bool getRefcount)
@@ -776,6 +1977,9 @@ void Transaction::getData(ReadBuf &buf, ObjectKey &key, bool getRefcount)
   if(::lmdb::dbi_get(m_txn, m_dbi.handle(), k, v)) {
     buf.start(v.data<byte_t>(), v.size());
 
+    m_stats.reads++;
+    m_stats.bytesRead += v.size();
+
     if(getRefcount) {
       SK_PROPID(kv) = 1;
       k.assign(kv, sizeof(kv));
@@ -786,6 +1990,33 @@ void Transaction::getData(ReadBuf &buf, ObjectKey &key, bool getRefcount)
   }
 }
 
+void Transaction::getData(ReadBuf *bufs, ObjectKey *keys, size_t count, bool getRefcount)
+{
+  //with ascending keys, MDB_SET mostly resolves within the current leaf page instead of descending from the root
+  auto cursor = ::lmdb::cursor::open(m_txn, m_dbi);
+
+  for(size_t i=0; i<count; i++) {
+    SK_CONSTR(kv, keys[i].classId, keys[i].objectId, 0);
+    ::lmdb::val k{kv, sizeof(kv)};
+    ::lmdb::val v{};
+    m_stats.cursorSteps++;
+    if(!cursor.get(k, v, MDB_SET_KEY)) continue;
+
+    bufs[i].start(v.data<byte_t>(), v.size());
+
+    m_stats.reads++;
+    m_stats.bytesRead += v.size();
+
+    if(getRefcount && cursor.get(k, v, MDB_NEXT)) {
+      m_stats.cursorSteps++;
+      byte_t *nk = k.data<byte_t>();
+      if(SK_CLASSID(nk) == keys[i].classId && SK_OBJID(nk) == keys[i].objectId && SK_PROPID(nk) == 1)
+        keys[i].refcount = *(uint16_t *)v.data();
+    }
+  }
+  cursor.close();
+}
+
 bool Transaction::remove(ClassId classId, ObjectId objectId)
 {
   SK_CONSTR(kv, classId, objectId, 1);
@@ -794,6 +2025,7 @@ bool Transaction::remove(ClassId classId, ObjectId objectId)
 
   SK_PROPID(kv) = 0;
   k.assign(kv, sizeof(kv));
+  m_stats.removes++;
   return ::lmdb::dbi_del(m_txn, m_dbi.handle(), k);
 }
 
@@ -801,6 +2033,7 @@ bool Transaction::remove(ClassId classId, ObjectId objectId, PropertyId property
 {
   SK_CONSTR(kv, classId, objectId, propertyId);
   ::lmdb::val k{kv, sizeof(kv)};
+  m_stats.removes++;
   return ::lmdb::dbi_del(m_txn, m_dbi.handle(), k);
 }
 
@@ -811,6 +2044,7 @@ uint16_t Transaction::decrementRefCount(ClassId cid, ObjectId oid)
   SK_CONSTR(kv, cid, oid, 1);
   ::lmdb::val k{kv, sizeof(kv)};
   ::lmdb::val v{};
+  m_stats.refcountUpdates++;
   if(cursor.get(k, v, MDB_SET)) {
     uint16_t refcnt = *((uint16_t *)v.data<byte_t>());
     if(refcnt > 0) {
@@ -833,18 +2067,99 @@ void Transaction::clearRefCounts(vector<ClassId> classes)
 
     if(cursor.get(key, MDB_SET)) {
       cursor.del();
+      m_stats.refcountUpdates++;
 
       while(cursor.get(key, MDB_NEXT) && SK_CLASSID(k) == cls) {
-        if(SK_PROPID(k) == 1) cursor.del();
+        m_stats.cursorSteps++;
+        if(SK_PROPID(k) == 1) {
+          cursor.del();
+          m_stats.refcountUpdates++;
+        }
       }
     }
   }
   cursor.close();
 }
 
+void Transaction::putIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key, const byte_t *value, size_t size)
+{
+  byte_t rk[IndexPrefix_sz + IndexTrailer_sz];
+  size_t rsz = index_prefix(rk, classId, propertyId, IndexTag_reverse);
+  rsz += index_trailer(rk + rsz, key);
+  ::lmdb::val reverseKey {rk, rsz};
+  ::lmdb::val reverseVal {};
+
+  byte_t fk[IndexKey_maxsz];
+  size_t fsz = index_prefix(fk, classId, propertyId, IndexTag_forward);
+
+  if(::lmdb::dbi_get(m_txn, m_dbi_index.handle(), reverseKey, reverseVal)) {
+    //unchanged value, nothing to do
+    if(reverseVal.size() == size && !memcmp(reverseVal.data(), value, size)) return;
+
+    //remove the forward entry for the previous value
+    memcpy(fk + fsz, reverseVal.data(), reverseVal.size());
+    size_t osz = fsz + reverseVal.size();
+    osz += index_trailer(fk + osz, key);
+    ::lmdb::val oldKey {fk, osz};
+    ::lmdb::dbi_del(m_txn, m_dbi_index.handle(), oldKey);
+  }
+
+  m_stats.writes++;
+  m_stats.bytesWritten += size;
+
+  reverseVal.assign(value, size);
+  put(m_dbi_index, reverseKey, reverseVal, 0);
+
+  memcpy(fk + fsz, value, size);
+  fsz += size;
+  fsz += index_trailer(fk + fsz, key);
+  ::lmdb::val forwardKey {fk, fsz};
+  ::lmdb::val forwardVal {fk, 0};
+  put(m_dbi_index, forwardKey, forwardVal, 0);
+}
+
+void Transaction::removeIndexEntry(ClassId classId, PropertyId propertyId, const ObjectKey &key)
+{
+  byte_t rk[IndexPrefix_sz + IndexTrailer_sz];
+  size_t rsz = index_prefix(rk, classId, propertyId, IndexTag_reverse);
+  rsz += index_trailer(rk + rsz, key);
+  ::lmdb::val reverseKey {rk, rsz};
+  ::lmdb::val reverseVal {};
+
+  if(::lmdb::dbi_get(m_txn, m_dbi_index.handle(), reverseKey, reverseVal)) {
+    byte_t fk[IndexKey_maxsz];
+    size_t fsz = index_prefix(fk, classId, propertyId, IndexTag_forward);
+    memcpy(fk + fsz, reverseVal.data(), reverseVal.size());
+    fsz += reverseVal.size();
+    fsz += index_trailer(fk + fsz, key);
+    ::lmdb::val forwardKey {fk, fsz};
+
+    ::lmdb::dbi_del(m_txn, m_dbi_index.handle(), forwardKey);
+    ::lmdb::dbi_del(m_txn, m_dbi_index.handle(), reverseKey);
+    m_stats.removes++;
+  }
+}
+
+void Transaction::clearIndex(ClassId classId, PropertyId propertyId)
+{
+  auto cursor = ::lmdb::cursor::open(m_txn, m_dbi_index);
+
+  //reverse and forward entries share the classId/propertyId prefix
+  byte_t k[IndexPrefix_sz];
+  index_prefix(k, classId, propertyId, IndexTag_reverse);
+  ::lmdb::val key {k, sizeof(k)};
+
+  bool gotten = cursor.get(key, MDB_SET_RANGE);
+  while(gotten && key.size() >= IndexPrefix_sz && !memcmp(key.data(), k, ClassId_sz + PropertyId_sz)) {
+    cursor.del();
+    gotten = cursor.get(key, MDB_NEXT);
+  }
+  cursor.close();
+}
+
 ChunkCursor::Ptr Transaction::_openChunkCursor(ClassId classId, ObjectId objectId, bool atEnd)
 {
-  return ChunkCursor::Ptr(new ChunkCursorImpl(m_txn, m_dbi, classId, objectId, atEnd));
+  return ChunkCursor::Ptr(new ChunkCursorImpl(m_txn, m_dbi, m_stats, m_chunkCache, m_readahead, classId, objectId, atEnd));
 }
 
 bool Transaction::lastChunk(ObjectId collectionId, PropertyId &chunkId, ::lmdb::val &data)
@@ -872,6 +2187,23 @@ bool check_chunkinfo(const ChunkInfo &run, const ChunkInfo &ref)
   return run.startIndex + run.elementCount - 1 < ref.startIndex;
 }
 
+const byte_t *Transaction::getChunk(ObjectId collectionId, PropertyId chunkId, ChunkCache::Buffer &decoded)
+{
+  SK_CONSTR(k, COLLECTION_CLSID, collectionId, chunkId);
+  ::lmdb::val keyval{k, sizeof(k)}, dataval;
+  if(!m_dbi.get(m_txn, keyval, dataval)) return nullptr;
+
+  m_stats.reads++;
+  m_stats.bytesRead += dataval.size();
+
+  if(ChunkCache::compressed(dataval.data<byte_t>(), dataval.size())) {
+    decoded = m_chunkCache.get(collectionId, chunkId, dataval.data<byte_t>(), dataval.size());
+    return decoded->data();
+  }
+  decoded.reset();
+  return dataval.data<byte_t>();
+}
+
 bool Transaction::_getCollectionData(CollectionInfo *info, size_t startIndex, size_t length,
                                      size_t elementSize, void **data, bool *owned)
 {
@@ -881,33 +2213,33 @@ bool Transaction::_getCollectionData(CollectionInfo *info, size_t startIndex, si
     chunk.startIndex += length-1;
     auto findEnd = lower_bound(findStart, info->chunkInfos.cend(), chunk, check_chunkinfo);
     if(findEnd != info->chunkInfos.cend()) {
-      ::lmdb::val keyval, startval, endval;
-
-      SK_CONSTR(k, COLLECTION_CLSID, info->collectionId, findStart->chunkId);
-      keyval.assign(k, sizeof(k));
-      if(!m_dbi.get(m_txn, keyval, startval)) return false;
+      ChunkCache::Buffer decoded, enddecoded;
+      const byte_t *startchunk = getChunk(info->collectionId, findStart->chunkId, decoded);
+      if(!startchunk) return false;
 
-      byte_t *datastart = startval.data<byte_t>() + ChunkHeader_sz;
+      const byte_t *datastart = startchunk + ChunkHeader_sz;
       size_t offs = startIndex - findStart->startIndex;
       datastart += offs * elementSize;
 
       if(findStart == findEnd) {
         //all data in same chunk, Cool, we're done
-        if(*data) memcpy(*data, datastart, length*elementSize); //copy to user-provided memory
-        else  *data = datastart;                                //return pointer into DB memory!
         if(owned) *owned = false;
+        if(*data) memcpy(*data, datastart, length*elementSize); //copy to user-provided memory
+        else if(decoded) {
+          //decompressed data lives in the chunk cache, hand out a copy
+          *data = malloc(length*elementSize);
+          memcpy(*data, datastart, length*elementSize);
+          if(owned) *owned = true;
+        }
+        else *data = (void *)datastart;                          //return pointer into DB memory!
       }
       else {
         //data crosses chunks. Too bad, need to copy
-        size_t startlen = findStart->dataSize - (datastart - startval.data<byte_t>());
+        size_t startlen = findStart->dataSize - (datastart - startchunk);
         size_t datalen = startlen;
         for(auto fs=findStart+1; fs != findEnd; fs++)
           datalen += fs->dataSize - ChunkHeader_sz;
 
-        SK_CONSTR(k, COLLECTION_CLSID, info->collectionId, findEnd->chunkId);
-        keyval.assign(k, sizeof(k));
-        if(!m_dbi.get(m_txn, keyval, endval)) return false;
-
         size_t endlen=0, endcount = startIndex + length - findEnd->startIndex;
         endlen = endcount * elementSize;
         datalen += endlen;
@@ -923,15 +2255,16 @@ bool Transaction::_getCollectionData(CollectionInfo *info, size_t startIndex, si
         dta += startlen;
 
         for(auto fs=findStart+1; fs != findEnd; fs++) {
-          SK_CONSTR(k, COLLECTION_CLSID, info->collectionId, fs->chunkId);
-          keyval.assign(k, sizeof(k));
-          ::lmdb::val dataval;
-          if(!m_dbi.get(m_txn, keyval, dataval)) return false;
+          ChunkCache::Buffer chunkdecoded;
+          const byte_t *chunkdata = getChunk(info->collectionId, fs->chunkId, chunkdecoded);
+          if(!chunkdata) return false;
 
-          memcpy(dta, dataval.data<byte_t>()+ChunkHeader_sz, fs->dataSize-ChunkHeader_sz);
+          memcpy(dta, chunkdata+ChunkHeader_sz, fs->dataSize-ChunkHeader_sz);
           dta += fs->dataSize-ChunkHeader_sz;
         }
-        memcpy(dta, endval.data()+ChunkHeader_sz, endlen);
+        const byte_t *endchunk = getChunk(info->collectionId, findEnd->chunkId, enddecoded);
+        if(!endchunk) return false;
+        memcpy(dta, endchunk+ChunkHeader_sz, endlen);
       }
       return true;
     }
@@ -939,19 +2272,85 @@ bool Transaction::_getCollectionData(CollectionInfo *info, size_t startIndex, si
   return false;
 }
 
-ClassCursorHelper * Transaction::_openCursor(const vector<ClassId> &classIds)
+ClassCursorHelper * Transaction::_openCursor(const vector<ClassId> &classIds, ObjectId startId, ObjectId endId)
 {
-  return new ClassCursorHelper(m_txn, m_dbi, classIds);
+  return new ClassCursorHelper(m_txn, m_dbi, m_stats, m_readahead, classIds, startId, endId);
 }
 
 VectorCursorHelper * Transaction::_openCursor(ClassId classId, ObjectId objectId, PropertyId propertyId)
 {
-  return new VectorCursorHelper(m_txn, m_dbi, classId, objectId, propertyId);
+  return new VectorCursorHelper(m_txn, m_dbi, m_stats, classId, objectId, propertyId);
 }
 
 CollectionCursorHelper * Transaction::_openCursor(ClassId classId, ObjectId collectionId)
 {
-  return new CollectionCursorHelper(m_txn, m_dbi, classId, collectionId);
+  return new CollectionCursorHelper(m_txn, m_dbi, m_stats, m_chunkCache, m_readahead, classId, collectionId);
+}
+
+IndexCursorHelper * Transaction::_openIndexCursor(ClassId classId, PropertyId propertyId,
+                                                  const byte_t *lower, size_t lowerSize, const byte_t *upper, size_t upperSize)
+{
+  return new IndexCursorHelper(m_txn, m_dbi, m_dbi_index, m_stats, classId, propertyId, lower, lowerSize, upper, upperSize);
+}
+
+void KeyValueStoreImpl::loadIdCounters(::lmdb::txn &txn)
+{
+  m_savedIds.clear();
+
+  SK_CONSTR(k, STOREINFO_CLSID, 0, IDCOUNTER_PROPID);
+  ::lmdb::val key {k, sizeof(k)}, val;
+
+  auto cursor = ::lmdb::cursor::open(txn, m_dbi_data);
+  for(bool found = cursor.get(key, val, MDB_SET_RANGE);
+      found && SK_CLASSID(key.data<byte_t>()) == STOREINFO_CLSID; found = cursor.get(key, val, MDB_NEXT))
+  {
+    if(SK_PROPID(key.data<byte_t>()) != IDCOUNTER_PROPID) continue;
+
+    ClassId classId = (ClassId)SK_OBJID(key.data<byte_t>());
+    ObjectId maxId = read_integer<ObjectId, ObjectId_sz>(val.data<byte_t>());
+    m_savedIds[classId] = maxId;
+
+    ObjectId *counter = idCounter(classId);
+    if(counter && *counter < maxId) *counter = maxId;
+  }
+  cursor.close();
+}
+
+void KeyValueStoreImpl::saveIdCounters(::lmdb::txn &txn)
+{
+  vector<ClassId> classIds = registeredClasses();
+  classIds.push_back(COLLECTION_CLSID);
+
+  for(ClassId classId : classIds) {
+    ObjectId maxId = *idCounter(classId);
+    auto saved = m_savedIds.find(classId);
+    if(saved != m_savedIds.end() ? saved->second >= maxId : maxId == 0) continue;
+
+    SK_CONSTR(k, STOREINFO_CLSID, classId, IDCOUNTER_PROPID);
+    byte_t v[ObjectId_sz];
+    write_integer<ObjectId_sz>(v, maxId);
+
+    ::lmdb::val key {k, sizeof(k)}, val {v, sizeof(v)};
+    m_dbi_data.put(txn, key, val);
+    m_savedIds[classId] = maxId;
+  }
+}
+
+ClassId KeyValueStoreImpl::findMaxClassId(::lmdb::txn &txn)
+{
+  ClassId maxId = m_maxClassId;
+
+  ::lmdb::val key, val;
+  key.assign((byte_t *)0, 0);
+  val.assign((byte_t *)0, 0);
+  auto cursor = ::lmdb::cursor::open(txn, m_dbi_meta);
+  while (cursor.get(key, val, MDB_NEXT_NODUP)) {
+    ClassId cid = read_integer<ClassId>(val.data<byte_t>()+2, 2);
+    if(cid > maxId) maxId = cid;
+  }
+  cursor.close();
+
+  return maxId;
 }
 
 ObjectId KeyValueStoreImpl::findMaxObjectId(::lmdb::txn &txn, ClassId classId)
@@ -1078,6 +2477,9 @@ void KeyValueStoreImpl::loadSaveClassMeta(
     //class appears for the first time
     cursor.close();
 
+    //another process may have registered classes in the meantime
+    if(m_options.multiProcess) m_maxClassId = findMaxClassId(txn);
+
     cdata.classId = ++m_maxClassId;
 
     //save the first record [0, classId]
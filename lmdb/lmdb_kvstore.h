@@ -29,15 +29,88 @@ namespace lmdb {
 class KeyValueStore : public lo::persistence::KeyValueStore
 {
 public:
+  /**
+   * what a commit guarantees on return. The relaxed modes trade the most recent commits before a system crash for
+   * commit throughput. Database consistency is preserved in all modes. In the relaxed modes a background thread
+   * syncs at the configured interval and byte budget, see Options
+   */
+  enum class Durability {
+    //sync data and meta page on every commit
+    full,
+    //sync data, but not the meta page (MDB_NOMETASYNC). A crash may lose the last commit
+    noMetaSync,
+    //flush the memory map asynchronously (MDB_MAPASYNC). Only differs from full with writeMap
+    mapAsync,
+    //don't sync on commit (MDB_NOSYNC). A crash may lose all commits since the last background sync
+    noSync
+  };
+
+  /**
+   * store options. The constructor takes the basic settings, the others are set by chaining, e.g.
+   *
+   * Options(1024).setReadPoolSize(0).setDurability(Durability::noSync, 50)
+   */
   struct Options {
     const unsigned initialMapSizeMB = 1;
     const unsigned minTransactionSpaceKB = 512;
     const unsigned increaseMapSizeKB = 512;
     const bool lockFile = false;
     const bool writeMap = true;
+    //maximum number of reset read transactions kept for renewal by beginRead(). 0 disables pooling
+    unsigned readPoolSize = 16;
+    //on-disk format for newly created stores. Existing stores keep the format they were created with
+    kv::StoreFormat format = kv::StoreFormat::fixed;
+    //number of pages (class cursors) or chunks (collection cursors) that sequential cursors ask the OS to read
+    //ahead of the current position. 0 disables readahead
+    unsigned readahead = 8;
+    //allow several processes to write to the same database. Implies lockFile. ObjectId and collection id counters
+    //are kept in the database and synchronized at the start and commit of each write transaction. Object caches
+    //are process-local and should not be used in this mode
+    bool multiProcess = false;
+    //commit durability, see Durability
+    Durability durability = Durability::full;
+    //interval at which the background thread syncs commits made in a relaxed durability mode. 0 leaves syncing
+    //to the byte budget. If both are 0, the background thread syncs after every commit
+    unsigned syncIntervalMs = 100;
+    //number of bytes committed since the last sync that trigger a sync before the interval has elapsed. 0 disables
+    //the byte budget
+    size_t syncBytes = 0;
+    //percentage of the current size by which the map grows when a write transaction needs more space. The growth is
+    //at least increaseMapSizeKB. 0 (the default) grows by increaseMapSizeKB only
+    unsigned mapGrowthPercent = 0;
+    //upper bound for the map size. Write transactions that need more space fail with store_full_error. 0 means no limit
+    unsigned maxMapSizeMB = 0;
 
     Options(unsigned mapSizeMB = 1024, bool lockFile = false, bool writeMap = false)
         : initialMapSizeMB(mapSizeMB), lockFile(lockFile), writeMap(writeMap) {}
+
+    Options &setReadPoolSize(unsigned size) {
+      readPoolSize = size;
+      return *this;
+    }
+    Options &setFormat(kv::StoreFormat storeFormat) {
+      format = storeFormat;
+      return *this;
+    }
+    Options &setReadahead(unsigned count) {
+      readahead = count;
+      return *this;
+    }
+    Options &setMultiProcess(bool multi=true) {
+      multiProcess = multi;
+      return *this;
+    }
+    Options &setDurability(Durability mode, unsigned intervalMs = 100, size_t bytes = 0) {
+      durability = mode;
+      syncIntervalMs = intervalMs;
+      syncBytes = bytes;
+      return *this;
+    }
+    Options &setMapGrowth(unsigned percent, unsigned maxSizeMB = 0) {
+      mapGrowthPercent = percent;
+      maxMapSizeMB = maxSizeMB;
+      return *this;
+    }
   };
 
   struct Factory
@@ -21,8 +21,16 @@
 #include <lmdb++.h>
 #include <lmdb/lmdb_kvstore.h>
 #include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <mutex>
+#include <thread>
 #include "testclasses.h"
 
 using namespace lo::persistence;
@@ -33,390 +41,996 @@ using namespace lo::Overlays;
 
 namespace lolmdb = lo::persistence::lmdb;
 
-static const long rounds = 1000000;
+/**
+ * benchmark parameters, settable from the command line:
+ *
+ * LmdbBench [--size N] [--warmup N] [--repetitions N] [--filter substring] [--json file]
+ */
+struct BenchOptions
+{
+  //number of objects/elements in the base datasets. Cases with heavier objects use a fraction
+  size_t size = 100000;
+  unsigned warmup = 1;
+  unsigned repetitions = 5;
+  //only run cases whose name contains this string
+  string filter;
+  //if set, write results as JSON to this file ("-" for stdout)
+  string jsonFile;
+};
+
+struct BenchResult
+{
+  string name;
+  size_t opsPerRun = 0;
+  double opsPerSec = 0, meanMs = 0, p50us = 0, p99us = 0;
+};
+
+/**
+ * minimal benchmark harness. A case is run warmup + repetitions times. Each operation inside a run is timed
+ * individually through op(), which yields the latency percentiles. Throughput is computed from the total wall time of
+ * the measured runs, and thus includes per-run overhead like transaction commits
+ */
+class Bench
+{
+  using Clock = std::chrono::steady_clock;
 
-#define MK_KEY() char kbuf[10]; sprintf(kbuf, "%d", i);
-#define MK_KEYL() char kbuf[50]; sprintf(kbuf, "%ld", i);
-#define MK_DATA() char vbuf[50]; Data data(i, i+1, i+2); sprintf(vbuf, "%f;%f;%f", data.d1, data.d2, data.d3);
+  const BenchOptions m_options;
+  vector<BenchResult> m_results;
+  vector<Clock::duration> m_latencies;
 
-#define BEG() auto begin = std::chrono::high_resolution_clock::now();
-#define DUR() std::chrono::high_resolution_clock::duration dur = std::chrono::high_resolution_clock::now() - begin; \
-std::chrono::milliseconds ms = std::chrono::duration_cast<std::chrono::milliseconds>(dur); cout << ms.count() << endl;
+public:
+  Bench(const BenchOptions &options) : m_options(options) {}
 
-void benchColored2DPointWrite(KeyValueStore *kv)
-{
-  BEG()
-  auto wtxn = kv->beginWrite(true); //we use a bulk transaction here,because we know objects are shallow
-  for(int i=0; i< rounds; i++) {
-    Colored2DPoint p;
-    p.set(2.0f+i, 3.0f+i, 4.0f+i, 5.0f+i, 6.0f+i, 7.5f+i);
-    wtxn->putObject(p);
+  size_t size() const {return m_options.size;}
+
+  /**
+   * execute and time a single operation
+   */
+  template <typename F> void op(F fn)
+  {
+    auto start = Clock::now();
+    fn();
+    m_latencies.push_back(Clock::now() - start);
   }
-  wtxn->commit();
-  DUR()
-}
 
-void benchValueCollection(KeyValueStore *kv) {
-  //test persistent collection of scalar (primitve) values
-  ObjectId collectionId;
+  /**
+   * run a benchmark case
+   *
+   * @param name the case name, used in the report
+   * @param run executes one run, calling op() for each operation
+   * @param setup called once before the first run
+   * @param teardown called once after the last run
+   */
+  void run(const string &name, function<void()> run, function<void()> setup=nullptr, function<void()> teardown=nullptr)
+  {
+    if(!m_options.filter.empty() && name.find(m_options.filter) == string::npos) return;
 
+    if(setup) setup();
+
+    for(unsigned i=0; i<m_options.warmup; i++) run();
+    m_latencies.clear();
+
+    Clock::duration total(0);
+    for(unsigned i=0; i<m_options.repetitions; i++) {
+      auto start = Clock::now();
+      run();
+      total += Clock::now() - start;
+    }
+    if(teardown) teardown();
+
+    BenchResult result;
+    result.name = name;
+
+    size_t count = m_latencies.size();
+    if(count && m_options.repetitions) {
+      sort(m_latencies.begin(), m_latencies.end());
+
+      double totalSecs = chrono::duration<double>(total).count();
+      result.opsPerRun = count / m_options.repetitions;
+      result.opsPerSec = count / totalSecs;
+      result.meanMs = totalSecs * 1000 / m_options.repetitions;
+      result.p50us = chrono::duration<double, micro>(m_latencies[count / 2]).count();
+      result.p99us = chrono::duration<double, micro>(m_latencies[min(count - 1, count * 99 / 100)]).count();
+    }
+    m_results.push_back(result);
+
+    cout << left << setw(30) << name << right << fixed << setprecision(0)
+         << setw(12) << result.opsPerSec << " ops/s" << setprecision(3)
+         << setw(10) << result.p50us << " us p50"
+         << setw(10) << result.p99us << " us p99"
+         << setw(10) << result.meanMs << " ms/run" << endl;
+  }
+
+  /**
+   * @return str as a quoted JSON string
+   */
+  static string jsonString(const string &str)
   {
-    //save test data
-    vector<double> vect;
-    for(unsigned i=0; i<1000; i++)
-      vect.push_back(1.44 * i);
+    ostringstream os;
+    os << '"';
+    for(char c : str) {
+      switch(c) {
+        case '"': os << "\\\""; break;
+        case '\\': os << "\\\\"; break;
+        case '\n': os << "\\n"; break;
+        case '\t': os << "\\t"; break;
+        default:
+          if((unsigned char)c < 0x20) os << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec << setfill(' ');
+          else os << c;
+      }
+    }
+    os << '"';
+    return os.str();
+  }
+
+  void writeJson(ostream &os) const
+  {
+    os << "{\n  \"size\": " << m_options.size << ",\n  \"warmup\": " << m_options.warmup
+       << ",\n  \"repetitions\": " << m_options.repetitions << ",\n  \"results\": [";
+
+    for(size_t i=0; i<m_results.size(); i++) {
+      const BenchResult &r = m_results[i];
+      os << (i ? ",\n" : "\n") << setprecision(3) << fixed
+         << "    {\"name\": " << jsonString(r.name) << ", \"ops_per_run\": " << r.opsPerRun
+         << ", \"ops_per_sec\": " << r.opsPerSec << ", \"mean_ms\": " << r.meanMs
+         << ", \"p50_us\": " << r.p50us << ", \"p99_us\": " << r.p99us << "}";
+    }
+    os << "\n  ]\n}\n";
+  }
+
+  void report() const
+  {
+    if(m_options.jsonFile.empty()) return;
+
+    if(m_options.jsonFile == "-")
+      writeJson(cout);
+    else {
+      ofstream os(m_options.jsonFile);
+      writeJson(os);
+    }
+  }
+};
 
+//deterministic pseudo-random object ids in [1, max]
+static ObjectId randomId(uint64_t &seed, size_t max)
+{
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return ObjectId((seed >> 33) % max + 1);
+}
+
+//embedded value properties, fixed-size
+void benchEmbedded(Bench &bench, KeyValueStore *kv)
+{
+  const size_t size = bench.size();
+
+  bench.run("embedded.write", [&]() {
     auto wtxn = kv->beginWrite();
-    collectionId = wtxn->putValueCollection(vect);
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        Colored2DPoint p(2.0f+i, 3.0f+i, 4.0f+i, 5.0f+i, 6.0f+i, 7.5f+i);
+        wtxn->putObject(p);
+      });
+    }
     wtxn->commit();
-  }
-  /*{
-    //load saved collection
+  });
+
+  bench.run("embedded.scan", [&]() {
     auto rtxn = kv->beginRead();
-    vector<double> loaded = rtxn->getValueCollection<double>(collectionId);
-    assert(loaded.size() == 1000);
+    size_t count = 0;
+    for(auto cursor = rtxn->openCursor<Colored2DPoint>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        ObjectKey key;
+        Colored2DPoint *loaded = cursor->get(key);
+        if(loaded) count++;
+        delete loaded;
+        cursor->next();
+      });
+    }
     rtxn->end();
-  }*/
-  {
-    //iterate over collection w/ cursor
-    auto rtxn = kv->beginRead();
-
-    unsigned count = 0;
-    auto cursor = rtxn->openValueCursor<double>(collectionId);
-    while(!cursor->atEnd()) {
-      count++;
-      double val;
-      cursor->get(val);
+    assert(count >= size);
+  });
+
+  bench.run("embedded.view_scan", [&]() {
+    auto rtxn = kv->beginExclusiveRead();
+    double sum = 0;
+    for(auto cursor = rtxn->openViewCursor<Colored2DPoint>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        sum += cursor->get().get<float>(PROPERTY(Colored2DPoint, x));
+        cursor->next();
+      });
     }
-    assert(count == 1000);
+    rtxn->end();
+    assert(sum > 0);
+  });
 
+  auto randomLoads = [&]() {
+    auto rtxn = kv->beginRead();
+    uint64_t seed = 42;
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        auto loaded = rtxn->getObject<Colored2DPoint>(randomId(seed, size));
+        assert(loaded);
+      });
+    }
     rtxn->end();
-  }
-  {
-    //append more test data.
-    vector<double> vect;
+  };
+  bench.run("embedded.load", randomLoads);
+
+  unsigned cacheOwner = 0;
+  bench.run("embedded.load_cached", randomLoads,
+            [&]() {cacheOwner = kv->setCache<Colored2DPoint>(true);},
+            [&]() {kv->setCache<Colored2DPoint>(false, cacheOwner);});
+}
 
-    for(unsigned i=1; i<1001; i++)
-      vect.push_back(5.66 * i);
+//embedded object vectors, keyed properties and object pointer vectors
+void benchPropertyStorage(Bench &bench, KeyValueStore *kv)
+{
+  const size_t size = bench.size() / 10;
 
+  bench.run("embedded_vector.write", [&]() {
     auto wtxn = kv->beginWrite();
-    wtxn->appendValueCollection(collectionId, vect);
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        ColoredPolygon polygon;
+        polygon.visible = true;
+        for(int j=0; j<10; j++) polygon.pts.push_back(Colored2DPoint(i, j, 1, 1, 1, 1));
+        wtxn->putObject(polygon);
+      });
+    }
     wtxn->commit();
-  }
-  /*{
-    //load saved collection
+  });
+
+  bench.run("embedded_vector.scan", [&]() {
     auto rtxn = kv->beginRead();
-    vector<double> loaded = rtxn->getValueCollection<double>(collectionId);
-    assert(loaded.size() == 2000);
+    for(auto cursor = rtxn->openCursor<ColoredPolygon>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        auto polygon = cursor->get();
+        assert(polygon->pts.size() == 10);
+        cursor->next();
+      });
+    }
     rtxn->end();
-  }*/
-  {
-    //use appender to add more test data
+  });
+
+  bench.run("keyed.write", [&]() {
     auto wtxn = kv->beginWrite();
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        SomethingWithAllValueKeyedProperties obj;
+        obj.name = "keyed";
+        obj.counter = (int)i;
+        for(int j=0; j<10; j++) obj.numbers.push_back(j);
+        obj.children.insert("child");
+        wtxn->putObject(obj);
+      });
+    }
+    wtxn->commit();
+  });
 
-    auto appender = wtxn->appendValueCollection<double>(collectionId);
-    for(int i=0; i<1000; i++) appender->put(6.55 * i);
-    appender->close();
+  bench.run("keyed.scan", [&]() {
+    auto rtxn = kv->beginRead();
+    for(auto cursor = rtxn->openCursor<SomethingWithAllValueKeyedProperties>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        auto obj = cursor->get();
+        assert(obj->numbers.size() == 10);
+        cursor->next();
+      });
+    }
+    rtxn->end();
+  });
 
+  bench.run("ptr_vector.write", [&]() {
+    auto wtxn = kv->beginWrite();
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        RefCountingTest obj;
+        obj.fso = make_obj<FixedSizeObject>(i, i);
+        obj.vso = make_obj<VariableSizeObject>(i, "ptr_vector");
+        for(unsigned j=0; j<10; j++) obj.fso_vect.push_back(make_obj<FixedSizeObject>(i, j));
+        wtxn->putObject(obj);
+      });
+    }
     wtxn->commit();
-  }
-  {
-    //load saved collection
+  });
+
+  bench.run("ptr_vector.scan", [&]() {
     auto rtxn = kv->beginRead();
-    vector<double> loaded = rtxn->getValueCollection<double>(collectionId);
-    assert(loaded.size() == 3000);
+    for(auto cursor = rtxn->openCursor<RefCountingTest>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        auto obj = cursor->get();
+        assert(obj->fso_vect.size() == 10);
+        cursor->next();
+      });
+    }
     rtxn->end();
-  }
+  });
 }
 
-void benchColored2DPointRead(KeyValueStore *kv)
+//objects from a 4-level class hierarchy, saved through a base class reference
+void benchHierarchy(Bench &bench, KeyValueStore *kv)
 {
-  BEG()
-  auto rtxn = kv->beginRead();
-  long count = 0;
-  ObjectKey key;
-  for(auto cursor = rtxn->openCursor<Colored2DPoint>(); !cursor->atEnd(); cursor->next()) {
-    Colored2DPoint *loaded = cursor->get(key);
+  const size_t size = bench.size();
 
-    if(loaded) {
-      count++;
-      delete loaded;
+  bench.run("hierarchy.write", [&]() {
+    auto wtxn = kv->beginWrite();
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        SomethingVirtual3 obj(i, "hierarchy", "Benchmarking", 42);
+        SomethingVirtual &base = obj;
+        wtxn->putObject(base);
+      });
     }
-  }
-  rtxn->end();
-  assert(count == rounds);
-  DUR()
+    wtxn->commit();
+  });
+
+  bench.run("hierarchy.scan", [&]() {
+    auto rtxn = kv->beginRead();
+    size_t count = 0;
+    for(auto cursor = rtxn->openCursor<SomethingVirtual3>(); !cursor->atEnd(); ) {
+      bench.op([&]() {
+        auto obj = cursor->get();
+        if(obj->age == 42) count++;
+        cursor->next();
+      });
+    }
+    rtxn->end();
+    assert(count >= size);
+  });
 }
 
-void benchDataCollection(KeyValueStore *kv)
+//chunked top-level collections
+void benchCollections(Bench &bench, KeyValueStore *kv)
 {
-  ObjectId collectionId = 0;
-  {
-    BEG()
+  const size_t size = bench.size();
+  vector<ObjectId> collectionIds;
+
+  auto deleteCollections = [&]() {
     auto wtxn = kv->beginWrite();
+    for(ObjectId id : collectionIds) wtxn->deleteCollection(id);
+    wtxn->commit();
+    collectionIds.clear();
+  };
 
-    long long buf[200];
-    auto appender = wtxn->appendDataCollection<long long>(collectionId, kv->getOptimalChunkSize());
-    for(unsigned i=0; i<1000; i++) {
-      for(auto j=0; j<200; j++) buf[j] = i;
-      appender->put(buf, 200);
+  bench.run("object_collection.append", [&]() {
+    auto wtxn = kv->beginWrite();
+    ObjectId collectionId = 0;
+    auto appender = wtxn->appendCollection<FixedSizeObject>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {appender->put(make_shared<FixedSizeObject>(i, i+1));});
     }
-
     appender->close();
+    wtxn->commit();
+    collectionIds.push_back(collectionId);
+  }, nullptr, deleteCollections);
 
+  ObjectId collectionId = 0;
+  auto appendObjects = [&]() {
+    auto wtxn = kv->beginWrite();
+    auto appender = wtxn->appendCollection<FixedSizeObject>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i++) appender->put(make_shared<FixedSizeObject>(i, i+1));
+    appender->close();
     wtxn->commit();
-    DUR()
-  }
-  {
-    BEG()
+    collectionIds.push_back(collectionId);
+  };
+  bench.run("object_collection.scan", [&]() {
     auto rtxn = kv->beginRead();
+    auto cursor = rtxn->openCursor<FixedSizeObject>(collectionId);
+    bool more = true;
+    while(more) {
+      bench.op([&]() {
+        FixedSizeObject *fso = cursor->get();
+        if(fso) assert(fso->number2 == fso->number1 + 1);
+        else more = false;
+        delete fso;
+      });
+    }
+    rtxn->end();
+  }, appendObjects, deleteCollections);
 
-    for(unsigned i=0; i<500; i++) {
-      long long *data = nullptr;
-      bool owned = false;
-      rtxn->getDataCollection(collectionId, i*400, 400, data, &owned);
+  //same scan over lz-compressed chunks
+  auto appendCompressed = [&]() {
+    auto wtxn = kv->beginWrite();
+    collectionId = 0;
+    wtxn->setCollectionCodec(collectionId, ChunkCodec::lz);
+    auto appender = wtxn->appendCollection<FixedSizeObject>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i++) appender->put(make_shared<FixedSizeObject>(i, i+1));
+    appender->close();
+    wtxn->commit();
+    collectionIds.push_back(collectionId);
+  };
+  bench.run("object_collection.scan_lz", [&]() {
+    auto rtxn = kv->beginRead();
+    auto cursor = rtxn->openCursor<FixedSizeObject>(collectionId);
+    bool more = true;
+    while(more) {
+      bench.op([&]() {
+        FixedSizeObject *fso = cursor->get();
+        if(fso) assert(fso->number2 == fso->number1 + 1);
+        else more = false;
+        delete fso;
+      });
+    }
+    rtxn->end();
+  }, appendCompressed, deleteCollections);
 
-      assert(data[0] == i*2 && data[399] == i*2+1);
-      if(owned) free(data);
+  bench.run("value_collection.append", [&]() {
+    auto wtxn = kv->beginWrite();
+    ObjectId collectionId = 0;
+    auto appender = wtxn->appendValueCollection<double>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {appender->put(1.44 * i);});
     }
+    appender->close();
+    wtxn->commit();
+    collectionIds.push_back(collectionId);
+  }, nullptr, deleteCollections);
 
+  collectionId = 0;
+  bench.run("value_collection.scan", [&]() {
+    auto rtxn = kv->beginRead();
+    auto cursor = rtxn->openValueCursor<double>(collectionId);
+    bool more = true;
+    while(more) {
+      bench.op([&]() {
+        double val;
+        more = cursor->get(val);
+      });
+    }
     rtxn->end();
-    DUR()
-  }
-  {
+  }, [&]() {
+    vector<double> vect;
+    for(size_t i=0; i<size; i++) vect.push_back(1.44 * i);
     auto wtxn = kv->beginWrite();
-    wtxn->deleteCollection(collectionId);
+    collectionId = wtxn->putValueCollection(vect);
     wtxn->commit();
+    collectionIds.push_back(collectionId);
+  }, deleteCollections);
 
+  //whole-collection loads, sequential and chunk-parallel
+  auto appendValues = [&]() {
+    auto wtxn = kv->beginWrite();
+    collectionId = 0;
+    auto appender = wtxn->appendValueCollection<double>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size * 10; i++) appender->put(1.44 * i);
+    appender->close();
+    wtxn->commit();
+    collectionIds.push_back(collectionId);
+  };
+  bench.run("value_collection.load", [&]() {
     auto rtxn = kv->beginRead();
-    CollectionInfo *ci = rtxn->getCollectionInfo(collectionId, false);
-    assert(!ci);
+    bench.op([&]() {
+      vector<double> values = rtxn->getValueCollection<double>(collectionId);
+      assert(values.size() == size * 10);
+    });
     rtxn->end();
-  }
+  }, appendValues, deleteCollections);
+  bench.run("value_collection.load_parallel", [&]() {
+    bench.op([&]() {
+      vector<double> values = kv->parallelLoad().getValueCollection<double>(collectionId);
+      assert(values.size() == size * 10);
+    });
+  }, appendValues, deleteCollections);
 }
 
-void benchObjectCollection(KeyValueStore *kv)
+//raw data collections
+void benchDataCollections(Bench &bench, KeyValueStore *kv)
 {
+  const size_t size = bench.size() * 10;
+  static const size_t window = 400;
   ObjectId collectionId = 0;
-  {
-    BEG()
-    auto wtxn = kv->beginWrite();
 
-    auto appender = wtxn->appendCollection<FixedSizeObject>(collectionId, kv->getOptimalChunkSize());
-    for(unsigned i=0; i<25000; i++) {
-      auto fso = make_shared<FixedSizeObject>(i, i+1);
-      appender->put(fso);
+  auto appendData = [&]() {
+    auto wtxn = kv->beginWrite();
+    collectionId = 0;
+    float buf[1000];
+    auto appender = wtxn->appendDataCollection<float>(collectionId, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i+=1000) {
+      for(size_t j=0; j<1000; j++) buf[j] = (float)((i + j) % 9973) * 0.5f;
+      appender->put(buf, 1000);
     }
-
     appender->close();
-
     wtxn->commit();
-    DUR()
-  }
-  {
-    BEG()
-    auto rtxn = kv->beginRead();
+  };
+  auto deleteData = [&]() {
+    auto wtxn = kv->beginWrite();
+    wtxn->deleteCollection(collectionId);
+    wtxn->commit();
+  };
 
-    auto cursor = rtxn->openCursor<FixedSizeObject>(collectionId);
-    size_t count = 0;
-    while(auto fso = cursor->get()) {
-      count++;
-      assert(fso->number2 == fso->number1+1);
-      delete fso;
+  vector<ObjectId> appended;
+  bench.run("data_collection.append", [&]() {
+    auto wtxn = kv->beginWrite();
+    ObjectId id = 0;
+    float buf[1000];
+    auto appender = wtxn->appendDataCollection<float>(id, kv->getOptimalChunkSize());
+    for(size_t i=0; i<size; i+=1000) {
+      for(size_t j=0; j<1000; j++) buf[j] = (float)((i + j) % 9973) * 0.5f;
+      bench.op([&]() {appender->put(buf, 1000);});
     }
-    assert(count == 25000);
-    rtxn->end();
-    DUR()
-  }
-  {
+    appender->close();
+    wtxn->commit();
+    appended.push_back(id);
+  }, nullptr, [&]() {
     auto wtxn = kv->beginWrite();
-    wtxn->deleteCollection(collectionId);
+    for(ObjectId id : appended) wtxn->deleteCollection(id);
     wtxn->commit();
+  });
 
+  bench.run("data_collection.read", [&]() {
     auto rtxn = kv->beginRead();
-    CollectionInfo *ci = rtxn->getCollectionInfo(collectionId, false);
-    assert(!ci);
+    for(size_t i=0; i + window <= size; i += window) {
+      bench.op([&]() {
+        float *data = nullptr;
+        bool owned = false;
+        rtxn->getDataCollection(collectionId, i, window, data, &owned);
+        assert(data[0] == (float)(i % 9973) * 0.5f);
+        if(owned) free(data);
+      });
+    }
     rtxn->end();
-  }
-}
+  }, appendData, deleteData);
 
-//raw LMDB tests
-//////////////////
-
-//write Colored2DPoint w/ integer key + raw copying
-void test_lmdb_write()
-{
-  auto env = ::lmdb::env::create();
-  size_t sz = size_t(1) * size_t(1024) * size_t(1024) * size_t(1024); //1 GiB
-  env.set_mapsize(sz);
-  env.open(".", MDB_NOLOCK, 0664);
+  //the kernels against plain loops over the loaded collection
+  bench.run("data_collection.summarize_naive", [&]() {
+    auto rtxn = kv->beginRead();
+    bench.op([&]() {
+      float *data = nullptr;
+      bool owned = false;
+      rtxn->getDataCollection(collectionId, 0, size, data, &owned);
+
+      float mn = data[0], mx = data[0];
+      double sum = 0;
+      for(size_t i=0; i<size; i++) {
+        if(data[i] < mn) mn = data[i];
+        if(data[i] > mx) mx = data[i];
+        sum += data[i];
+      }
+      if(owned) free(data);
+      assert(mn <= mx && sum > 0);
+    });
+    rtxn->end();
+  }, appendData, deleteData);
 
-  BEG()
-  auto wtxn = ::lmdb::txn::begin(env);
-  auto dbi = ::lmdb::dbi::open(wtxn, nullptr, MDB_INTEGERKEY);
+  bench.run("data_collection.summarize", [&]() {
+    auto rtxn = kv->beginRead();
+    bench.op([&]() {
+      auto summary = rtxn->summarizeDataCollection<float>(collectionId);
+      assert(summary.count == size);
+    });
+    rtxn->end();
+  }, appendData, deleteData);
 
-  for(size_t i=0; i< rounds; i++) {
-    ::lmdb::val kval;
-    kval.assign(&i, sizeof(i));
+  bench.run("data_collection.filter_naive", [&]() {
+    auto rtxn = kv->beginRead();
+    bench.op([&]() {
+      float *data = nullptr;
+      bool owned = false;
+      rtxn->getDataCollection(collectionId, 0, size, data, &owned);
 
-    Colored2DPoint p;
-    p.set(2.0f+i, 3.0f+i, 4.0f+i, 5.0f+i, 6.0f+i, 7.5f+i);
-    ::lmdb::val dval;
-    dval.assign(&p, sizeof(p));
+      vector<size_t> above;
+      for(size_t i=0; i<size; i++) if(data[i] > 2000.0f) above.push_back(i);
+      if(owned) free(data);
+      assert(!above.empty());
+    });
+    rtxn->end();
+  }, appendData, deleteData);
 
-    dbi.put(wtxn, kval, dval, MDB_APPEND);
-  }
+  bench.run("data_collection.filter", [&]() {
+    auto rtxn = kv->beginRead();
+    bench.op([&]() {
+      auto above = rtxn->filterDataCollection<float>(collectionId, 2000.0f);
+      assert(!above.empty());
+    });
+    rtxn->end();
+  }, appendData, deleteData);
+}
 
-  wtxn.commit();
-  DUR()
+//concurrent producers writing one object at a time, with a transaction per write serialized by a mutex and
+//through the group-commit write queue. One op is the complete batch, from starting the producers to the last commit
+void benchTransactions(Bench &bench, KeyValueStore *kv)
+{
+  const unsigned producers = 4;
+  const size_t perProducer = bench.size() / 40;
+
+  bench.run("txn.write_mutex", [&]() {
+    bench.op([&]() {
+      mutex writeMutex;
+      vector<thread> threads;
+      for(unsigned t=0; t<producers; t++) {
+        threads.push_back(thread([&]() {
+          for(size_t i=0; i<perProducer; i++) {
+            lock_guard<mutex> lock(writeMutex);
+            auto wtxn = kv->beginWrite();
+            FixedSizeObject fso(i, i);
+            wtxn->putObject(fso);
+            wtxn->commit();
+          }
+        }));
+      }
+      for(auto &thread : threads) thread.join();
+    });
+  });
+
+  bench.run("txn.write_queue", [&]() {
+    bench.op([&]() {
+      WriteQueue queue(*kv);
+      vector<thread> threads;
+      for(unsigned t=0; t<producers; t++) {
+        threads.push_back(thread([&]() {
+          vector<future<ObjectKey>> futures;
+          for(size_t i=0; i<perProducer; i++) futures.push_back(queue.put(FixedSizeObject(i, i)));
+          for(auto &f : futures) f.get();
+        }));
+      }
+      for(auto &thread : threads) thread.join();
+    });
+  });
 }
 
-//read + verify
-void test_lmdb_read()
+//many short read transactions, as issued by request-driven applications, with and without read transaction pooling
+void benchReadPooling(Bench &bench)
 {
-  auto env = ::lmdb::env::create();
-  size_t sz = size_t(1) * size_t(1024) * size_t(1024) * size_t(1024); //1 GiB
-  env.set_mapsize(sz);
-  env.open(".", MDB_NOLOCK, 0664);
-
-  BEG()
-  auto rtxn = ::lmdb::txn::begin(env, nullptr, MDB_RDONLY);
-  auto dbi = ::lmdb::dbi::open(rtxn, nullptr, MDB_INTEGERKEY);
-
-  auto cursor = ::lmdb::cursor::open(rtxn, dbi);
-  size_t k = 0;
-  ::lmdb::val kval;
-  kval.assign(&k, sizeof(k));
-
-  long count = 0;
-  if(cursor.get(kval, MDB_SET_RANGE)) {
-    do {
-      Colored2DPoint *pd = kval.data<Colored2DPoint>();
-      if(pd) {
-        Colored2DPoint *p = new Colored2DPoint();
-        p->set(pd->x, pd->y, pd->r, pd->g, pd->b, pd->a);
-
-        count++;
-        delete p;
+  const size_t size = bench.size() / 10;
+  const unsigned poolSizes[] = {16, 0};
+  const char *names[] = {"txn.short_read_pooled", "txn.short_read_unpooled"};
+
+  for(int p=0; p<2; p++) {
+    remove("bench-pool");
+    remove("bench-pool-lock");
+    KeyValueStore *kv = lolmdb::KeyValueStore::Factory{3, ".", "bench-pool",
+                                                       lolmdb::KeyValueStore::Options(1024).setReadPoolSize(poolSizes[p])};
+    kv->putSchema<Colored2DPoint>();
+    {
+      auto wtxn = kv->beginWrite();
+      for(size_t i=0; i<size; i++) {
+        Colored2DPoint pt(i, i, 0, 0, 0, 0);
+        wtxn->putObject(pt);
+      }
+      wtxn->commit();
+    }
+    bench.run(names[p], [&]() {
+      uint64_t seed = 7;
+      for(size_t i=0; i<size; i++) {
+        bench.op([&]() {
+          auto rtxn = kv->beginRead();
+          auto loaded = rtxn->getObject<Colored2DPoint>(randomId(seed, size));
+          assert(loaded);
+          rtxn->end();
+        });
       }
-    } while(cursor.get(kval, MDB_NEXT));
+    });
+    delete kv;
   }
-  cursor.close();
-
-  assert(count == rounds);
-  rtxn.abort();
-  DUR()
+  remove("bench-pool");
+  remove("bench-pool-lock");
 }
 
-//test writing chunks of 0.5 MB
-void test_lmdb_write2()
+//object collections in the fixed and compact store formats. Prints the collection size in bytes
+void benchStoreFormats(Bench &bench)
 {
-  auto env = ::lmdb::env::create();
-  size_t sz = size_t(10) * size_t(1024) * size_t(1024) * size_t(1024); //1 GiB
-  env.set_mapsize(sz);
-  env.open(".", MDB_NOLOCK, 0664);
-
-  BEG()
-
-  auto wtxn = ::lmdb::txn::begin(env);
-  auto dbi = ::lmdb::dbi::open(wtxn, nullptr, MDB_INTEGERKEY);
-  for(size_t i=1; i < 20001; i++) {
-
-    ::lmdb::val kval, dval;
-    kval.assign(&i, sizeof(i));
+  const size_t size = bench.size();
+  const StoreFormat formats[] = {StoreFormat::fixed, StoreFormat::compact};
+  const char *names[] = {"fixed", "compact"};
+
+  for(int f=0; f<2; f++) {
+    string file = string("bench-") + names[f];
+    remove(file.c_str());
+    remove((file + "-lock").c_str());
+
+    KeyValueStore *kv = lolmdb::KeyValueStore::Factory{StoreId(1 + f), ".", file,
+                                                       lolmdb::KeyValueStore::Options(1024).setFormat(formats[f])};
+    kv->putSchema<FixedSizeObject>();
+
+    ObjectId collectionId = 0;
+    size_t bytes = 0;
+    bench.run(string("format.") + names[f] + ".append", [&]() {
+      auto wtxn = kv->beginWrite();
+      if(collectionId) wtxn->deleteCollection(collectionId);
+      collectionId = 0;
+      size_t before = wtxn->stats().bytesWritten;
+      auto appender = wtxn->appendCollection<FixedSizeObject>(collectionId, kv->getOptimalChunkSize());
+      for(size_t i=0; i<size; i++) {
+        bench.op([&]() {appender->put(make_shared<FixedSizeObject>(i, i+1));});
+      }
+      appender->close();
+      bytes = wtxn->stats().bytesWritten - before;
+      wtxn->commit();
+    });
+    bench.run(string("format.") + names[f] + ".scan", [&]() {
+      auto rtxn = kv->beginRead();
+      auto cursor = rtxn->openCursor<FixedSizeObject>(collectionId);
+      bool more = true;
+      while(more) {
+        bench.op([&]() {
+          FixedSizeObject *fso = cursor->get();
+          if(fso) assert(fso->number2 == fso->number1 + 1);
+          else more = false;
+          delete fso;
+        });
+      }
+      rtxn->end();
+    });
+    if(bytes) cout << left << setw(30) << (string("format.") + names[f] + ".bytes") << right << setw(12) << bytes << endl;
 
-    char buf[1024 * 512];
-    memset(buf, 'x', 1024 * 512);
-    dval.assign(buf, 1024 * 512);
+    delete kv;
+    remove(file.c_str());
+    remove((file + "-lock").c_str());
+  }
+}
 
-    dbi.put(wtxn, kval, dval, 0);
+//small commits under the durability modes. The relaxed modes leave syncing to the background thread
+void benchDurability(Bench &bench)
+{
+  using Durability = lolmdb::KeyValueStore::Durability;
+  const size_t size = bench.size() / 100;
+  const Durability modes[] = {Durability::full, Durability::noMetaSync, Durability::noSync};
+  const char *names[] = {"full", "nometasync", "nosync"};
+
+  for(int m=0; m<3; m++) {
+    remove("bench-durability");
+    remove("bench-durability-lock");
+
+    KeyValueStore *kv = lolmdb::KeyValueStore::Factory{3, ".", "bench-durability",
+                                                       lolmdb::KeyValueStore::Options(1024).setDurability(modes[m])};
+    kv->putSchema<FixedSizeObject>();
+
+    bench.run(string("durability.") + names[m] + ".commit", [&]() {
+      for(size_t i=0; i<size; i++) {
+        bench.op([&]() {
+          auto wtxn = kv->beginWrite();
+          FixedSizeObject obj(i, i);
+          wtxn->putObject(obj);
+          wtxn->commit();
+        });
+      }
+    });
+    if(modes[m] != Durability::full) {
+      //the outstanding syncs are not waited for
+      bench.run(string("durability.") + names[m] + ".commit_async", [&]() {
+        for(size_t i=0; i<size; i++) {
+          bench.op([&]() {
+            auto wtxn = kv->beginWrite();
+            FixedSizeObject obj(i, i);
+            wtxn->putObject(obj);
+            wtxn->commitAsync();
+          });
+        }
+      });
+    }
+    delete kv;
   }
-  wtxn.commit();
+  remove("bench-durability");
+  remove("bench-durability-lock");
+}
 
-  DUR()
+//initial import of new objects, through plain write transactions and through the bulk load append path
+void benchBulkLoad(Bench &bench)
+{
+  const size_t size = bench.size() * 10;
+  vector<FixedSizeObject> objects;
+  objects.reserve(size);
+  for(size_t i=0; i<size; i++) objects.push_back(FixedSizeObject(i, i));
+
+  for(int bulk=0; bulk<2; bulk++) {
+    size_t bytes = 0;
+    bench.run(bulk ? "bulk.put_objects" : "bulk.put_object", [&]() {
+      remove("bench-bulk");
+      remove("bench-bulk-lock");
+      KeyValueStore *kv = lolmdb::KeyValueStore::Factory{3, ".", "bench-bulk"};
+      kv->putSchema<FixedSizeObject>();
+
+      auto wtxn = bulk ? kv->beginBulkLoad() : kv->beginWrite();
+      for(size_t i=0; i<size; i+=1000) {
+        bench.op([&]() {
+          if(bulk) wtxn->putObjects(objects.begin() + i, objects.begin() + i + 1000);
+          else for(size_t j=i; j<i+1000; j++) wtxn->putObject(objects[j]);
+        });
+      }
+      wtxn->commit();
+      wtxn.reset();
+      delete kv;
+
+      ifstream file("bench-bulk", ios::binary | ios::ate);
+      bytes = (size_t)file.tellg();
+    });
+    cout << left << setw(30) << (bulk ? "bulk.put_objects.bytes" : "bulk.put_object.bytes") << right << setw(12) << bytes << endl;
+  }
+  remove("bench-bulk");
+  remove("bench-bulk-lock");
 }
 
-//test writing chunks of 0.5 MB, using MDB_RESERVE to avoid memcpying
-void test_lmdb_write2a()
+//byte-by-byte integer encoding, as used before the fixed-width fast path. Baseline for benchIntegers
+template<typename T>
+static void write_integer_bytewise(byte_t *ptr, T val, size_t bytes)
 {
-  auto env = ::lmdb::env::create();
-  size_t sz = size_t(10) * size_t(1024) * size_t(1024) * size_t(1024); //1 GiB
-  env.set_mapsize(sz);
-  env.open(".", MDB_NOLOCK, 0664);
+  for(size_t i=0, f=bytes-1; i<bytes; i++, f--) ptr[i] = (byte_t)(val >> (f * 8));
+}
+template<typename T>
+static T read_integer_bytewise(const byte_t *ptr, size_t bytes)
+{
+  T val = (T)0;
+  for(size_t i=0, f=bytes-1; i<bytes; i++, f--) val += ((T)ptr[i] << (f * 8));
+  return val;
+}
 
-  BEG()
+//integer property encoding without store access. One operation encodes or decodes 1000 records shaped like the
+//integer part of ValueTest and the collection object headers (int, classId, objectId, size)
+void benchIntegers(Bench &bench)
+{
+  const size_t records = 1000, recordSize = 4 + ClassId_sz + ObjectId_sz + 4;
+  const size_t size = bench.size() / 100;
+  vector<byte_t> data(records * recordSize);
+  volatile uint64_t sink = 0;
+
+  bench.run("integers.encode_bytewise", [&]() {
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        byte_t *p = data.data();
+        for(size_t r=0; r<records; r++) {
+          write_integer_bytewise<int>(p, (int)(r - 500), 4); p += 4;
+          write_integer_bytewise<ClassId>(p, (ClassId)r, ClassId_sz); p += ClassId_sz;
+          write_integer_bytewise<ObjectId>(p, (ObjectId)(r * 7), ObjectId_sz); p += ObjectId_sz;
+          write_integer_bytewise<size_t>(p, r * 13, 4); p += 4;
+        }
+        sink = sink + data[records];
+      });
+    }
+  });
+
+  bench.run("integers.encode", [&]() {
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        WriteBuf buf(data.data(), data.size());
+        for(size_t r=0; r<records; r++) {
+          int number = (int)(r - 500);
+          ValueTraits<int>::putBytes(buf, number);
+          buf.appendInteger<ClassId_sz>((ClassId)r);
+          buf.appendInteger<ObjectId_sz>((ObjectId)(r * 7));
+          buf.appendInteger<4>(r * 13);
+        }
+        sink = sink + data[records];
+      });
+    }
+  });
+
+  bench.run("integers.decode_bytewise", [&]() {
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        const byte_t *p = data.data();
+        uint64_t sum = 0;
+        for(size_t r=0; r<records; r++) {
+          sum += read_integer_bytewise<int>(p, 4); p += 4;
+          sum += read_integer_bytewise<ClassId>(p, ClassId_sz); p += ClassId_sz;
+          sum += read_integer_bytewise<ObjectId>(p, ObjectId_sz); p += ObjectId_sz;
+          sum += read_integer_bytewise<size_t>(p, 4); p += 4;
+        }
+        sink = sink + sum;
+      });
+    }
+  });
+
+  bench.run("integers.decode", [&]() {
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        ReadBuf buf(data.data(), data.size());
+        uint64_t sum = 0;
+        for(size_t r=0; r<records; r++) {
+          int number;
+          ValueTraits<int>::getBytes(buf, number);
+          sum += number;
+          sum += buf.readInteger<ClassId, ClassId_sz>();
+          sum += buf.readInteger<ObjectId, ObjectId_sz>();
+          sum += buf.readInteger<size_t, 4>();
+        }
+        sink = sink + sum;
+      });
+    }
+  });
+}
 
-  auto wtxn = ::lmdb::txn::begin(env);
-  auto dbi = ::lmdb::dbi::open(wtxn, nullptr, MDB_INTEGERKEY);
-  for(size_t i=1; i < 20001; i++) {
+//raw LMDB baseline: Colored2DPoint copied as raw bytes under integer keys
+void benchRawLmdb(Bench &bench)
+{
+  const size_t size = bench.size();
 
-    ::lmdb::val kval{&i, sizeof(i)};
-    ::lmdb::val dval{nullptr, 1024 * 512};
+  remove("bench-raw");
+  auto env = ::lmdb::env::create();
+  env.set_mapsize(size_t(1) * size_t(1024) * size_t(1024) * size_t(1024)); //1 GiB
+  env.open("bench-raw", MDB_NOSUBDIR | MDB_NOLOCK, 0664);
+
+  bench.run("lmdb_raw.write", [&]() {
+    auto wtxn = ::lmdb::txn::begin(env);
+    auto dbi = ::lmdb::dbi::open(wtxn, nullptr, MDB_INTEGERKEY);
+    dbi.drop(wtxn);
+    for(size_t i=0; i<size; i++) {
+      bench.op([&]() {
+        Colored2DPoint p(2.0f+i, 3.0f+i, 4.0f+i, 5.0f+i, 6.0f+i, 7.5f+i);
+        ::lmdb::val kval {&i, sizeof(i)};
+        ::lmdb::val dval {&p, sizeof(p)};
+        dbi.put(wtxn, kval, dval, MDB_APPEND);
+      });
+    }
+    wtxn.commit();
+  });
 
-    dbi.put(wtxn, kval, dval, MDB_RESERVE);
+  bench.run("lmdb_raw.scan", [&]() {
+    auto rtxn = ::lmdb::txn::begin(env, nullptr, MDB_RDONLY);
+    auto dbi = ::lmdb::dbi::open(rtxn, nullptr, MDB_INTEGERKEY);
+    auto cursor = ::lmdb::cursor::open(rtxn, dbi);
 
-    memset(dval.data(), 'x', 1024 * 512);
-  }
-  wtxn.commit();
+    ::lmdb::val kval, dval;
+    bool more = cursor.get(kval, dval, MDB_FIRST);
+    while(more) {
+      bench.op([&]() {
+        const Colored2DPoint *pd = dval.data<Colored2DPoint>();
+        Colored2DPoint *p = new Colored2DPoint(pd->x, pd->y, pd->r, pd->g, pd->b, pd->a);
+        delete p;
+        more = cursor.get(kval, dval, MDB_NEXT);
+      });
+    }
+    cursor.close();
+    rtxn.abort();
+  });
 
-  DUR()
+  env.close();
+  remove("bench-raw");
 }
 
-//read & verify
-void test_lmdb_read2()
+int main(int argc, char *argv[])
 {
-  auto env = ::lmdb::env::create();
-  size_t sz = size_t(10) * size_t(1024) * size_t(1024) * size_t(1024); //1 GiB
-  env.set_mapsize(sz);
-  env.open(".", MDB_NOLOCK, 0664);
-
-  BEG()
-  auto rtxn = ::lmdb::txn::begin(env, nullptr, MDB_RDONLY);
-  auto dbi = ::lmdb::dbi::open(rtxn, nullptr, MDB_INTEGERKEY);
-
-  auto cursor = ::lmdb::cursor::open(rtxn, dbi);
-  size_t k = 1;
-  ::lmdb::val kval, dval;
-  kval.assign(&k, sizeof(k));
-
-  long count = 0;
-  if(cursor.get(kval, dval, MDB_SET)) {
-    do {
-      //cursor.get(kval, dval, MDB_GET_CURRENT);
-      assert(dval.size() == 1024 * 512 && dval.data()[0] == 'x');
-      count++;
-    } while(cursor.get(kval, dval, MDB_NEXT));
+  BenchOptions options;
+  for(int i=1; i<argc; i++) {
+    string arg = argv[i];
+    const char *val = i+1 < argc ? argv[i+1] : nullptr;
+
+    if(arg == "--size" && val) {options.size = strtoul(val, nullptr, 10); i++;}
+    else if(arg == "--warmup" && val) {options.warmup = (unsigned)strtoul(val, nullptr, 10); i++;}
+    else if(arg == "--repetitions" && val) {options.repetitions = (unsigned)strtoul(val, nullptr, 10); i++;}
+    else if(arg == "--filter" && val) {options.filter = val; i++;}
+    else if(arg == "--json" && val) {options.jsonFile = val; i++;}
+    else {
+      cerr << "usage: " << argv[0]
+           << " [--size N] [--warmup N] [--repetitions N] [--filter substring] [--json file|-]" << endl;
+      return 1;
+    }
   }
-  cursor.close();
+  if(options.size < 1000) options.size = 1000;
 
-  assert(count == 20000);
-  rtxn.abort();
-  DUR()
-}
+  Bench bench(options);
 
-int main()
-{
-#if 1
+  remove("bench");
+  remove("bench-lock");
   KeyValueStore *kv = lolmdb::KeyValueStore::Factory{0, ".", "bench"};
-
-  kv->putSchema<Colored2DPoint, ColoredPolygon, FixedSizeObject>();
-
-  benchColored2DPointWrite(kv);
-  benchColored2DPointRead(kv);
-  benchValueCollection(kv);
-  benchDataCollection(kv);
-  benchObjectCollection(kv);
+  kv->putSchema<Colored2DPoint,
+      ColoredPolygon,
+      FixedSizeObject,
+      VariableSizeObject,
+      RefCountingTest,
+      SomethingWithAllValueKeyedProperties,
+      SomethingVirtual,
+      SomethingVirtual1,
+      SomethingVirtual2,
+      SomethingVirtual3>();
+
+  benchEmbedded(bench, kv);
+  benchPropertyStorage(bench, kv);
+  benchHierarchy(bench, kv);
+  benchCollections(bench, kv);
+  benchDataCollections(bench, kv);
+  benchTransactions(bench, kv);
 
   delete kv;
 
-  //test_lmdb_write();
-  //test_lmdb_read();
-#endif
-#if 0
+  benchReadPooling(bench);
+  benchStoreFormats(bench);
+  benchDurability(bench);
+  benchBulkLoad(bench);
+  benchIntegers(bench);
+  benchRawLmdb(bench);
 
-  test_lmdb_write2a();
-  test_lmdb_read2();
-#endif
+  bench.report();
 
+  remove("bench");
+  remove("bench-lock");
   return 0;
 }
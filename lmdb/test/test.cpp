@@ -3,7 +3,13 @@
 //
 
 #include <cassert>
+#include <cmath>
 #include <sstream>
+#include <thread>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
 #include <kvstore.h>
 #include <lmdb/lmdb_kvstore.h>
 #include "testclasses.h"
@@ -1435,6 +1441,1809 @@ void testCompatibleDatabase(ObjectKey key)
   delete kv;
 }
 
+void testObjectCache(KeyValueStore *kv)
+{
+  vector<ObjectId> ids;
+  unsigned owner = kv->setCache<FixedSizeObject2>(true, 0, CacheOptions(8, 0, CacheEviction::lru, 2));
+  {
+    auto wtxn = kv->beginWrite();
+    for(unsigned i=0; i<32; i++) {
+      FixedSizeObject2 fso(i, i * 2);
+      ids.push_back(wtxn->putObject(fso).objectId);
+    }
+    wtxn->commit();
+  }
+  {
+    auto rtxn = kv->beginRead();
+    for(auto id : ids) {
+      auto fso = rtxn->getObject<FixedSizeObject2>(id);
+      assert(fso && fso->number2 == fso->number1 * 2);
+    }
+    CacheStats stats = kv->cacheStats<FixedSizeObject2>();
+    assert(stats.misses == 32 && stats.hits == 0 && stats.entries == 8 && stats.evictions == 24);
+
+    auto last = rtxn->getObject<FixedSizeObject2>(ids.back());
+    assert(last == rtxn->getObject<FixedSizeObject2>(ids.back()));
+    assert(kv->cacheStats<FixedSizeObject2>().hits == 2);
+    rtxn->end();
+  }
+  {
+    auto wtxn = kv->beginWrite();
+    auto last = wtxn->getObject<FixedSizeObject2>(ids.back());
+    wtxn->deleteObject(last);
+    wtxn->commit();
+    assert(kv->cacheStats<FixedSizeObject2>().entries == 7);
+  }
+
+  //byte-bounded second-chance cache
+  kv->setCache<FixedSizeObject2>(false, owner);
+  size_t maxBytes = 4 * (sizeof(FixedSizeObject2) + 2 * sizeof(double));
+  kv->setCache<FixedSizeObject2>(true, owner, CacheOptions(0, maxBytes, CacheEviction::clock, 1));
+  {
+    auto rtxn = kv->beginRead();
+    auto first = rtxn->getObject<FixedSizeObject2>(ids[0]);
+    for(unsigned i=1; i<8; i++) {
+      assert(first == rtxn->getObject<FixedSizeObject2>(ids[0]));
+      rtxn->getObject<FixedSizeObject2>(ids[i]);
+    }
+    CacheStats stats = kv->cacheStats<FixedSizeObject2>();
+    assert(stats.bytes <= maxBytes && stats.entries == 4 && stats.evictions == 4);
+    rtxn->end();
+  }
+  kv->setCache<FixedSizeObject2>(false, owner);
+  assert(kv->cacheStats<FixedSizeObject2>().entries == 0);
+
+  //concurrent access
+  ObjectCache cache(CacheOptions(64));
+  vector<thread> threads;
+  for(unsigned t=0; t<4; t++) {
+    threads.push_back(thread([&cache, t]() {
+      for(ObjectId i=0; i<10000; i++) {
+        ObjectId id = (i * 7 + t) % 256;
+        auto cached = cache.get<FixedSizeObject2>(id);
+        if(cached) assert(cached->number1 == id);
+        else cache.put(id, make_shared<FixedSizeObject2>(id, t), sizeof(FixedSizeObject2), false);
+      }
+    }));
+  }
+  for(auto &t : threads) t.join();
+  CacheStats stats = cache.stats();
+  assert(stats.entries <= 64 && stats.hits + stats.misses == 40000);
+}
+
+void testReadTransactionPool(KeyValueStore *kv)
+{
+  ObjectKey key;
+  {
+    auto rtxn = kv->beginRead();
+    rtxn->end();
+    rtxn = kv->beginRead(); //dropped without end()
+  }
+  {
+    FixedSizeObject2 fso(1, 2);
+    auto wtxn = kv->beginWrite();
+    key = wtxn->putObject(fso);
+    wtxn->commit();
+  }
+  {
+    //renewed transactions must see the latest snapshot
+    auto rtxn = kv->beginRead();
+    auto loaded = rtxn->getObject<FixedSizeObject2>(key.objectId);
+    assert(loaded && loaded->number2 == 2);
+    rtxn->end();
+  }
+  {
+    auto xtxn = kv->beginExclusiveRead();
+    xtxn->end();
+
+    //write blocks are released when pooled transactions are recycled
+    auto wtxn = kv->beginWrite();
+    wtxn->deleteObject<FixedSizeObject2>(key);
+    wtxn->commit();
+  }
+}
+
+void testGetObjects(KeyValueStore *kv)
+{
+  vector<ObjectKey> keys;
+  ObjectKey rtKey;
+  {
+    RefCountingTest rt;
+    for(unsigned i=0; i<5; i++) rt.fso_vect.push_back(kv::make_obj<FixedSizeObject>(i, i * 10));
+
+    auto wtxn = kv->beginWrite();
+    wtxn->saveObject(rt, rtKey);
+    wtxn->commit();
+
+    for(auto &fso : rt.fso_vect) keys.push_back(*ClassTraits<FixedSizeObject>::getObjectKey(fso));
+  }
+  //reverse order, a duplicate and a missing key
+  vector<ObjectKey> request(keys.rbegin(), keys.rend());
+  request.push_back(keys[2]);
+  request.push_back(ObjectKey(keys[0].classId, 999999));
+  {
+    auto rtxn = kv->beginRead();
+    auto loaded = rtxn->getObjects<FixedSizeObject>(request);
+    assert(loaded.size() == 7);
+    for(unsigned i=0; i<5; i++) {
+      assert(loaded[i]->number1 == 4 - i && loaded[i]->number2 == (4 - i) * 10);
+      assert(ClassTraits<FixedSizeObject>::getObjectKey(loaded[i])->refcount == 1);
+    }
+    assert(loaded[5] == loaded[2] && !loaded[6]);
+    rtxn->end();
+  }
+  {
+    unsigned owner = kv->setCache<FixedSizeObject>();
+    auto rtxn = kv->beginRead();
+    auto first = rtxn->getObject<FixedSizeObject>(keys[1].objectId);
+    auto loaded = rtxn->getObjects<FixedSizeObject>(keys);
+    assert(loaded[1] == first && loaded[3]->number1 == 3);
+    assert(kv->cacheStats<FixedSizeObject>().hits == 1);
+    rtxn->end();
+    kv->setCache<FixedSizeObject>(false, owner);
+  }
+  auto wtxn = kv->beginWrite();
+  wtxn->deleteObject<RefCountingTest>(rtKey);
+  wtxn->commit();
+}
+
+template <typename T>
+void compareParallelScan(KeyValueStore *kv)
+{
+  vector<ObjectKey> sequential;
+  {
+    auto rtxn = kv->beginRead();
+    for(auto &obj : getInstances<T>(rtxn, kv::all_predicate<T>)) sequential.push_back(*ClassTraits<T>::getObjectKey(obj));
+    rtxn->end();
+  }
+  auto ordered = kv->parallelScan<T>(3).getInstances();
+  assert(ordered.size() == sequential.size());
+  for(size_t i=0; i<ordered.size(); i++) {
+    ObjectKey *key = ClassTraits<T>::getObjectKey(ordered[i]);
+    assert(key->classId == sequential[i].classId && key->objectId == sequential[i].objectId);
+  }
+
+  auto unordered = kv->parallelScan<T>(4).getInstances(kv::all_predicate<T>, false);
+  assert(unordered.size() == sequential.size());
+
+  atomic<size_t> count(0);
+  kv->parallelScan<T>().forEach([&count](shared_ptr<T> obj) {count++;});
+  assert(count == sequential.size());
+}
+
+void testParallelScan(KeyValueStore *kv)
+{
+  {
+    auto wtxn = kv->beginWrite();
+    for(int i=0; i<1000; i++) {
+      Colored2DPoint p;
+      p.set(i, 0, 0, 0, 0, 0);
+      wtxn->putObject(p);
+    }
+    wtxn->commit();
+  }
+  compareParallelScan<Colored2DPoint>(kv);
+  compareParallelScan<SomethingVirtual>(kv);
+
+  auto found = kv->parallelScan<Colored2DPoint>(2).getInstances(
+      [](shared_ptr<Colored2DPoint> p)->bool {return p->x >= 500;});
+  assert(found.size() >= 500);
+  for(size_t i=1; i<found.size(); i++)
+    assert(ClassTraits<Colored2DPoint>::getObjectKey(found[i-1])->objectId < ClassTraits<Colored2DPoint>::getObjectKey(found[i])->objectId);
+
+  //snapshot reads with a lock file and without read pooling
+  remove("test-snapshot");
+  remove("test-snapshot-lock");
+  KeyValueStore *skv = lmdb::KeyValueStore::Factory{3, ".", "test-snapshot", lmdb::KeyValueStore::Options(64, true).setReadPoolSize(0)};
+  skv->putSchema<Colored2DPoint>();
+  {
+    auto wtxn = skv->beginWrite();
+    for(int i=0; i<100; i++) {
+      Colored2DPoint p;
+      p.set(i, 0, 0, 0, 0, 0);
+      wtxn->putObject(p);
+    }
+    wtxn->commit();
+  }
+  {
+    auto snapshot = skv->beginSnapshotReads(3);
+    assert(snapshot.size() == 3);
+    for(auto &rtxn : snapshot) rtxn->end();
+  }
+  {
+    //snapshots agree while another thread commits continuously
+    bool stop = false;
+    mutex stopLock;
+    thread writer([&] {
+      for(int i=0; ; i++) {
+        {
+          lock_guard<mutex> lock(stopLock);
+          if(stop) break;
+        }
+        auto wtxn = skv->beginWrite();
+        Colored2DPoint p;
+        p.set(i, 0, 0, 0, 0, 0);
+        ObjectKey key = wtxn->putObject(p);
+        wtxn->commit();
+        wtxn = skv->beginWrite();
+        wtxn->deleteObject<Colored2DPoint>(key);
+        wtxn->commit();
+      }
+    });
+    for(int i=0; i<50; i++) {
+      auto snapshot = skv->beginSnapshotReads(4);
+      size_t expected = 0;
+      for(auto curs = snapshot[0]->openCursor<Colored2DPoint>(); !curs->atEnd(); curs->next()) expected++;
+      for(auto &rtxn : snapshot) {
+        size_t count = 0;
+        for(auto curs = rtxn->openCursor<Colored2DPoint>(); !curs->atEnd(); curs->next()) count++;
+        assert(count == expected);
+        rtxn->end();
+      }
+    }
+    {
+      lock_guard<mutex> lock(stopLock);
+      stop = true;
+    }
+    writer.join();
+  }
+  assert(skv->parallelScan<Colored2DPoint>(4).getInstances().size() == 100);
+  delete skv;
+  remove("test-snapshot");
+  remove("test-snapshot-lock");
+}
+
+void testObjectView(KeyValueStore *kv)
+{
+  ObjectKey key;
+  {
+    FixedSizeObject fso(7, 70);
+    auto wtxn = kv->beginWrite();
+    wtxn->saveObject(fso, key);
+    wtxn->commit();
+  }
+  {
+    auto rtxn = kv->beginExclusiveRead();
+    auto view = rtxn->getView<FixedSizeObject>(key.objectId);
+    assert(view && view.objectId() == key.objectId);
+    assert(view.get<unsigned>(PROPERTY(FixedSizeObject, number1)) == 7);
+    assert(view.get<unsigned>(PROPERTY(FixedSizeObject, number2)) == 70);
+    assert(!rtxn->getView<FixedSizeObject>(999999));
+
+    //properties of other classes and mismatched value types are refused
+    unsigned failed = 0;
+    try {
+      view.get<float>(PROPERTY(Colored2DPoint, x));
+    }
+    catch(kv::error &) {
+      failed++;
+    }
+    try {
+      view.get<double>(PROPERTY(FixedSizeObject, number2));
+    }
+    catch(kv::error &) {
+      failed++;
+    }
+    try {
+      view.get<int>(PROPERTY(FixedSizeObject, number2));
+    }
+    catch(kv::error &) {
+      failed++;
+    }
+    assert(failed == 3);
+
+    size_t count = 0, expected = 0;
+    for(auto curs = rtxn->openViewCursor<Colored2DPoint>(); !curs->atEnd(); curs->next()) {
+      auto pt = curs->get();
+      auto obj = rtxn->getObject<Colored2DPoint>(pt.objectId());
+      assert(obj->x == pt.get<float>(PROPERTY(Colored2DPoint, x)));
+      assert(obj->a == pt.get<float>(PROPERTY(Colored2DPoint, a)));
+      count++;
+    }
+    for(auto curs = rtxn->openCursor<Colored2DPoint>(); !curs->atEnd(); curs->next()) expected++;
+    assert(count > 0 && count == expected);
+    rtxn->end();
+  }
+  auto wtxn = kv->beginWrite();
+  wtxn->deleteObject<FixedSizeObject>(key);
+  wtxn->commit();
+}
+
+void testLoadColumns(KeyValueStore *kv)
+{
+  auto rtxn = kv->beginRead();
+  Column<float> x(PROPERTY(Colored2DPoint, x)), b(PROPERTY(Colored2DPoint, b));
+  size_t rows = rtxn->loadColumns<Colored2DPoint>(x, b);
+  assert(rows > 0 && x.values.size() == rows && b.values.size() == rows);
+
+  size_t row = 0;
+  for(auto curs = rtxn->openCursor<Colored2DPoint>(); !curs->atEnd(); curs->next(), row++) {
+    auto pt = curs->get();
+    assert(pt->x == x.values[row] && pt->b == b.values[row]);
+  }
+  assert(row == rows);
+
+  //the type is checked, not only the width
+  Column<double> wrongType(PROPERTY(Colored2DPoint, y));
+  Column<int> wrongSameWidth(PROPERTY(Colored2DPoint, y));
+  unsigned failed = 0;
+  try {
+    rtxn->loadColumns<Colored2DPoint>(wrongType);
+  }
+  catch(kv::error &) {
+    failed++;
+  }
+  try {
+    rtxn->loadColumns<Colored2DPoint>(wrongSameWidth);
+  }
+  catch(kv::error &) {
+    failed++;
+  }
+  assert(failed == 2);
+  rtxn->end();
+
+  //big-endian integer columns
+  vector<ObjectKey> keys;
+  {
+    auto wtxn = kv->beginWrite();
+    for(unsigned i=0; i<10; i++) {
+      FixedSizeObject fso(0x01020304 * i, i);
+      keys.push_back(wtxn->putObject(fso));
+    }
+    wtxn->commit();
+  }
+  rtxn = kv->beginRead();
+  Column<unsigned> number1(PROPERTY(FixedSizeObject, number1));
+  rows = rtxn->loadColumns<FixedSizeObject>(number1);
+  assert(rows >= keys.size() && number1.values.size() == rows);
+  row = 0;
+  for(auto curs = rtxn->openCursor<FixedSizeObject>(); !curs->atEnd(); curs->next(), row++) {
+    assert(curs->get()->number1 == number1.values[row]);
+  }
+  assert(row == rows);
+  rtxn->end();
+
+  auto wtxn = kv->beginWrite();
+  for(auto &key : keys) wtxn->deleteObject<FixedSizeObject>(key);
+  wtxn->commit();
+}
+
+#if defined(LO_KERNELS_SSE2)
+/**
+ * compare a set of vectorized kernels against the scalar templates. The data size leaves a scalar tail
+ */
+template <typename T, typename Summarize, typename Filter, typename Histogram>
+void checkKernels(const vector<T> &data, T threshold, Summarize summarize, Filter filter, Histogram histogram)
+{
+  kernels::Summary<T> expected, summary;
+  kernels::summarize<T>(data.data(), data.size(), expected);
+  summarize(data.data(), data.size(), summary);
+  assert(summary.count == expected.count && summary.min == expected.min && summary.max == expected.max);
+  assert(fabs(summary.sum - expected.sum) < 1e-6 * fabs(expected.sum) + 1e-3);
+
+  vector<size_t> expectedIndexes, indexes;
+  kernels::filterGreater<T>(data.data(), data.size(), threshold, 5, expectedIndexes);
+  filter(data.data(), data.size(), threshold, 5, indexes);
+  assert(!indexes.empty() && indexes == expectedIndexes);
+
+  //values fall below and above the range
+  vector<size_t> expectedBins(7, 0), bins(7, 0);
+  kernels::histogram<T>(data.data(), data.size(), -400, 300, expectedBins.data(), expectedBins.size());
+  histogram(data.data(), data.size(), -400, 300, bins.data(), bins.size());
+  assert(bins == expectedBins);
+}
+
+template <typename T>
+void checkKernels(const vector<T> &data, T threshold)
+{
+  checkKernels(data, threshold,
+               [](auto&&... args) {kernels::sse2::summarize(args...);},
+               [](auto&&... args) {kernels::sse2::filterGreater(args...);},
+               [](auto&&... args) {kernels::sse2::histogram(args...);});
+#if defined(LO_KERNELS_AVX2)
+  if(kernels::hasAVX2()) {
+    checkKernels(data, threshold,
+                 [](auto&&... args) {kernels::avx2::summarize(args...);},
+                 [](auto&&... args) {kernels::avx2::filterGreater(args...);},
+                 [](auto&&... args) {kernels::avx2::histogram(args...);});
+  }
+#endif
+}
+#endif
+
+void testDataKernels(KeyValueStore *kv)
+{
+  //three chunks, with values that are not in ascending order
+  vector<float> values;
+  for(unsigned i=0; i<3000; i++) values.push_back((float)((i * 37) % 1000) - 500.5f);
+  vector<int> ints(values.begin(), values.end());
+
+  ObjectId collectionId, intCollectionId;
+  {
+    auto wtxn = kv->beginWrite();
+    collectionId = wtxn->putDataCollection(values.data(), 1000);
+    wtxn->appendDataCollection(collectionId, values.data() + 1000, 1000);
+    wtxn->appendDataCollection(collectionId, values.data() + 2000, 1000);
+    intCollectionId = wtxn->putDataCollection(ints.data(), 1500);
+    wtxn->appendDataCollection(intCollectionId, ints.data() + 1500, 1500);
+    wtxn->commit();
+  }
+  auto rtxn = kv->beginRead();
+
+  //range straddles all three chunks
+  size_t start = 997, length = 2000;
+  auto summary = rtxn->summarizeDataCollection<float>(collectionId, start, length);
+  float mn = values[start], mx = values[start];
+  double sum = 0;
+  vector<size_t> filtered, bins(10, 0);
+  for(size_t i=start; i<start+length; i++) {
+    mn = std::min(mn, values[i]);
+    mx = std::max(mx, values[i]);
+    sum += values[i];
+    if(values[i] > 100.0f) filtered.push_back(i);
+    bins[std::min((size_t)9, (size_t)(((double)values[i] + 500.5) * (10 / 1000.0)))]++;
+  }
+  assert(summary.count == length && summary.min == mn && summary.max == mx);
+  assert(fabs(summary.sum - sum) < 1e-6 * fabs(sum) + 1e-3);
+  assert(rtxn->filterDataCollection<float>(collectionId, 100.0f, start, length) == filtered);
+  assert(rtxn->histogramDataCollection<float>(collectionId, -500.5, 499.5, 10, start, length) == bins);
+
+  //whole collection
+  auto isummary = rtxn->summarizeDataCollection<int>(intCollectionId);
+  assert(isummary.count == 3000);
+  assert(isummary.min == *std::min_element(ints.begin(), ints.end()));
+  assert(isummary.max == *std::max_element(ints.begin(), ints.end()));
+  assert(rtxn->filterDataCollection<int>(intCollectionId, 10000).empty());
+  rtxn->end();
+
+#if defined(LO_KERNELS_SSE2)
+  vector<float> fvalues(values.begin() + 1, values.end());
+  checkKernels(fvalues, 100.0f);
+  checkKernels(vector<double>(fvalues.begin(), fvalues.end()), 100.0);
+  checkKernels(vector<int>(fvalues.begin(), fvalues.end()), 100);
+#endif
+
+  auto wtxn = kv->beginWrite();
+  wtxn->deleteCollection(collectionId);
+  wtxn->deleteCollection(intCollectionId);
+  wtxn->commit();
+}
+
+void testWriteQueue(KeyValueStore *kv)
+{
+  vector<ObjectKey> keys(1000);
+  {
+    WriteQueue queue(*kv, WriteQueueOptions(100, std::chrono::milliseconds(5)));
+
+    vector<thread> producers;
+    for(unsigned t=0; t<4; t++) {
+      producers.push_back(thread([&queue, &keys, t]() {
+        vector<future<ObjectKey>> futures;
+        for(unsigned i=t*250; i<(t+1)*250; i++) futures.push_back(queue.put(FixedSizeObject(i, i * 2)));
+        for(unsigned i=0; i<250; i++) keys[t*250 + i] = futures[i].get();
+      }));
+    }
+    for(auto &producer : producers) producer.join();
+
+    //a failing operation must not affect the other operations in its batch
+    auto before = queue.put(FixedSizeObject(5000, 5000));
+    auto failing = queue.submit([](WriteTransaction *tr) -> ObjectId {throw kv::error("failed");});
+    auto after = queue.put(FixedSizeObject(5001, 5001));
+    queue.flush();
+
+    bool failed = false;
+    try {
+      failing.get();
+    }
+    catch(kv::error &) {
+      failed = true;
+    }
+    assert(failed);
+    keys.push_back(before.get());
+    keys.push_back(after.get());
+
+    //operations replayed after a failure start from the in-memory state of the first attempt
+    auto saved = make_obj<FixedSizeObject>(6000, 6000);
+    auto first = queue.put(FixedSizeObject(6001, 6001));
+    auto savedId = queue.save(saved);
+    queue.submit([](WriteTransaction *tr) -> ObjectId {throw kv::error("failed");});
+    auto second = queue.put(FixedSizeObject(6002, 6002));
+    queue.flush();
+
+    ObjectKey firstKey = first.get(), secondKey = second.get();
+    assert(savedId.get() == firstKey.objectId + 1 && secondKey.objectId == firstKey.objectId + 2);
+    keys.push_back(firstKey);
+    keys.push_back(*ClassTraits<FixedSizeObject>::getObjectKey(saved));
+    keys.push_back(secondKey);
+
+    //results need not be default constructible or copyable
+    struct Saved {
+      unique_ptr<ObjectKey> key;
+      explicit Saved(const ObjectKey &key) : key(new ObjectKey(key)) {}
+    };
+    auto moved = queue.submit([](WriteTransaction *tr) {
+      FixedSizeObject fso(6003, 6003);
+      return Saved(tr->putObject(fso));
+    });
+    keys.push_back(*moved.get().key);
+
+    //the writer waits for a write transaction outside the queue
+    auto external = kv->beginWrite();
+    auto waiting = queue.put(FixedSizeObject(7000, 7000));
+    this_thread::sleep_for(chrono::milliseconds(20));
+    assert(waiting.wait_for(chrono::seconds(0)) == future_status::timeout);
+    external->commit();
+    keys.push_back(waiting.get());
+  }
+  set<ObjectId> ids;
+  {
+    auto rtxn = kv->beginRead();
+    for(size_t i=0; i<keys.size(); i++) {
+      ids.insert(keys[i].objectId);
+      unique_ptr<FixedSizeObject> obj(rtxn->getObject<FixedSizeObject>(keys[i]));
+      assert(obj && obj->number2 == (i < 1000 ? 2 * i : obj->number1));
+    }
+    rtxn->end();
+  }
+  assert(ids.size() == keys.size());
+
+  WriteQueue queue(*kv);
+  vector<future<void>> removed;
+  for(auto &key : keys) {
+    removed.push_back(queue.submit([key](WriteTransaction *tr) mutable {tr->deleteObject<FixedSizeObject>(key);}));
+  }
+  for(auto &r : removed) r.get();
+}
+
+void testSecondaryIndex(KeyValueStore *kv)
+{
+  auto wtxn = kv->beginWrite();
+  for(int i=0; i<100; i++) {
+    auto obj = make_obj<IndexedObject>(string("name") + to_string(i % 10), i - 50, (i - 50) * 0.5);
+    wtxn->saveObject(obj);
+  }
+  auto sub = make_obj<IndexedObjectSub>("name3", 1000, -1000.0, 7);
+  wtxn->saveObject(sub);
+  wtxn->commit();
+
+  auto rtxn = kv->beginRead();
+
+  //equality, including the subclass instance
+  auto found = rtxn->find<IndexedObject, string>(PROPERTY(IndexedObject, name), "name3");
+  assert(found.size() == 11);
+  for(auto &obj : found) assert(obj->name == "name3");
+  auto foundSub = rtxn->find<IndexedObjectSub, string>(PROPERTY(IndexedObject, name), "name3");
+  assert(foundSub.size() == 1);
+  found = rtxn->find<IndexedObject, string>(PROPERTY(IndexedObject, name), "name");
+  assert(found.empty());
+
+  //signed integer range in value order
+  found = rtxn->find<IndexedObject, int>(PROPERTY(IndexedObject, number), -10, 9);
+  assert(found.size() == 20);
+  for(int i=0; i<20; i++) assert(found[i]->number == i - 10);
+
+  //double range across zero
+  found = rtxn->find<IndexedObject, double>(PROPERTY(IndexedObject, value), -2.5, 1.0);
+  assert(found.size() == 8);
+  for(size_t i=1; i<found.size(); i++) assert(found[i-1]->value < found[i]->value);
+  found = rtxn->find<IndexedObject, double>(PROPERTY(IndexedObject, value), -1000.0);
+  assert(found.size() == 1);
+
+  foundSub = rtxn->find<IndexedObjectSub, short>(PROPERTY(IndexedObjectSub, rank), 7);
+  assert(foundSub.size() == 1);
+
+  //wrong value type
+  bool failed = false;
+  try {
+    rtxn->find<IndexedObject, long>(PROPERTY(IndexedObject, number), 1);
+  }
+  catch(kv::error &) {
+    failed = true;
+  }
+  assert(failed);
+  rtxn->end();
+
+  //update moves the index entry, delete removes it
+  wtxn = kv->beginWrite();
+  found = wtxn->find<IndexedObject, int>(PROPERTY(IndexedObject, number), 0);
+  assert(found.size() == 1);
+  found[0]->number = 5000;
+  wtxn->saveObject(found[0]);
+  wtxn->deleteObject(sub);
+
+  found = wtxn->find<IndexedObject, int>(PROPERTY(IndexedObject, number), 0);
+  assert(found.empty());
+  found = wtxn->find<IndexedObject, int>(PROPERTY(IndexedObject, number), 5000);
+  assert(found.size() == 1);
+  found = wtxn->find<IndexedObject, string>(PROPERTY(IndexedObject, name), "name3");
+  assert(found.size() == 10);
+
+  //erase through an index cursor
+  auto curs = wtxn->openIndexCursor<IndexedObject, string>(PROPERTY(IndexedObject, name), "name1", "name2");
+  while(!curs->atEnd()) curs->erase(wtxn);
+  curs.reset();
+  found = wtxn->find<IndexedObject, string>(PROPERTY(IndexedObject, name), "name0", "name9");
+  assert(found.size() == 80);
+  assert(wtxn->getInstances<IndexedObject>().size() == 80);
+  wtxn->commit();
+
+  //erase all through a class cursor, across the class and subclass ranges. Aborted
+  wtxn = kv->beginWrite();
+  auto sub2 = make_obj<IndexedObjectSub>("name4", 2000, -2000.0, 8);
+  wtxn->saveObject(sub2);
+  size_t erased = 0;
+  for(auto ccurs = wtxn->openCursor<IndexedObject>(); !ccurs->atEnd(); erased++) ccurs->erase(wtxn);
+  assert(erased == 81);
+  assert(wtxn->getInstances<IndexedObject>().empty());
+  wtxn->abort();
+
+  //rebuild yields the same result
+  wtxn = kv->beginWrite();
+  wtxn->rebuildIndexes<IndexedObject>();
+  found = wtxn->find<IndexedObject, int>(PROPERTY(IndexedObject, number), -50, 5000);
+  assert(found.size() == 80);
+  found = wtxn->find<IndexedObject, double>(PROPERTY(IndexedObject, value), -1000.0);
+  assert(found.empty());
+  wtxn->commit();
+}
+
+void testStats(KeyValueStore *kv)
+{
+  StoreStats before = kv->stats();
+
+  ObjectId cachedId;
+  {
+    auto wtxn = kv->beginWrite();
+    for(unsigned i=0; i<10; i++) {
+      FixedSizeObject2 fso(i, i * 3);
+      wtxn->putObject(fso);
+    }
+    IndexedObject io("cached", 1, 1.0);
+    cachedId = wtxn->putObject(io).objectId;
+
+    TransactionStats stats = wtxn->stats();
+    assert(stats.writes >= 11 && stats.bytesWritten >= 10 * 2 * sizeof(double));
+    assert(stats.reads == 0 && stats.cacheHits == 0);
+    wtxn->commit();
+  }
+  {
+    auto rtxn = kv->beginRead();
+    auto cursor = rtxn->openCursor<FixedSizeObject2>();
+    size_t count = 0;
+    for(; !cursor->atEnd(); cursor->next()) {
+      auto fso = cursor->get();
+      count++;
+    }
+    cursor.reset();
+    TransactionStats stats = rtxn->stats();
+    assert(count >= 10 && stats.reads == count && stats.cursorSteps >= count);
+    assert(stats.bytesRead == count * 2 * sizeof(double));
+    rtxn->end();
+  }
+  {
+    unsigned owner = kv->setCache<IndexedObject>();
+    auto rtxn = kv->beginRead();
+    auto first = rtxn->getObject<IndexedObject>(cachedId);
+    auto second = rtxn->getObject<IndexedObject>(cachedId);
+    assert(first == second);
+    TransactionStats stats = rtxn->stats();
+    assert(stats.cacheMisses == 1 && stats.cacheHits == 1 && stats.reads == 1);
+    rtxn->end();
+    kv->setCache<IndexedObject>(false, owner);
+  }
+  {
+    //pooled read transactions start over
+    auto rtxn = kv->beginRead();
+    assert(rtxn->stats().reads == 0);
+    rtxn->end();
+  }
+  StoreStats after = kv->stats();
+  assert(after.transactions == before.transactions + 4);
+  assert(after.writes >= before.writes + 11 && after.reads >= before.reads + 11);
+  assert(after.cacheHits == before.cacheHits + 1);
+}
+
+template <typename S>
+ObjectId saveOtherThings(S &wtxn, size_t &bytesWritten)
+{
+  vector<OtherThingPtr> vect;
+  for(int i=0; i<200; i++) {
+    stringstream ss;
+    ss << "Thing_" << i;
+    if(i % 2) vect.push_back(OtherThingPtr(new OtherThingA(ss.str())));
+    else vect.push_back(OtherThingPtr(new OtherThingB(ss.str())));
+  }
+  size_t before = wtxn->stats().bytesWritten;
+  ObjectId collectionId = wtxn->putCollection(vect);
+  bytesWritten = wtxn->stats().bytesWritten - before;
+  return collectionId;
+}
+
+void testCompactFormat(KeyValueStore *kv)
+{
+  assert(kv->format() == StoreFormat::fixed);
+
+  remove("test-compact");
+  remove("test-compact-lock");
+  KeyValueStore *ckv = lmdb::KeyValueStore::Factory{1, ".", "test-compact",
+                                                    lmdb::KeyValueStore::Options(64).setFormat(StoreFormat::compact)};
+  ckv->putSchema<OtherThing, OtherThingA, OtherThingB, VariableSizeObject, FixedSizeObject, VarintObject>();
+  assert(ckv->format() == StoreFormat::compact);
+
+  //object collections are smaller
+  size_t fixedBytes, compactBytes;
+  {
+    auto wtxn = kv->beginWrite();
+    saveOtherThings(wtxn, fixedBytes);
+    wtxn->abort();
+  }
+  ObjectId collectionId;
+  {
+    auto wtxn = ckv->beginWrite();
+    collectionId = saveOtherThings(wtxn, compactBytes);
+
+    auto appender = wtxn->appendCollection<OtherThing>(collectionId);
+    for(int i=0; i<20; i++) appender->put(OtherThingPtr(new OtherThingB("appended")));
+    appender->close();
+    wtxn->commit();
+  }
+  assert(compactBytes < fixedBytes);
+  {
+    auto rtxn = ckv->beginRead();
+    vector<OtherThingPtr> loaded = rtxn->getCollection<OtherThing>(collectionId);
+    assert(loaded.size() == 220);
+    assert(loaded[1]->name == "Thing_1" && dynamic_pointer_cast<OtherThingA>(loaded[1]));
+    assert(loaded[219]->name == "appended");
+
+    unsigned count = 0;
+    auto cursor = rtxn->openCursor<OtherThing>(collectionId);
+    while (OtherThing *ot = cursor->get()) {
+      if(count < 200) {
+        stringstream ss;
+        ss << "Thing_" << count;
+        assert(ot->name == ss.str());
+      }
+      count++;
+      delete ot;
+    }
+    assert(count == 220);
+    rtxn->end();
+  }
+
+  //attached collection counts
+  {
+    VariableSizeObjectPtr vop = kv::make_obj<VariableSizeObject>();
+    vector<FixedSizeObjectPtr> fops;
+    for(int i=0; i<300; i++) fops.push_back(kv::make_obj<FixedSizeObject>(i, 2 * i));
+
+    auto wtxn = ckv->beginWrite();
+    wtxn->saveObject(vop);
+    wtxn->putCollection(vop, 999, fops);
+    wtxn->commit();
+
+    vector<FixedSizeObjectPtr> loaded;
+    auto rtxn = ckv->beginRead();
+    rtxn->getCollection(vop, 999, loaded);
+    assert(loaded.size() == 300 && loaded[299]->number2 == 598);
+    rtxn->end();
+  }
+
+  //varint properties
+  ObjectId varintId;
+  {
+    VarintObject vo(3, -2, 4000000000u, std::numeric_limits<long long>::min());
+    auto wtxn = ckv->beginWrite();
+    varintId = wtxn->putObject(vo).objectId;
+    assert(wtxn->stats().bytesWritten == 1 + 1 + 5 + 10);
+    wtxn->commit();
+  }
+  {
+    auto rtxn = ckv->beginRead();
+    auto vo = rtxn->getObject<VarintObject>(varintId);
+    assert(vo->small == 3 && vo->negative == -2 && vo->large == 4000000000u);
+    assert(vo->extreme == std::numeric_limits<long long>::min());
+    rtxn->end();
+  }
+  delete ckv;
+
+  //the format is kept when the store is reopened
+  ckv = lmdb::KeyValueStore::Factory{1, ".", "test-compact"};
+  assert(ckv->format() == StoreFormat::compact);
+  delete ckv;
+}
+
+void testChunkCompression(KeyValueStore *kv)
+{
+  vector<OtherThingPtr> things;
+  for(int i=0; i<200; i++) {
+    stringstream ss;
+    ss << "Compressible_Thing_" << i % 10;
+    if(i % 2) things.push_back(OtherThingPtr(new OtherThingA(ss.str())));
+    else things.push_back(OtherThingPtr(new OtherThingB(ss.str())));
+  }
+  vector<double> values;
+  for(int i=0; i<1000; i++) values.push_back(0.5 * (i % 16));
+  vector<double> doubles;
+  for(int i=0; i<3000; i++) doubles.push_back((double)(i % 100));
+
+  ObjectId plainId, lzId, appendId = 0, valueId, dataId;
+  {
+    auto wtxn = kv->beginWrite();
+    plainId = wtxn->putCollection(things);
+    lzId = wtxn->putCollection(things, ChunkCodec::lz);
+
+    wtxn->setCollectionCodec(appendId, ChunkCodec::lz);
+    auto appender = wtxn->appendCollection<OtherThing>(appendId, 512);
+    for(int i=0; i<100; i++) appender->put(things[i]);
+    appender->close();
+
+    valueId = wtxn->putValueCollection(values, ChunkCodec::lz);
+    dataId = wtxn->putDataCollection(doubles.data(), 1000, ChunkCodec::lz);
+    wtxn->appendDataCollection(dataId, doubles.data() + 1000, 1000);
+    wtxn->appendDataCollection(dataId, doubles.data() + 2000, 1000);
+    wtxn->commit();
+  }
+  {
+    //the codec is saved with the collection
+    auto wtxn = kv->beginWrite();
+    auto appender = wtxn->appendCollection<OtherThing>(appendId, 512);
+    for(int i=100; i<200; i++) appender->put(things[i]);
+    wtxn->commit();
+  }
+  auto rtxn = kv->beginRead();
+
+  //compressed chunks are smaller, and read back identically through cursors and loaders
+  size_t plainBytes = rtxn->stats().bytesRead;
+  assert(rtxn->getCollection<OtherThing>(plainId).size() == 200);
+  plainBytes = rtxn->stats().bytesRead - plainBytes;
+
+  for(ObjectId id : {lzId, appendId}) {
+    size_t lzBytes = rtxn->stats().bytesRead;
+    vector<OtherThingPtr> loaded = rtxn->getCollection<OtherThing>(id);
+    lzBytes = rtxn->stats().bytesRead - lzBytes;
+    assert(lzBytes < (id == lzId ? plainBytes / 2 : plainBytes));
+
+    assert(loaded.size() == 200);
+    for(int i=0; i<200; i++) assert(loaded[i]->name == things[i]->name);
+    assert(dynamic_pointer_cast<OtherThingA>(loaded[1]) && dynamic_pointer_cast<OtherThingB>(loaded[198]));
+
+    unsigned count = 0;
+    auto cursor = rtxn->openCursor<OtherThing>(id);
+    while (OtherThing *ot = cursor->get()) {
+      assert(ot->name == things[count++]->name);
+      delete ot;
+    }
+    assert(count == 200);
+  }
+  {
+    //the cursor keeps its decompressed chunk while other reads evict it from the cache
+    unsigned count = 0;
+    auto cursor = rtxn->openCursor<OtherThing>(lzId);
+    while (OtherThing *ot = cursor->get()) {
+      if(count == 1) assert(rtxn->getCollection<OtherThing>(appendId).size() == 200);
+      assert(ot->name == things[count++]->name);
+      delete ot;
+    }
+    assert(count == 200);
+  }
+  assert(rtxn->getValueCollection<double>(valueId) == values);
+
+  //range within one chunk is copied out of the cache
+  double *data = nullptr;
+  bool owned = false;
+  assert(rtxn->getDataCollection(dataId, 1010, 50, data, &owned) == 50 && owned);
+  for(int i=0; i<50; i++) assert(data[i] == doubles[1010 + i]);
+  free(data);
+
+  //range straddles all three chunks
+  data = nullptr;
+  assert(rtxn->getDataCollection(dataId, 997, 2000, data, &owned) == 2000 && owned);
+  for(int i=0; i<2000; i++) assert(data[i] == doubles[997 + i]);
+  free(data);
+
+  auto summary = rtxn->summarizeDataCollection<double>(dataId);
+  assert(summary.count == 3000 && summary.min == 0 && summary.max == 99 && summary.sum == 30 * 4950);
+  rtxn->end();
+
+  auto wtxn = kv->beginWrite();
+  for(ObjectId id : {plainId, lzId, appendId, valueId, dataId}) wtxn->deleteCollection(id);
+  wtxn->commit();
+}
+
+void testParallelCollectionLoad(KeyValueStore *kv)
+{
+  //many small chunks, one of the collections compressed
+  ObjectId objectsId = 0, lzId = 0, valuesId = 0;
+  {
+    vector<OtherThingPtr> things;
+    for(int i=0; i<1000; i++) {
+      stringstream ss;
+      ss << "Thing_" << i;
+      things.push_back(i % 3 ? OtherThingPtr(new OtherThingA(ss.str())) : OtherThingPtr(new OtherThingB(ss.str())));
+    }
+    auto wtxn = kv->beginWrite();
+    auto appender = wtxn->appendCollection<OtherThing>(objectsId, 256);
+    for(auto &thing : things) appender->put(thing);
+    appender->close();
+
+    wtxn->setCollectionCodec(lzId, ChunkCodec::lz);
+    auto lzAppender = wtxn->appendCollection<OtherThing>(lzId, 256);
+    for(auto &thing : things) lzAppender->put(thing);
+    lzAppender->close();
+
+    auto valueAppender = wtxn->appendValueCollection<double>(valuesId, 256);
+    for(int i=0; i<10000; i++) valueAppender->put(0.25 * i);
+    valueAppender->close();
+    wtxn->commit();
+  }
+  auto rtxn = kv->beginRead();
+  assert(rtxn->getCollectionInfo(objectsId)->chunkInfos.size() > 10);
+
+  for(ObjectId id : {objectsId, lzId}) {
+    vector<OtherThingPtr> sequential = rtxn->getCollection<OtherThing>(id);
+    vector<OtherThingPtr> parallel = kv->parallelLoad(4).getCollection<OtherThing>(id);
+    assert(sequential.size() == 1000 && parallel.size() == 1000);
+    for(size_t i=0; i<1000; i++) {
+      assert(parallel[i]->name == sequential[i]->name);
+      assert((bool)dynamic_pointer_cast<OtherThingA>(parallel[i]) == (bool)(i % 3));
+    }
+  }
+  vector<double> values = kv->parallelLoad().getValueCollection<double>(valuesId);
+  assert(values == rtxn->getValueCollection<double>(valuesId));
+  assert(values.size() == 10000 && values[9999] == 0.25 * 9999);
+  rtxn->end();
+
+  bool thrown = false;
+  try {
+    kv->parallelLoad(2).getValueCollection<double>(0xFFFFFF);
+  }
+  catch(kv::error &) {
+    thrown = true;
+  }
+  assert(thrown);
+
+  auto wtxn = kv->beginWrite();
+  for(ObjectId id : {objectsId, lzId, valuesId}) wtxn->deleteCollection(id);
+  wtxn->commit();
+}
+
+void testReadahead()
+{
+  //cursors behave the same with and without readahead
+  for(unsigned readahead : {0u, 2u, 64u}) {
+    remove("test-readahead");
+    remove("test-readahead-lock");
+    KeyValueStore *rkv = lmdb::KeyValueStore::Factory{2, ".", "test-readahead",
+                                                      lmdb::KeyValueStore::Options(64).setReadahead(readahead)};
+    rkv->putSchema<Colored2DPoint>();
+
+    ObjectId collectionId = 0;
+    {
+      auto wtxn = rkv->beginWrite();
+      for(int i=0; i<5000; i++) {
+        Colored2DPoint p;
+        p.set(i, 0, 0, 0, 0, 0);
+        wtxn->putObject(p);
+      }
+      auto appender = wtxn->appendValueCollection<double>(collectionId, 512);
+      for(int i=0; i<20000; i++) appender->put(0.5 * i);
+      appender->close();
+      wtxn->commit();
+    }
+    {
+      auto rtxn = rkv->beginRead();
+      float x = 0;
+      for(auto cursor = rtxn->openCursor<Colored2DPoint>(); !cursor->atEnd(); cursor->next()) {
+        assert(cursor->get()->x == x);
+        x++;
+      }
+      assert(x == 5000);
+
+      unsigned count = 0;
+      auto cursor = rtxn->openValueCursor<double>(collectionId);
+      for (double val; cursor->get(val); count++) assert(val == 0.5 * count);
+      assert(count == 20000);
+      rtxn->end();
+    }
+    delete rkv;
+  }
+  remove("test-readahead");
+  remove("test-readahead-lock");
+}
+
+void testObjectVectorLoad(KeyValueStore *kv)
+{
+  //children are read in key order, but must come back in the order they were stored
+  ObjectKey key;
+  vector<shared_ptr<SomethingVirtual>> children;
+  {
+    auto wtxn = kv->beginWrite();
+    for(int i=0; i<300; i++) {
+      switch(i % 3) {
+        case 0: children.push_back(kv::make_obj<SomethingVirtual>(i, "plain")); break;
+        case 1: children.push_back(kv::make_obj<SomethingVirtual1>(i, "one", "Köchin")); break;
+        case 2: children.push_back(kv::make_obj<SomethingVirtual2>(i, "two", "Stricken")); break;
+      }
+    }
+    for(auto it = children.rbegin(); it != children.rend(); it++) wtxn->saveObject(*it);
+
+    Wonderful w;
+    w.embeddedVirtual1 = w.embeddedVirtual2 = kv::make_obj<SomethingVirtual>(1000, "embedded");
+    w.toplevelVirtual1 = w.toplevelVirtual2 = children[0];
+    w.virtualsPointers = children;
+    w.virtualsPointers.push_back(children[7]);
+    wtxn->saveObject(w, key);
+    wtxn->commit();
+  }
+  auto rtxn = kv->beginRead();
+  auto loaded = rtxn->getObject<Wonderful>(key.objectId);
+  assert(loaded->virtualsPointers.size() == 301);
+  for(int i=0; i<300; i++) {
+    assert(loaded->virtualsPointers[i]->id == (unsigned)i);
+    assert(loaded->virtualsPointers[i]->name == (i % 3 == 0 ? "plain" : (i % 3 == 1 ? "one" : "two")));
+  }
+  assert(loaded->virtualsPointers[300]->id == 7 && loaded->virtualsPointers[300]->name == "one");
+  rtxn->end();
+
+  //don't leave anything behind for testCompatibleDatabase
+  auto wtxn = kv->beginWrite();
+  wtxn->deleteObject<Wonderful>(key);
+  for(auto &child : children) wtxn->deleteObject(child);
+  wtxn->commit();
+}
+
+void testDispatchTables(KeyValueStore *kv)
+{
+  //registered classes get a flat dispatch table covering inherited properties
+  Properties *props = ClassTraits<SomethingVirtual3>::traits_properties;
+  auto table = props->dispatchTable<SomethingVirtual3>(kv->id);
+  assert(table && table->size() == props->full_size());
+  assert(!props->dispatchTable<SomethingVirtual3>(MAX_DATABASES-1));
+
+  //one table per mapped superclass through which the object may be passed, none for unrelated classes
+  assert(props->dispatchTable<SomethingVirtual2>(kv->id) && props->dispatchTable<SomethingVirtual>(kv->id));
+  assert(!props->dispatchTable<SomethingVirtual1>(kv->id));
+
+  //the object pointer is cast through its static type, so that non-primary bases are adjusted
+  struct Mixin {int64_t tag = 0;};
+  struct Mixed : public SomethingVirtual, public Mixin {};
+  Mixed mixed;
+  mixed.name = "adjusted";
+  Mixin *mixin = &mixed;
+  assert((void *)mixin != (void *)&mixed);
+  Properties *baseProps = ClassTraits<SomethingVirtual>::traits_properties;
+  for(unsigned i=0; i<baseProps->full_size(); i++) {
+    const PropertyAccessBase *pa = baseProps->get(i);
+    auto d = PropertyDispatch::make<Mixin, Mixed, SomethingVirtual>(pa);
+    auto sa = static_cast<const StoreAccessBase<SomethingVirtual> *>(pa->storeinfo);
+    assert(d.size(kv->id, mixin, pa) == sa->size(kv->id, &mixed, pa));
+  }
+
+  ObjectKey key;
+  {
+    auto wtxn = kv->beginWrite();
+    SomethingVirtual3 obj(77, "Dispatcher", "Tables", 33);
+    SomethingVirtual &base = obj;
+    key = wtxn->putObject(base);
+    wtxn->commit();
+  }
+  {
+    auto rtxn = kv->beginRead();
+    auto loaded = rtxn->getObjects<SomethingVirtual>({key});
+    SomethingVirtual3 *sv3 = dynamic_cast<SomethingVirtual3 *>(loaded[0].get());
+    assert(sv3 && sv3->id == 77 && sv3->name == "Dispatcher" && sv3->hobby == "Tables" && sv3->age == 33);
+    rtxn->end();
+  }
+  auto wtxn = kv->beginWrite();
+  wtxn->deleteObject<SomethingVirtual>(key);
+  wtxn->commit();
+}
+
+void testIntegerEncoding()
+{
+  //fixed-width fast path and generic widths produce the same big-endian bytes
+  byte_t a[8], b[8];
+  for(int64_t val : {(int64_t)0, (int64_t)1, (int64_t)-1, (int64_t)0x1234, (int64_t)-300000, (int64_t)0x0102030405060708LL}) {
+    write_integer<8>(a, val);
+    for(size_t i=0; i<8; i++) assert(a[i] == (byte_t)((uint64_t)val >> ((7 - i) * 8)));
+    assert((read_integer<int64_t, 8>(a) == val));
+
+    write_integer<4>(a, (int)val);
+    write_integer(b, (int)val, 4);
+    assert((!memcmp(a, b, 4) && read_integer<int, 4>(a) == (int)val && read_integer<int>(b, 4) == (int)val));
+
+    write_integer<2>(a, (ClassId)val);
+    assert((a[0] == (byte_t)((ClassId)val >> 8) && a[1] == (byte_t)val && read_integer<ClassId, 2>(a) == (ClassId)val));
+
+    //odd widths use the generic loop
+    write_integer(a, (uint64_t)val & 0xFFFFFF, 3);
+    assert((read_integer<uint64_t>(a, 3) == ((uint64_t)val & 0xFFFFFF)));
+  }
+  //narrower storage width truncates and zero-extends
+  write_integer<4>(a, (size_t)0x123456789ULL);
+  assert((read_integer<size_t, 4>(a) == 0x23456789));
+
+  WriteBuf wb(b, sizeof(b));
+  wb.appendInteger<2>(0xABCD);
+  wb.appendInteger<4>(7u);
+  ReadBuf rb(b, wb.size());
+  assert((rb.readInteger<unsigned, 2>() == 0xABCD && rb.readInteger<unsigned>(4) == 7 && rb.atEnd()));
+}
+
+void testObjectArena(KeyValueStore *kv)
+{
+  ObjectId collectionId = 0;
+  vector<ObjectKey> keys;
+  {
+    auto wtxn = kv->beginWrite();
+    for(int i=0; i<500; i++) {
+      SomethingVirtual2 obj(i, "arena", "Bumping");
+      SomethingVirtual &base = obj;
+      keys.push_back(wtxn->putObject(base));
+    }
+    vector<shared_ptr<FixedSizeObject>> fsos;
+    for(int i=0; i<300; i++) fsos.push_back(make_obj<FixedSizeObject>(i, i*2));
+    collectionId = wtxn->putCollection(fsos);
+    wtxn->commit();
+  }
+
+  shared_ptr<SomethingVirtual> survivor;
+  {
+    auto rtxn = kv->beginRead();
+    rtxn->useArena(4096);
+    assert(rtxn->arena() && rtxn->arena()->allocated() == 0);
+
+    //polymorphic batch load
+    auto loaded = rtxn->getObjects<SomethingVirtual>(keys);
+    for(int i=0; i<500; i++) {
+      SomethingVirtual2 *sv2 = dynamic_cast<SomethingVirtual2 *>(loaded[i].get());
+      assert(sv2 && sv2->id == (unsigned)i && sv2->hobby == "Bumping");
+    }
+    assert(rtxn->arena()->allocated() >= 500 * sizeof(SomethingVirtual2) && rtxn->arena()->blocks() > 1);
+    assert(ClassTraits<SomethingVirtual>::getObjectKey(loaded[17])->objectId == keys[17].objectId);
+
+    //collections and cursors
+    auto coll = rtxn->getCollection<FixedSizeObject>(collectionId);
+    assert(coll.size() == 300 && coll[299]->number1 == 299 && coll[299]->number2 == 598);
+    size_t count = 0;
+    for(auto cursor = rtxn->openCursor<SomethingVirtual2>(); !cursor->atEnd(); cursor->next()) {
+      auto obj = cursor->get();
+      if(obj->name == "arena") count++;
+    }
+    assert(count == 500);
+
+    //objects may outlive the transaction
+    survivor = loaded[42];
+    loaded.clear();
+
+    //opt out for subsequent loads
+    rtxn->useArena(0);
+    assert(!rtxn->arena());
+    auto heap = rtxn->getObjects<SomethingVirtual>({keys[0]});
+    assert(heap[0]->id == 0);
+    rtxn->end();
+  }
+  assert(survivor->id == 42 && survivor->name == "arena");
+  survivor.reset();
+
+  auto wtxn = kv->beginWrite();
+  for(auto &key : keys) wtxn->deleteObject<SomethingVirtual>(key);
+  wtxn->deleteCollection(collectionId);
+  wtxn->commit();
+}
+
+void checkCompacted(KeyValueStore *ckv, const vector<ObjectKey> &kept, ObjectId sparseId, ObjectId smallId,
+                    ObjectId objectsId, ObjectId lzId)
+{
+  auto rtxn = ckv->beginRead();
+  for(auto key : kept) {
+    shared_ptr<Colored2DPoint> p(rtxn->getObject<Colored2DPoint>(key));
+    assert(p && p->x == key.objectId);
+  }
+  vector<double> sparse = rtxn->getValueCollection<double>(sparseId);
+  assert(sparse.size() == 200);
+  for(size_t i=0; i<sparse.size(); i++) assert(sparse[i] == 0.5 * i);
+
+  vector<double> small = rtxn->getValueCollection<double>(smallId);
+  assert(small.size() == 250);
+  for(size_t i=0; i<small.size(); i++) assert(small[i] == i);
+
+  //random access across merged chunks
+  double data[5];
+  assert(rtxn->getDataCollection(smallId, 98, 5, data) == 5);
+  assert(data[0] == 98 && data[4] == 102);
+
+  auto objects = rtxn->getCollection<Colored2DPoint>(objectsId);
+  assert(objects.size() == 200);
+  for(size_t i=0; i<objects.size(); i++) assert(objects[i]->y == i);
+
+  vector<double> lz = rtxn->getValueCollection<double>(lzId);
+  assert(lz.size() == 1000);
+  for(size_t i=0; i<lz.size(); i++) assert(lz[i] == 1.0);
+  rtxn->end();
+}
+
+void testCompact()
+{
+  remove("test-compact");
+  remove("test-compact-copy");
+  KeyValueStore *ckv = lmdb::KeyValueStore::Factory{2, ".", "test-compact"};
+  ckv->putSchema<Colored2DPoint>();
+
+  vector<ObjectKey> keys;
+  ObjectId sparseId = 0, smallId = 0, objectsId = 0, lzId = 0;
+  {
+    auto wtxn = ckv->beginWrite();
+    for(ObjectId i=0; i<5000; i++) {
+      Colored2DPoint p;
+      p.set(i + 1, 0, 0, 0, 0, 0);
+      keys.push_back(wtxn->putObject(p));
+      assert(keys.back().objectId == i + 1);
+    }
+    //many small, dense chunks
+    for(int c=0; c<50; c++) {
+      vector<double> vals;
+      for(int i=0; i<5; i++) vals.push_back(c * 5 + i);
+      if(c) wtxn->appendValueCollection(smallId, vals);
+      else smallId = wtxn->putValueCollection(vals);
+    }
+    for(int c=0; c<20; c++) {
+      vector<shared_ptr<Colored2DPoint>> points;
+      for(int i=0; i<10; i++) {
+        points.push_back(make_shared<Colored2DPoint>());
+        points.back()->set(0, c * 10 + i, 0, 0, 0, 0);
+      }
+      if(c) wtxn->appendCollection(objectsId, points);
+      else objectsId = wtxn->putCollection(points);
+    }
+    lzId = wtxn->putValueCollection(vector<double>(1000, 1.0), ChunkCodec::lz);
+    wtxn->commit();
+  }
+  //each transaction's appender leaves a mostly empty chunk behind
+  for(int a=0; a<10; a++) {
+    auto wtxn = ckv->beginWrite();
+    auto appender = wtxn->appendValueCollection<double>(sparseId);
+    for(int i=0; i<20; i++) appender->put(0.5 * (a * 20 + i));
+    appender->close();
+    wtxn->commit();
+  }
+  {
+    auto wtxn = ckv->beginWrite();
+    for(size_t i=100; i<keys.size(); i++) wtxn->deleteObject<Colored2DPoint>(keys[i]);
+    wtxn->commit();
+  }
+  keys.resize(100);
+
+  //refused while a transaction is running
+  {
+    auto rtxn = ckv->beginRead();
+    bool thrown = false;
+    try {
+      ckv->compact();
+    }
+    catch(kv::error &) {
+      thrown = true;
+    }
+    assert(thrown);
+    rtxn->end();
+  }
+
+  //compacted copy, the store file stays in place and untouched
+  CompactStats stats = ckv->compact("test-compact-copy");
+  assert(stats.chunksRewritten == 10 + 50 + 20);
+  assert(stats.sizeAfter > 0 && stats.sizeAfter < stats.sizeBefore);
+  checkCompacted(ckv, keys, sparseId, smallId, objectsId, lzId);
+
+  KeyValueStore *copy = lmdb::KeyValueStore::Factory{3, ".", "test-compact-copy"};
+  copy->putSchema<Colored2DPoint>();
+  checkCompacted(copy, keys, sparseId, smallId, objectsId, lzId);
+  delete copy;
+
+  //in place, while another thread keeps starting transactions. Those are refused during compaction, and compaction
+  //is refused while one of them runs. The chunks of the source are still sparse
+  {
+    bool done = false;
+    mutex doneLock;
+    thread reader([&] {
+      while(true) {
+        {
+          lock_guard<mutex> lock(doneLock);
+          if(done) break;
+        }
+        try {
+          auto rtxn = ckv->beginRead();
+          assert(rtxn->getObject<Colored2DPoint>(keys[0].objectId));
+          rtxn->end();
+        }
+        catch(invalid_argument &) {
+          //compaction is running
+        }
+      }
+    });
+    while(true) {
+      try {
+        stats = ckv->compact();
+        break;
+      }
+      catch(kv::error &) {
+        //a read transaction was running
+      }
+    }
+    {
+      lock_guard<mutex> lock(doneLock);
+      done = true;
+    }
+    reader.join();
+  }
+  assert(stats.chunksRewritten == 10 + 50 + 20);
+  assert(stats.reclaimed() > 0);
+  checkCompacted(ckv, keys, sparseId, smallId, objectsId, lzId);
+
+  //the reopened store is fully usable
+  {
+    auto wtxn = ckv->beginWrite();
+    Colored2DPoint p;
+    p.set(0, 0, 0, 0, 0, 0);
+    ObjectKey key = wtxn->putObject(p);
+    //ids continue after the top-level objects and the collection members
+    assert(key.objectId == 5000 + 200 + 1);
+    wtxn->commit();
+  }
+  delete ckv;
+
+  remove("test-compact");
+  remove("test-compact-copy");
+}
+
+void testMultiProcess()
+{
+#ifndef _WIN32
+  const int workers = 3, txns = 20, perTxn = 10;
+  lmdb::KeyValueStore::Options options = lmdb::KeyValueStore::Options(64).setMultiProcess();
+
+  remove("test-multiprocess");
+  remove("test-multiprocess-lock");
+  {
+    KeyValueStore *mkv = lmdb::KeyValueStore::Factory{2, ".", "test-multiprocess", options};
+    delete mkv;
+  }
+
+  //writers in separate processes interleave their transactions on the same file
+  vector<pid_t> pids;
+  for(int w=0; w<workers; w++) {
+    pid_t pid = fork();
+    if(pid == 0) {
+      KeyValueStore *mkv = lmdb::KeyValueStore::Factory{2, ".", "test-multiprocess", options};
+      mkv->putSchema<Colored2DPoint>();
+      for(int t=0; t<txns; t++) {
+        auto wtxn = mkv->beginWrite();
+        for(int i=0; i<perTxn; i++) {
+          Colored2DPoint p;
+          p.set(w, t * perTxn + i, 0, 0, 0, 0);
+          wtxn->putObject(p);
+        }
+        if(t % 4 == 0) wtxn->putValueCollection(vector<double>(1, w));
+        wtxn->commit();
+        this_thread::yield();
+      }
+      delete mkv;
+      _exit(0);
+    }
+    assert(pid > 0);
+    pids.push_back(pid);
+  }
+  for(pid_t pid : pids) {
+    int status;
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+  }
+
+  KeyValueStore *mkv = lmdb::KeyValueStore::Factory{2, ".", "test-multiprocess", options};
+  mkv->putSchema<Colored2DPoint>();
+  ObjectId maxId = 0;
+  {
+    auto rtxn = mkv->beginRead();
+    vector<int> counts(workers);
+    set<ObjectId> ids;
+    for(auto cursor = rtxn->openCursor<Colored2DPoint>(); !cursor->atEnd(); cursor->next()) {
+      ObjectKey key;
+      Colored2DPoint *p = cursor->get(key);
+      counts[(int)p->x]++;
+      ids.insert(key.objectId);
+      if(key.objectId > maxId) maxId = key.objectId;
+      delete p;
+    }
+    //no ObjectId was handed out twice
+    for(int count : counts) assert(count == txns * perTxn);
+    assert(ids.size() == workers * txns * perTxn);
+
+    vector<int> collections(workers);
+    for(ObjectId collectionId=1; collectionId <= workers * txns / 4; collectionId++) {
+      vector<double> vals = rtxn->getValueCollection<double>(collectionId);
+      assert(vals.size() == 1);
+      collections[(int)vals[0]]++;
+    }
+    for(int count : collections) assert(count == txns / 4);
+    rtxn->end();
+  }
+  {
+    auto wtxn = mkv->beginWrite();
+    Colored2DPoint p;
+    p.set(0, 0, 0, 0, 0, 0);
+    assert(wtxn->putObject(p).objectId == maxId + 1);
+    assert(wtxn->putValueCollection(vector<double>(1, 0)) == workers * txns / 4 + 1);
+    wtxn->commit();
+  }
+  delete mkv;
+
+  remove("test-multiprocess");
+  remove("test-multiprocess-lock");
+#endif
+}
+
+void testSavepoints(KeyValueStore *kv)
+{
+  ObjectId collectionId = 0, lateId = 0;
+  vector<ObjectKey> keys;
+  {
+    auto wtxn = kv->beginWrite();
+    for(int i=0; i<10; i++) {
+      Colored2DPoint p;
+      p.set(i, 0, 0, 0, 0, 0);
+      keys.push_back(wtxn->putObject(p));
+    }
+    auto appender = wtxn->appendCollection<OtherThing>(collectionId, 256);
+    for(int i=0; i<10; i++) appender->put(OtherThingPtr(new OtherThingB("kept")));
+
+    //undo objects, collections and appended data
+    auto sp = wtxn->savepoint();
+    ObjectKey undone;
+    for(int i=0; i<10; i++) {
+      Colored2DPoint p;
+      p.set(100 + i, 0, 0, 0, 0, 0);
+      undone = wtxn->putObject(p);
+    }
+    for(int i=0; i<500; i++) appender->put(OtherThingPtr(new OtherThingB("undone")));
+    lateId = wtxn->putValueCollection(vector<double>{1, 2, 3});
+    wtxn->rollbackTo(sp);
+
+    assert(!wtxn->getObject<Colored2DPoint>(undone.objectId));
+    assert(wtxn->getCollection<OtherThing>(collectionId).size() == 10);
+    assert(wtxn->getValueCollection<double>(lateId).empty());
+
+    //ids are handed out again, the appender continues where it stood at the savepoint
+    Colored2DPoint p;
+    p.set(10, 0, 0, 0, 0, 0);
+    keys.push_back(wtxn->putObject(p));
+    assert(keys.back().objectId == undone.objectId - 9);
+    for(int i=0; i<5; i++) appender->put(OtherThingPtr(new OtherThingB("kept")));
+
+    //nested savepoints, the inner one is released into the outer
+    auto outer = wtxn->savepoint();
+    auto inner = wtxn->savepoint();
+    assert(inner == outer + 1);
+    ObjectId tmpId = wtxn->putValueCollection(vector<double>{4, 5});
+    wtxn->release(inner);
+    assert(wtxn->getValueCollection<double>(tmpId).size() == 2);
+    wtxn->rollbackTo(outer);
+    assert(wtxn->getValueCollection<double>(tmpId).empty());
+
+    //released changes stay
+    auto last = wtxn->savepoint();
+    for(int i=0; i<5; i++) appender->put(OtherThingPtr(new OtherThingB("kept")));
+    wtxn->release(last);
+    appender->close();
+    wtxn->commit();
+  }
+  {
+    auto rtxn = kv->beginRead();
+    for(size_t i=0; i<keys.size(); i++) {
+      auto p = rtxn->getObject<Colored2DPoint>(keys[i].objectId);
+      assert(p && p->x == i);
+    }
+    auto loaded = rtxn->getCollection<OtherThing>(collectionId);
+    assert(loaded.size() == 20);
+    for(auto &ot : loaded) assert(ot->name == "kept");
+    assert(rtxn->getValueCollection<double>(lateId).empty());
+    rtxn->end();
+  }
+  {
+    auto wtxn = kv->beginWrite();
+    for(auto &key : keys) wtxn->deleteObject<Colored2DPoint>(key);
+    wtxn->deleteCollection(collectionId);
+    wtxn->commit();
+  }
+
+  //cached objects saved after a savepoint do not survive its rollback
+  remove("test-savepoint-cache");
+  KeyValueStore *ckv = lmdb::KeyValueStore::Factory{3, ".", "test-savepoint-cache"};
+  ckv->putSchema<FixedSizeObject2>();
+  ckv->setCache<FixedSizeObject2>();
+  {
+    auto wtxn = ckv->beginWrite();
+    auto sp = wtxn->savepoint();
+    auto cached = kv::make_obj<FixedSizeObject2>(1, 2);
+    ObjectId undoneId = wtxn->saveObject(cached);
+    wtxn->rollbackTo(sp);
+
+    //the id is handed out again, to an object that bypasses the cache
+    FixedSizeObject2 plain(3, 4);
+    assert(wtxn->putObject(plain).objectId == undoneId);
+    wtxn->commit();
+
+    auto rtxn = ckv->beginRead();
+    auto loaded = rtxn->getObject<FixedSizeObject2>(undoneId);
+    assert(loaded && loaded != cached && loaded->number1 == 3);
+    rtxn->end();
+  }
+  delete ckv;
+  remove("test-savepoint-cache");
+
+  //nested LMDB transactions are not available with a writable memory map
+  remove("test-savepoint");
+  remove("test-savepoint-lock");
+  KeyValueStore *wkv = lmdb::KeyValueStore::Factory{3, ".", "test-savepoint", lmdb::KeyValueStore::Options(64, false, true)};
+  {
+    auto wtxn = wkv->beginWrite();
+    bool thrown = false;
+    try {
+      wtxn->savepoint();
+    }
+    catch(kv::error &) {
+      thrown = true;
+    }
+    assert(thrown);
+    wtxn->abort();
+  }
+  delete wkv;
+  remove("test-savepoint");
+  remove("test-savepoint-lock");
+}
+
+void testDurability(KeyValueStore *kv)
+{
+  using Durability = lmdb::KeyValueStore::Durability;
+
+  //synchronous stores report durability right away
+  {
+    auto wtxn = kv->beginWrite();
+    ObjectId collectionId = wtxn->putValueCollection(vector<double>{1, 2, 3});
+    auto synced = wtxn->commitAsync();
+    assert(synced.wait_for(chrono::seconds(0)) == future_status::ready);
+    synced.get();
+
+    auto rtxn = kv->beginRead();
+    assert(rtxn->getValueCollection<double>(collectionId).size() == 3);
+    rtxn->end();
+
+    wtxn = kv->beginWrite();
+    wtxn->deleteCollection(collectionId);
+    wtxn->commit();
+  }
+
+  //background sync by interval, by byte budget alone, and after every commit
+  struct Config {Durability durability; unsigned intervalMs; size_t budget;};
+  for(Config config : {Config{Durability::noSync, 20, 0}, Config{Durability::noMetaSync, 0, 1},
+                       Config{Durability::noSync, 0, 0}}) {
+    remove("test-durability");
+    remove("test-durability-lock");
+    KeyValueStore *dkv = lmdb::KeyValueStore::Factory{
+        3, ".", "test-durability",
+        lmdb::KeyValueStore::Options(64).setDurability(config.durability, config.intervalMs, config.budget)};
+    dkv->putSchema<Colored2DPoint>();
+
+    vector<future<void>> synced;
+    for(ObjectId i=0; i<20; i++) {
+      auto wtxn = dkv->beginWrite();
+      Colored2DPoint p;
+      p.set(i, 0, 0, 0, 0, 0);
+      assert(wtxn->putObject(p).objectId == i + 1);
+      if(i % 2) synced.push_back(wtxn->commitAsync());
+      else wtxn->commit();
+    }
+    for(auto &f : synced) {
+      assert(f.wait_for(chrono::seconds(5)) == future_status::ready);
+      f.get();
+    }
+    delete dkv;
+
+    //pending commits are synced when the store is closed
+    dkv = lmdb::KeyValueStore::Factory{3, ".", "test-durability"};
+    {
+      auto rtxn = dkv->beginRead();
+      for(int i=0; i<20; i++) {
+        auto p = rtxn->getObject<Colored2DPoint>(i + 1);
+        assert(p && p->x == i);
+      }
+      rtxn->end();
+    }
+    delete dkv;
+  }
+  remove("test-durability");
+  remove("test-durability-lock");
+}
+
+void testMapGrowth()
+{
+  remove("test-growth");
+  remove("test-growth-lock");
+  KeyValueStore *gkv = lmdb::KeyValueStore::Factory{
+      3, ".", "test-growth", lmdb::KeyValueStore::Options(1).setMapGrowth(100)};
+  vector<double> values(400000);
+  for(size_t i=0; i<values.size(); i++) values[i] = i;
+
+  //a transaction that outgrows the map fails, the map grows before the next one
+  StoreStats before = gkv->stats();
+  {
+    auto wtxn = gkv->beginWrite();
+    bool thrown = false;
+    try {
+      wtxn->putDataCollection(values.data(), values.size());
+    }
+    catch(store_full_error &) {
+      thrown = true;
+    }
+    assert(thrown);
+    wtxn->abort();
+  }
+  assert(gkv->stats().mapFullErrors == before.mapFullErrors + 1);
+  gkv->beginWrite()->abort();
+  assert(gkv->stats().mapResizes > before.mapResizes);
+
+  //write() replays until the map is large enough. Ids taken by the aborted attempts are handed out again
+  ObjectId probeId = 0, collectionId = 0;
+  gkv->write([&](WriteTransaction *tr) {
+    probeId = tr->putDataCollection(values.data(), 10);
+  });
+  gkv->write([&](WriteTransaction *tr) {
+    collectionId = tr->putDataCollection(values.data(), values.size());
+    for(int i=0; i<3; i++) tr->putDataCollection(values.data(), values.size());
+  });
+  StoreStats after = gkv->stats();
+  assert(after.replays > before.replays && after.mapFullErrors > before.mapFullErrors + 1);
+  assert(collectionId == probeId + 1);
+  {
+    auto rtxn = gkv->beginRead();
+    vector<double> loaded(values.size());
+    assert(rtxn->getDataCollection(collectionId, 0, loaded.size(), loaded.data()) == loaded.size());
+    assert(loaded == values);
+    rtxn->end();
+  }
+
+  //the write queue replays a batch that ran out of space
+  {
+    WriteQueue queue(*gkv);
+    auto id = queue.submit([&](WriteTransaction *tr) {
+      for(int i=0; i<10; i++) tr->putDataCollection(values.data(), values.size());
+      return tr->putDataCollection(values.data(), values.size());
+    });
+    assert(id.get() > collectionId);
+    assert(gkv->stats().replays > after.replays);
+  }
+  delete gkv;
+  remove("test-growth");
+  remove("test-growth-lock");
+
+  //a store at its size limit gives up
+  gkv = lmdb::KeyValueStore::Factory{
+      3, ".", "test-growth", lmdb::KeyValueStore::Options(1).setMapGrowth(50, 2)};
+  bool thrown = false;
+  try {
+    gkv->write([&](WriteTransaction *tr) {
+      tr->putDataCollection(values.data(), values.size());
+    });
+  }
+  catch(store_full_error &) {
+    thrown = true;
+  }
+  assert(thrown);
+  delete gkv;
+  remove("test-growth");
+  remove("test-growth-lock");
+}
+
+void testBulkLoad()
+{
+  remove("test-bulk");
+  remove("test-bulk-lock");
+  KeyValueStore *bkv = lmdb::KeyValueStore::Factory{3, ".", "test-bulk"};
+  bkv->putSchema<Colored2DPoint, SomethingWithAllValueKeyedProperties, BulkChild, BulkParent>();
+
+  vector<SomethingWithAllValueKeyedProperties> objects(2000);
+  for(size_t i=0; i<objects.size(); i++) {
+    objects[i].name = "bulk";
+    objects[i].counter = i;
+    objects[i].numbers = {(int)i, (int)i + 1};
+  }
+  vector<Colored2DPoint> points(1000);
+  for(size_t i=0; i<points.size(); i++) points[i].set(i, 0, 0, 0, 0, 0);
+
+  //nothing is left behind by an aborted load
+  {
+    auto wtxn = bkv->beginBulkLoad();
+    wtxn->putObjects(objects.begin(), objects.end());
+    wtxn->abort();
+  }
+  ObjectId first = 0, firstPoint = 0;
+  {
+    //property values are appended after their object, the second class falls back where it doesn't sort last
+    auto wtxn = bkv->beginBulkLoad();
+    first = wtxn->putObjects(objects.begin(), objects.begin() + 1000);
+    TransactionStats stats = wtxn->stats();
+    assert(stats.appends == stats.writes && stats.appendFallbacks == 0);
+
+    firstPoint = wtxn->putObjects(points.begin(), points.end());
+    assert(wtxn->stats().appendFallbacks == points.size());
+
+    stats = wtxn->stats();
+    assert(wtxn->putObjects(objects.begin() + 1000, objects.end()) == first + 1000);
+    assert(wtxn->stats().appends - stats.appends == wtxn->stats().writes - stats.writes);
+    assert(wtxn->stats().appendFallbacks == points.size());
+    assert(wtxn->putObjects(points.end(), points.end()) == 0);
+    wtxn->commit();
+  }
+  {
+    //the parent's keyed value is held back until the parent key is out, nested objects don't flush it early.
+    //Only the child keys after the first fall back, because the child class sorts before the parent class
+    vector<BulkParent> parents(100);
+    for(size_t i=0; i<parents.size(); i++) {
+      parents[i].name = "parent";
+      parents[i].child = kv::make_obj<BulkChild>();
+      parents[i].child->value = (int)i;
+    }
+    auto wtxn = bkv->beginBulkLoad();
+    ObjectId firstParent = wtxn->putObjects(parents.begin(), parents.end());
+    TransactionStats stats = wtxn->stats();
+    assert(stats.appendFallbacks == parents.size() - 1 && stats.appends == stats.writes - stats.appendFallbacks);
+    wtxn->commit();
+
+    auto rtxn = bkv->beginRead();
+    for(size_t i=0; i<parents.size(); i++) {
+      auto parent = rtxn->getObject<BulkParent>(firstParent + i);
+      assert(parent && parent->name == "parent" && parent->child && parent->child->value == (int)i);
+    }
+    rtxn->end();
+  }
+  {
+    auto rtxn = bkv->beginRead();
+    for(size_t i=0; i<objects.size(); i++) {
+      auto obj = rtxn->getObject<SomethingWithAllValueKeyedProperties>(first + i);
+      assert(obj && obj->name == "bulk" && obj->counter == (int)i && obj->numbers.size() == 2 && obj->numbers[1] == (int)i + 1);
+    }
+    for(size_t i=0; i<points.size(); i++) {
+      auto p = rtxn->getObject<Colored2DPoint>(firstPoint + i);
+      assert(p && p->x == i);
+    }
+    size_t count = 0;
+    for(auto cursor = rtxn->openCursor<SomethingWithAllValueKeyedProperties>(); !cursor->atEnd(); cursor->next()) count++;
+    assert(count == objects.size());
+    rtxn->end();
+  }
+  delete bkv;
+  remove("test-bulk");
+  remove("test-bulk-lock");
+}
+
+void testReadsOutliveStore()
+{
+  remove("test-outlive");
+  KeyValueStore *okv = lmdb::KeyValueStore::Factory{3, ".", "test-outlive"};
+
+  //transactions released after the store is gone, with and without end()
+  auto ended = okv->beginRead();
+  ended->end();
+  auto open = okv->beginRead();
+  auto exclusive = okv->beginExclusiveRead();
+  exclusive->end();
+  delete okv;
+
+  ended.reset();
+  open.reset();
+  exclusive.reset();
+
+  remove("test-outlive");
+}
+
 void test_classupdate();
 
 using namespace lightningobjects::valuetest;
@@ -1494,7 +3303,9 @@ int main()
       OtherThing,
       OtherThingA,
       OtherThingB,
-      SomethingWithALazyVector>();
+      SomethingWithALazyVector,
+      IndexedObject,
+      IndexedObjectSub>();
 
   kv->setRefCounting<VariableSizeObject>();
   kv->setRefCounting<FixedSizeObject>();
@@ -1531,6 +3342,31 @@ int main()
   testClassCursor(kv);
   testObjectMappings(kv);
   testCustomValueTypes(kv);
+  testObjectCache(kv);
+  testReadTransactionPool(kv);
+  testGetObjects(kv);
+  testParallelScan(kv);
+  testObjectView(kv);
+  testLoadColumns(kv);
+  testDataKernels(kv);
+  testWriteQueue(kv);
+  testSecondaryIndex(kv);
+  testStats(kv);
+  testCompactFormat(kv);
+  testChunkCompression(kv);
+  testParallelCollectionLoad(kv);
+  testReadahead();
+  testObjectVectorLoad(kv);
+  testDispatchTables(kv);
+  testIntegerEncoding();
+  testObjectArena(kv);
+  testCompact();
+  testMultiProcess();
+  testSavepoints(kv);
+  testDurability(kv);
+  testMapGrowth();
+  testBulkLoad();
+  testReadsOutliveStore();
 
   ObjectKey key = setupTestCompatibleDatabase(kv);
   delete kv;
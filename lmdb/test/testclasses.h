@@ -283,6 +283,34 @@ struct FixedSizeObject2 {
 };
 using FixedSizeObject2Ptr = std::shared_ptr<FixedSizeObject2>;
 
+struct IndexedObject {
+  std::string name;
+  int number;
+  double value;
+  std::string comment;
+
+  IndexedObject() : number(0), value(0) {}
+  IndexedObject(std::string name, int number, double value) : name(name), number(number), value(value) {}
+  virtual ~IndexedObject() {}
+};
+struct IndexedObjectSub : public IndexedObject {
+  short rank;
+
+  IndexedObjectSub() : rank(0) {}
+  IndexedObjectSub(std::string name, int number, double value, short rank)
+      : IndexedObject(name, number, value), rank(rank) {}
+};
+struct VarintObject {
+  int64_t small;
+  int negative;
+  uint32_t large;
+  long long extreme;
+
+  VarintObject() : small(0), negative(0), large(0), extreme(0) {}
+  VarintObject(int64_t small, int negative, uint32_t large, long long extreme)
+      : small(small), negative(negative), large(large), extreme(extreme) {}
+};
+
 struct VariableSizeObject {
   unsigned objectId = 0; //for ObjectPropertyTest
 
@@ -347,6 +375,18 @@ struct SomethingWithAllValueKeyedProperties
   set<string> children;
 };
 
+struct BulkChild
+{
+  int value = 0;
+};
+
+//a keyed property that is written before the nested object
+struct BulkParent
+{
+  std::string name;
+  std::shared_ptr<BulkChild> child;
+};
+
 struct SomethingWithAnObjectIter
 {
   std::string name;
@@ -881,6 +921,15 @@ START_MAPPING(SomethingWithAllValueKeyedProperties, name, counter, numbers, chil
   MAPPED_PROP(SomethingWithAllValueKeyedProperties, ValuePropertyKeyedAssign, set<string>, children)
 END_MAPPING(SomethingWithAllValueKeyedProperties)
 
+START_MAPPING(BulkChild, value)
+  MAPPED_PROP(BulkChild, ValuePropertyEmbeddedAssign, int, value)
+END_MAPPING(BulkChild)
+
+START_MAPPING(BulkParent, name, child)
+  MAPPED_PROP(BulkParent, ValuePropertyKeyedAssign, std::string, name)
+  MAPPED_PROP(BulkParent, ObjectPtrPropertyAssign, BulkChild, child)
+END_MAPPING(BulkParent)
+
 START_MAPPING(FixedSizeObject, objectId, number1, number2)
   OBJECT_ID(FixedSizeObject, objectId)
   MAPPED_PROP(FixedSizeObject, ValuePropertyEmbeddedAssign, unsigned, number1)
@@ -996,6 +1045,24 @@ START_MAPPING(ObjectPropertyTest, id, fso, vso, fso_vect, vso_vect)
   MAPPED_PROP(ObjectPropertyTest, ObjectVectorPropertyAssign, VariableSizeObject, vso_vect)
 END_MAPPING(ObjectPropertyTest)
 
+START_MAPPING(IndexedObject, name, number, value, comment)
+  MAPPED_PROP_INDEXED(IndexedObject, ValuePropertyEmbeddedAssign, std::string, name)
+  MAPPED_PROP_INDEXED(IndexedObject, ValuePropertyEmbeddedAssign, int, number)
+  MAPPED_PROP_INDEXED(IndexedObject, ValuePropertyEmbeddedAssign, double, value)
+  MAPPED_PROP(IndexedObject, ValuePropertyEmbeddedAssign, std::string, comment)
+END_MAPPING(IndexedObject)
+
+START_MAPPING_SUB(IndexedObjectSub, IndexedObject, rank)
+  MAPPED_PROP_INDEXED(IndexedObjectSub, ValuePropertyEmbeddedAssign, short, rank)
+END_MAPPING_SUB(IndexedObjectSub, IndexedObject)
+
+START_MAPPING(VarintObject, small, negative, large, extreme)
+  MAPPED_PROP(VarintObject, ValuePropertyVarintAssign, int64_t, small)
+  MAPPED_PROP(VarintObject, ValuePropertyVarintAssign, int, negative)
+  MAPPED_PROP(VarintObject, ValuePropertyVarintAssign, uint32_t, large)
+  MAPPED_PROP(VarintObject, ValuePropertyVarintAssign, long long, extreme)
+END_MAPPING(VarintObject)
+
 START_MAPPING(RefCountingTest, fso, vso, fso_vect, vso_vect)
   MAPPED_PROP(RefCountingTest, ObjectPtrPropertyAssign, FixedSizeObject, fso)
   MAPPED_PROP(RefCountingTest, ObjectPtrPropertyAssign, VariableSizeObject, vso)
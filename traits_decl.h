@@ -76,6 +76,9 @@ static const PropertyAccessBase prop_decl(__VA_ARGS__) ;};
 /** @see header traits_impl.h */
 #define MAPPED_PROP3(_cls, propkind, proptype, propname, parm)
 
+/** @see header traits_impl.h */
+#define MAPPED_PROP_INDEXED(_cls, propkind, proptype, propname)
+
 /** @see header traits_impl.h */
 #define OBJECT_ID(_cls, prop)
 
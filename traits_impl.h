@@ -244,6 +244,14 @@ const PropertyAccessBase *ClassTraits<cls>::prop = new propkind<cls, proptype, &
 #define MAPPED_PROP3(cls, propkind, proptype, propname, parm) \
 const PropertyAccessBase *ClassTraits<cls>::propname = new propkind<cls, proptype, &cls::propname>(#propname, parm);
 
+/**
+ * define mapping for one property and maintain a secondary index on it. Only value-type properties that are
+ * stored embedded in the object buffer can be indexed
+ */
+#define MAPPED_PROP_INDEXED(cls, propkind, proptype, propname) \
+const PropertyAccessBase *ClassTraits<cls>::propname = \
+indexed<proptype>(new propkind<cls, proptype, &cls::propname>(#propname));
+
 /**
  * define mapping for a objectid property
  *
@@ -29,5 +29,6 @@
 #undef MAPPED_PROP_ITER
 #undef MAPPED_PROP2
 #undef MAPPED_PROP3
+#undef MAPPED_PROP_INDEXED
 #undef OBJECT_ID
 #undef KV_TYPEDEF